@@ -2,19 +2,40 @@
 #define ASTRAX_BUFFER_H
 
 #include "types.h"
+#include "piece_table.h"
+#include "mapped_file.h"
+#include "file_loader.h"
+#include "file_writer.h"
+#include "file_saver.h"
+#include "undo.h"
+#include <deque>
 #include <string>
 #include <vector>
-#include <deque>
 #include <memory>
 #include <functional>
 
 namespace astrax {
 
+/// Receives every primitive change of a buffer's content, including undo and redo
+using EditObserver = std::function<void(size_t offset, size_t removed, StringView inserted)>;
+
+/**
+ * @brief Lines affected by one content change
+ *
+ * Lets caches indexed by line number shift their entries past an edit
+ * instead of starting over.
+ */
+struct LineChange {
+    size_t line = 0;           // Line the change starts on
+    size_t removedLines = 0;   // Line breaks removed
+    size_t insertedLines = 0;  // Line breaks inserted
+};
+
 /**
  * @brief Text buffer with undo/redo support
  * 
- * Stores document content as a vector of lines with efficient
- * insertion/deletion and full undo/redo history.
+ * Stores document content in a piece table, so edits cost O(log pieces)
+ * regardless of document size, with full undo/redo history.
  */
 class Buffer {
 public:
@@ -26,22 +47,55 @@ public:
     // ========================================================================
     
     /// Get number of lines
-    size_t lineCount() const { return lines_.empty() ? 1 : lines_.size(); }
+    size_t lineCount() const { return table_.lineCount(); }
     
-    /// Get a specific line (0-indexed)
-    const std::string& getLine(size_t index) const;
+    /// Get a copy of a specific line (0-indexed)
+    std::string getLine(size_t index) const;
+    
+    /// Get a view of a specific line (0-indexed)
+    ///
+    /// Valid until the buffer is modified or getLineView() is called again.
+    StringView getLineView(size_t index) const;
+    
+    /// Get length of a line in bytes
+    size_t lineLength(size_t index) const { return table_.lineLength(index); }
     
     /// Get all content as a single string
     std::string getContent() const;
     
+    /// Get underlying piece table
+    const PieceTable& getTable() const { return table_; }
+    
     /// Check if buffer is empty
-    bool isEmpty() const { return lines_.empty() || (lines_.size() == 1 && lines_[0].empty()); }
+    bool isEmpty() const { return table_.size() == 0; }
     
     /// Check if buffer has been modified
-    bool isModified() const { return modified_; }
+    ///
+    /// Edits count as soon as they are made, also inside an open edit group.
+    bool isModified() const { return version_ != savedVersion_; }
     
     /// Mark buffer as saved
-    void markSaved() { modified_ = false; savedUndoIndex_ = undoStack_.size(); }
+    void markSaved() { markSaved(version_); }
+    
+    /// Mark the content at version as saved; later edits stay modified
+    void markSaved(uint64_t version) {
+        savedVersion_ = version;
+    }
+    
+    /// Version of the current content; changes with every edit, undo and redo
+    uint64_t version() const { return version_; }
+    
+    /// Identifies this buffer among all buffers created
+    uint64_t id() const { return id_; }
+    
+    /// Number of content changes so far; unlike version(), never goes back
+    uint64_t changeCount() const { return changeCount_; }
+    
+    /// Changes made after the first since changes, oldest first
+    ///
+    /// Returns false if they are not all logged any more (the content was
+    /// replaced, or too many changes were made); callers then start over.
+    bool changesSince(uint64_t since, std::vector<LineChange>& changes) const;
     
     // ========================================================================
     // Cursor
@@ -99,6 +153,12 @@ public:
     /// Delete from cursor to end of line
     void deleteToEndOfLine();
     
+    /// Replace removed bytes at offset with text (used to replay journals)
+    void applyEdit(size_t offset, size_t removed, StringView text);
+    
+    /// Set the observer notified of every content change
+    void setEditObserver(EditObserver observer) { editObserver_ = std::move(observer); }
+    
     // ========================================================================
     // Line Operations
     // ========================================================================
@@ -123,10 +183,27 @@ public:
     void redo();
     
     /// Check if undo is available
-    bool canUndo() const { return !undoStack_.empty(); }
+    bool canUndo() const { return history_.canUndo(); }
     
     /// Check if redo is available
-    bool canRedo() const { return !redoStack_.empty(); }
+    bool canRedo() const { return history_.canRedo(); }
+    
+    /// Open an edit group; edits until the matching commit undo as one step
+    ///
+    /// Groups nest, only the outermost commit records the entry.
+    void beginEditGroup() { beginEdit(); }
+    
+    /// Close the innermost edit group
+    void commitEditGroup() { endEdit(); }
+    
+    /// Check if an edit group is open
+    bool inEditGroup() const { return editDepth_ > 0; }
+    
+    /// Set undo history memory budget in bytes
+    void setUndoMemoryLimit(size_t bytes) { history_.setMemoryLimit(bytes); }
+    
+    /// Get bytes currently held by undo history
+    size_t undoMemoryUsage() const { return history_.memoryUsage(); }
     
     // ========================================================================
     // Clipboard
@@ -151,45 +228,144 @@ public:
     // File I/O
     // ========================================================================
     
-    /// Load content from file
+    /// Load content from file, waiting until it is complete
+    ///
+    /// Files of at least the map threshold are memory-mapped and read in
+    /// place; only edited regions are ever copied.
     bool loadFromFile(const std::string& filename);
     
-    /// Save content to file
+    /// Start loading a file on a background thread
+    ///
+    /// The buffer is read-only while loading; call pollLoad() periodically
+    /// to take in the content loaded so far.
+    bool loadFromFileAsync(const std::string& filename);
+    
+    /// Take in newly loaded content; returns true if the buffer changed
+    bool pollLoad();
+    
+    /// Block until a background load finishes; false if it failed
+    bool waitForLoad();
+    
+    /// Check if a background load is in progress
+    bool isLoading() const { return loader_ != nullptr; }
+    
+    /// Check if the last load failed after it was started
+    bool loadFailed() const { return loadFailed_; }
+    
+    /// Load progress in file bytes
+    size_t loadedBytes() const;
+    size_t loadTotalBytes() const;
+    
+    /// Save content to file, atomically replacing it, and wait for it
     bool saveToFile(const std::string& filename);
     
+    /// Start saving a snapshot of the content on a background thread
+    ///
+    /// Editing may continue; the buffer counts as saved only up to the
+    /// version that was snapshotted, once pollSave() reports the write.
+    bool saveToFileAsync(const std::string& filename);
+    
+    /// Take in the oldest finished background save; false if there is none
+    bool pollSave(SaveResult& result);
+    
+    /// Check if background saves are running or have unreported results
+    bool isSaving() const { return saver_ && saver_->hasPending(); }
+    
+    /// Block until background saves have been written
+    void waitForSaves();
+    
+    /// Size and timing of the last successful save
+    const WriteStats& lastWriteStats() const { return lastWriteStats_; }
+    
     /// Get current filename
     const std::string& getFilename() const { return filename_; }
     
     /// Set filename
     void setFilename(const std::string& filename) { filename_ = filename; }
     
+    /// Set the file size from which loadFromFile() maps instead of reading
+    void setMapThreshold(size_t bytes) { mapThreshold_ = bytes; }
+    
+    /// Check if content is backed by a file mapping
+    bool isMapped() const { return mapped_ != nullptr; }
+    
+    /// Line ending written on save (detected on load)
+    LineEnding getLineEnding() const { return lineEnding_; }
+    void setLineEnding(LineEnding ending) { lineEnding_ = ending; }
+    
 private:
     // ========================================================================
     // Undo System
     // ========================================================================
     
-    struct UndoState {
-        std::vector<std::string> lines;
-        Position cursor;
-    };
+    /// Open an undo entry; edits until the matching endEdit() undo together
+    void beginEdit();
+    void endEdit();
+    
+    /// Commit any open groups so undo/redo see a consistent history
+    void closeEditGroups();
+    
+    /// Primitive edits; every content change goes through these
+    void applyInsert(size_t offset, StringView text);
+    void applyErase(size_t offset, size_t length);
+    
+    // ========================================================================
+    // Helpers
+    // ========================================================================
+    
+    /// Replace content, treating a single trailing newline as end-of-file marker
+    void setContent(std::string content);
+    
+    /// Byte offset of a position (column clamped to the line)
+    size_t offsetOf(const Position& pos) const;
+    
+    /// Add a change to the change log
+    void logChange(size_t offset, StringView removed, StringView inserted);
+    
+    /// Content replaced wholesale: logged changes no longer apply
+    void resetChanges();
     
-    void pushUndoState();
-    void clearRedoStack();
     
     // ========================================================================
     // Data Members
     // ========================================================================
     
-    std::vector<std::string> lines_;
+    PieceTable table_;
     Position cursor_{0, 0};
     std::string filename_;
-    bool modified_ = false;
+    bool finalNewline_ = false;  // Last line was terminated on load
+    LineEnding lineEnding_ = NATIVE_LINE_ENDING;
+    mutable std::string lineScratch_;
+    
+    // File mapping backing the original text, if any
+    std::shared_ptr<const MappedFile> mapped_;
+    size_t mapThreshold_ = 16 * 1024 * 1024;
+    
+    WriteStats lastWriteStats_;
+    
+    // Background saves; created on first use
+    std::unique_ptr<FileSaver> saver_;
+    uint64_t loadVersion_ = 0;  // Saves of older versions predate the content
+    
+    // Background load in progress
+    std::unique_ptr<FileLoader> loader_;
+    bool loadFailed_ = false;
+    
+    EditObserver editObserver_;
+    
+    // Recent changes, for line-indexed caches
+    static constexpr size_t CHANGE_LOG_LIMIT = 4096;
+    std::deque<LineChange> changes_;
+    uint64_t changeCount_ = 0;
+    uint64_t id_;
     
     // Undo/redo
-    std::deque<UndoState> undoStack_;
-    std::deque<UndoState> redoStack_;
-    size_t savedUndoIndex_ = 0;
-    static constexpr size_t MAX_UNDO_SIZE = 1000;
+    UndoHistory history_;
+    UndoEntry pendingUndo_;
+    int editDepth_ = 0;
+    uint64_t version_ = 0;
+    uint64_t lastVersion_ = 0;
+    uint64_t savedVersion_ = 0;
     
     // Clipboard
     std::string yankBuffer_;
@@ -0,0 +1,27 @@
+#ifndef ASTRAX_CPU_FEATURES_H
+#define ASTRAX_CPU_FEATURES_H
+
+/// Defined when compiling for x86, where SSE2/AVX2 kernels are built
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ASTRAX_X86 1
+#endif
+
+/// Compile one function for an instruction set the build does not assume;
+/// call it only after checking the CPU at run time
+#if defined(__GNUC__) || defined(__clang__)
+#define ASTRAX_TARGET(features) __attribute__((target(features)))
+#else
+#define ASTRAX_TARGET(features)
+#endif
+
+namespace astrax {
+
+/// Check if the CPU and OS support AVX2, along with POPCNT and BMI
+bool cpuHasAvx2();
+
+/// Check if the CPU supports SSE2
+bool cpuHasSse2();
+
+} // namespace astrax
+
+#endif // ASTRAX_CPU_FEATURES_H
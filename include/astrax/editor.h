@@ -7,9 +7,14 @@
 #include "renderer.h"
 #include "command.h"
 #include "search.h"
+#include "search_worker.h"
 #include "config.h"
+#include "journal.h"
+#include <chrono>
+#include <deque>
 #include <memory>
 #include <string>
+#include <utility>
 
 namespace astrax {
 
@@ -26,7 +31,10 @@ public:
     // ========================================================================
     
     /// Run the editor with optional file to open
-    void run(const std::string& filename = "");
+    ///
+    /// With recover, edits from the file's crash-recovery journal are
+    /// replayed on top of it.
+    void run(const std::string& filename = "", bool recover = false);
     
     /// Request the editor to quit
     void quit(bool force = false);
@@ -56,14 +64,32 @@ public:
     void newBuffer();
     
     /// Open a file
+    ///
+    /// A journal left by a session that did not exit is offered for
+    /// recovery, and edits are not journaled until it is recovered or
+    /// deleted.
     bool openFile(const std::string& filename);
     
-    /// Save current file
+    /// Open a file and replay the edits in its journal
+    bool recoverFile(const std::string& filename);
+    
+    /// Delete the unrecovered journal of the current file and start
+    /// journaling it afresh
+    bool deleteJournal();
+    
+    /// Check if the current file has a journal that was neither recovered
+    /// nor deleted
+    bool hasStaleJournal() const { return !recoveryNotice_.empty(); }
+    
+    /// Start saving the current file in the background
     bool saveFile();
     
-    /// Save to a new filename
+    /// Start saving to a new filename in the background
     bool saveFileAs(const std::string& filename);
     
+    /// Wait for background saves and report them; false if any failed
+    bool finishSaves();
+    
     // ========================================================================
     // Terminal Access
     // ========================================================================
@@ -71,6 +97,9 @@ public:
     /// Get terminal
     ITerminal& getTerminal() { return *terminal_; }
     
+    /// Repaint the whole screen on the next frame (after other programs wrote to it)
+    void invalidateScreen() { renderer_->invalidate(); }
+    
     // ========================================================================
     // Search
     // ========================================================================
@@ -78,12 +107,15 @@ public:
     /// Get search engine
     Search& getSearch() { return search_; }
     
-    /// Search forward
+    /// Move to the next match of the last search pattern
     void searchForward();
     
-    /// Search backward
+    /// Move to the previous match of the last search pattern
     void searchBackward();
     
+    /// Stop highlighting matches until the next search
+    void clearSearchHighlight() { highlightSearch_ = false; }
+    
     // ========================================================================
     // Status
     // ========================================================================
@@ -123,8 +155,15 @@ private:
     std::unique_ptr<CommandExecutor> commandExecutor_;
     KeyBindings keyBindings_;
     Search search_;
+    SearchWorker searchWorker_;
     Config config_;
     
+    // Crash-recovery log, and the journal mark of each save in flight
+    Journal journal_;
+    std::deque<std::pair<uint64_t, uint64_t>> journalMarks_;  // (buffer version, mark)
+    std::string recoveryNotice_;   // Offer shown while the file's journal is stale
+    bool journalFailed_ = false;   // The user was told the journal stopped being written
+    
     // ========================================================================
     // State
     // ========================================================================
@@ -134,23 +173,92 @@ private:
     std::string statusMessage_;
     std::string commandBuffer_;
     
+    // Incremental search: where the cursor was when / was typed, and the
+    // latest progress of the search for what has been typed since
+    Position searchOrigin_;
+    SearchProgress searchProgress_;
+    bool highlightSearch_ = true;   // Matches of search_ are highlighted
+    
+    // Earliest time the next frame is drawn while keys are still pending
+    std::chrono::steady_clock::time_point nextFrame_;
+    
     // ========================================================================
     // Event Processing
     // ========================================================================
     
     void processInput();
+    void processKey(const KeyEvent& key);
+    
+    /// Insert a bracketed paste as one edit
+    void processPaste(std::string text);
+    
+    /// Poll interval while a file loads or saves in the background
+    static constexpr int BACKGROUND_POLL_MS = 16;
+    
+    /// Wait for a key, returning false early when background work progresses
+    bool waitForInput();
+    
+    /// Check if a file is loading or saving, lines wait for highlighting,
+    /// a search is running or edits wait for the journal
+    bool hasBackgroundWork() const;
+    
+    /// Tell the user when journal writes start or stop failing; returns
+    /// true if the status changed
+    bool pollJournal();
+    
+    /// Show load progress or result; returns true if the message changed
+    bool updateLoadStatus();
+    
+    /// Show the outcome of a finished save and move the journal onto it
+    void completeSave(const SaveResult& result);
+    
+    /// Log the current buffer's edits to the journal
+    void attachJournal();
+    
+    /// Load a file into the buffer, leaving the journal closed
+    void loadFile(const std::string& filename);
+    
+    /// Tell the user about a journal found for filename
+    void offerRecovery(const std::string& filename);
     void processNormalMode(const KeyEvent& key);
     void processInsertMode(const KeyEvent& key);
     void processCommandMode(const KeyEvent& key);
     void processVisualMode(const KeyEvent& key);
     void processSearchMode(const KeyEvent& key);
     
+    // ========================================================================
+    // Incremental Search
+    // ========================================================================
+    
+    /// How long a keystroke waits for the search worker's match before the
+    /// frame is drawn without it
+    static constexpr int INCREMENTAL_WAIT_MS = 30;
+    
+    /// Search for the pattern typed so far from where the search began
+    void updateIncrementalSearch();
+    
+    /// Leave search mode, back where the search began
+    void cancelSearch();
+    
+    /// Take the search worker's progress, moving the cursor to a new
+    /// match; returns true if there was any
+    bool pollSearch();
+    
+    /// Match count or state of the latest search, for the status bar
+    std::string describeSearch() const;
+    
+    /// Move the cursor to a match of the current pattern, or say why not
+    void jumpToMatch(const SearchMatch& match);
+    
     // ========================================================================
     // Rendering
     // ========================================================================
     
     void render();
     
+    /// Render unless more keys are waiting and a frame was drawn recently
+    void renderPaced();
+    
     // ========================================================================
     // Initialization
     // ========================================================================
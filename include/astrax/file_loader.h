@@ -0,0 +1,113 @@
+#ifndef ASTRAX_FILE_LOADER_H
+#define ASTRAX_FILE_LOADER_H
+
+#include "types.h"
+#include "piece_table.h"
+#include "mapped_file.h"
+#include "line_index.h"
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace astrax {
+
+/**
+ * @brief Loads a file into a piece table on a background thread
+ *
+ * Large files are mapped and indexed a segment at a time; after each
+ * segment the loader publishes a snapshot of the table built so far, so
+ * the first screenful can be shown while the rest streams in. Snapshots
+ * are PieceTable copies, which share all nodes and blocks and are safe to
+ * read while the loader keeps appending.
+ *
+ * Once CRLF line endings are seen, the rest of the file is copied and
+ * normalized segment by segment instead of being referenced in place.
+ */
+class FileLoader {
+public:
+    /// Bytes indexed (or copied) between two snapshots
+    static constexpr size_t SEGMENT_SIZE = 4 * 1024 * 1024;
+
+    /// Files of at least mapThreshold bytes are memory-mapped
+    explicit FileLoader(size_t mapThreshold);
+
+    /// Cancels a running load and waits for the thread
+    ~FileLoader();
+
+    FileLoader(const FileLoader&) = delete;
+    FileLoader& operator=(const FileLoader&) = delete;
+
+    /// Open a file and start loading it; false if it cannot be opened
+    bool start(const std::string& path);
+
+    /// Copy the newest snapshot into table; false if nothing new since last poll
+    bool poll(PieceTable& table);
+
+    /// Block until loading finishes
+    void wait();
+
+    /// Check if the final snapshot has been published
+    bool isDone() const { return done_.load(std::memory_order_acquire); }
+
+    /// Check if the file was read completely (valid once done)
+    bool succeeded() const { return succeeded_; }
+
+    /// Progress, in file bytes
+    size_t loadedBytes() const { return loadedBytes_.load(std::memory_order_relaxed); }
+    size_t totalBytes() const { return totalBytes_; }
+
+    // ========================================================================
+    // Results (valid once done)
+    // ========================================================================
+
+    /// Last line was terminated; the terminator is not part of the table
+    bool finalNewline() const { return finalNewline_; }
+
+    /// Dominant line ending of the file
+    LineEnding lineEnding() const { return stats_.lineEnding(); }
+
+    /// Whether the file had any newline at all
+    bool hasNewlines() const { return stats_.newlines > 0; }
+
+    /// Mapping referenced by the table, if any part of it is
+    std::shared_ptr<const MappedFile> mapping() const {
+        return referencesMapping_ ? mapping_ : nullptr;
+    }
+
+private:
+    size_t mapThreshold_;
+    std::shared_ptr<MappedFile> mapping_;
+    std::ifstream file_;
+    size_t totalBytes_ = 0;
+
+    // Owned by the loader thread until done
+    PieceTable table_;
+    NewlineStats stats_;
+    bool finalNewline_ = false;
+    bool succeeded_ = false;
+    bool referencesMapping_ = false;
+
+    // Handoff to the owning thread
+    std::mutex mutex_;
+    PieceTable published_;
+    uint64_t publishedSerial_ = 0;
+    uint64_t takenSerial_ = 0;
+
+    std::atomic<size_t> loadedBytes_{0};
+    std::atomic<bool> done_{false};
+    std::atomic<bool> cancel_{false};
+    std::thread thread_;
+
+    void run();
+    bool loadMapped();
+    bool loadCopy();
+    void appendNormalized(std::string text);
+    void publish(size_t loaded, bool done = false);
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_FILE_LOADER_H
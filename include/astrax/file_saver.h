@@ -0,0 +1,79 @@
+#ifndef ASTRAX_FILE_SAVER_H
+#define ASTRAX_FILE_SAVER_H
+
+#include "piece_table.h"
+#include "mapped_file.h"
+#include "file_writer.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace astrax {
+
+/**
+ * @brief Outcome of a background save
+ */
+struct SaveResult {
+    std::string path;
+    uint64_t version = 0;   // Buffer version the written snapshot was taken at
+    bool ok = false;
+    WriteStats stats;
+};
+
+/**
+ * @brief Writes piece table snapshots to disk on a worker thread
+ *
+ * A snapshot is a PieceTable copy: it shares the immutable nodes and blocks
+ * of the buffer, so taking one is O(1) and the buffer can keep changing
+ * while it is written. Jobs run in order; a queued job is replaced by a
+ * newer one for the same path. The destructor finishes outstanding writes.
+ */
+class FileSaver {
+public:
+    FileSaver() = default;
+    ~FileSaver();
+
+    FileSaver(const FileSaver&) = delete;
+    FileSaver& operator=(const FileSaver&) = delete;
+
+    /// Queue a snapshot for writing to path
+    void save(const std::string& path, PieceTable snapshot, const WriteOptions& options,
+              std::shared_ptr<const MappedFile> source, uint64_t version);
+
+    /// Take the oldest finished result; false if there is none
+    bool poll(SaveResult& result);
+
+    /// Check if writes are queued or running, or results are waiting
+    bool hasPending() const;
+
+    /// Block until every queued write has finished
+    void wait();
+
+private:
+    struct Job {
+        std::string path;
+        PieceTable snapshot;
+        WriteOptions options;
+        std::shared_ptr<const MappedFile> source;   // Keeps options.source alive
+        uint64_t version = 0;
+    };
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;       // Signals new jobs or shutdown
+    std::condition_variable finished_;   // Signals a finished job
+    std::deque<Job> jobs_;
+    std::deque<SaveResult> results_;
+    bool writing_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+
+    void run();
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_FILE_SAVER_H
@@ -0,0 +1,46 @@
+#ifndef ASTRAX_FILE_WRITER_H
+#define ASTRAX_FILE_WRITER_H
+
+#include "piece_table.h"
+#include "mapped_file.h"
+#include "line_index.h"
+#include <string>
+
+namespace astrax {
+
+/**
+ * @brief How a piece table is serialized to disk
+ */
+struct WriteOptions {
+    LineEnding lineEnding = LineEnding::LF;
+    bool finalNewline = false;            // Terminate the last line
+    const MappedFile* source = nullptr;   // Ranges of this file are copied in-kernel
+};
+
+/**
+ * @brief Outcome of a file write
+ */
+struct WriteStats {
+    size_t bytes = 0;         // Total bytes in the written file
+    size_t bytesCopied = 0;   // Of which copied file-to-file without userspace
+    double seconds = 0.0;     // Wall time including fsync and rename
+
+    double bytesPerSecond() const {
+        return seconds > 0.0 ? static_cast<double>(bytes) / seconds : 0.0;
+    }
+};
+
+/// Replace path with the table's content, atomically
+///
+/// Writes a temporary file in the same directory with vectored writes
+/// straight from the piece chunks, fsyncs it and renames it over path, so
+/// a crash leaves either the old or the new file. Permissions of an
+/// existing file are kept and symlinks are written through. Unmodified
+/// ranges of options.source are copied with copy_file_range where the
+/// platform supports it.
+bool writeFileAtomic(const std::string& path, const PieceTable& table,
+                     const WriteOptions& options, WriteStats& stats);
+
+} // namespace astrax
+
+#endif // ASTRAX_FILE_WRITER_H
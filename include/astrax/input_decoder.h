@@ -0,0 +1,77 @@
+#ifndef ASTRAX_INPUT_DECODER_H
+#define ASTRAX_INPUT_DECODER_H
+
+#include "types.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief Ring buffer of raw terminal input, decoded into key events
+ *
+ * The terminal reads everything available with one read() straight into
+ * the free space of the ring, then decodes keys from it until it runs dry.
+ * Escape sequences may arrive split across reads; an incomplete one stays
+ * buffered until the rest arrives, or until the caller decides none will
+ * and decodes it as a plain Escape.
+ *
+ * Bracketed pastes are collected whole, however large, and reported as a
+ * single SpecialKey::Paste event.
+ */
+class InputDecoder {
+public:
+    static constexpr size_t CAPACITY = 64 * 1024;
+    
+    /// Longest escape sequence decoded; longer ones are dropped whole
+    static constexpr size_t MAX_SEQUENCE = 32;
+    
+    InputDecoder();
+    
+    /// Contiguous free space to read into; size 0 when the ring is full
+    char* writeSpace(size_t& size);
+    
+    /// Mark count bytes of the write space as filled
+    void commit(size_t count);
+    
+    /// Append bytes, as many as fit; returns the number stored
+    size_t feed(const char* data, size_t size);
+    
+    /// Decode the next key
+    ///
+    /// Returns false if no complete key is buffered. With final set, an
+    /// incomplete escape sequence is taken as the Escape key instead.
+    bool next(KeyEvent& event, bool final = false);
+    
+    /// Bytes not yet decoded
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    
+    /// Inside a bracketed paste, waiting for its end
+    bool pasting() const { return pasting_; }
+    
+    /// Text of the last Paste event
+    std::string takePaste();
+    
+private:
+    std::vector<char> data_;
+    size_t head_ = 0;   // Oldest undecoded byte
+    size_t size_ = 0;
+    
+    bool pasting_ = false;
+    std::string paste_;
+    
+    char at(size_t index) const { return data_[(head_ + index) % CAPACITY]; }
+    void consume(size_t count);
+    
+    /// Length of the escape sequence at the head, 0 if incomplete
+    size_t decodeEscape(KeyEvent& event) const;
+    
+    /// Move paste text out of the ring until the end marker
+    bool nextPaste(KeyEvent& event, bool final);
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_INPUT_DECODER_H
@@ -0,0 +1,162 @@
+#ifndef ASTRAX_JOURNAL_H
+#define ASTRAX_JOURNAL_H
+
+#include "types.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief One journaled edit: at offset, removed bytes were replaced by inserted
+ */
+struct JournalRecord {
+    size_t offset = 0;
+    size_t removed = 0;
+    std::string inserted;
+};
+
+/**
+ * @brief Append-only crash-recovery log of buffer edits
+ *
+ * The journal lives next to the file as ".<name>.axj". It starts with the
+ * size and modification time of the file it applies to, followed by one
+ * checksummed record per primitive edit, so recovery replays the edits in
+ * time proportional to their number rather than to the file size.
+ *
+ * Records are encoded on the calling thread and written by a worker that
+ * flushes them in batches every FLUSH_INTERVAL_MS. The file is created by
+ * the first edit, with the permissions of the file it journals (0600 for a
+ * new file), and deleted once a save catches up with every edit.
+ *
+ * A batch that cannot be written completely (no space, no permission) sets
+ * writeFailed(). The writer keeps what the file should hold and, with the
+ * next batch, writes the journal over from the header, so a torn record
+ * never hides the records appended after it.
+ */
+class Journal {
+public:
+    /// Longest time an edit waits in memory before it reaches the disk
+    static constexpr int FLUSH_INTERVAL_MS = 200;
+
+    /// Path of the journal for filename
+    static std::string pathFor(const std::string& filename);
+
+    /// Check if a journal exists for filename
+    static bool exists(const std::string& filename);
+
+    /// Read the edits journaled for filename
+    ///
+    /// Fails with a message in error if the journal cannot be read or the
+    /// file was changed since the journal was started. A record torn by a
+    /// crash ends the log; the edits before it are returned.
+    static bool read(const std::string& filename, std::vector<JournalRecord>& records,
+                     std::string& error);
+
+    Journal() = default;
+
+    /// Writes outstanding edits and stops the writer
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    /// Journal edits to filename's content as it is on disk now
+    ///
+    /// Any journal still open for another file is deleted.
+    void open(const std::string& filename);
+
+    /// Stop journaling and delete the journal file
+    void close();
+
+    /// Check if edits are being journaled
+    bool isOpen() const { return !filename_.empty(); }
+
+    /// Log an edit
+    void record(size_t offset, size_t removed, StringView inserted);
+
+    /// Remember the current position in the log, e.g. when a save starts
+    ///
+    /// Edits from here on are kept in memory until the mark is rebased or
+    /// released.
+    uint64_t mark();
+
+    /// The file named filename now holds the content as of mark
+    ///
+    /// Restarts the journal against the file on disk, keeping only the
+    /// edits made after mark.
+    void rebase(uint64_t mark, const std::string& filename);
+
+    /// Forget a mark whose save did not happen
+    void release(uint64_t mark);
+
+    /// Block until everything logged so far has been written
+    void flush();
+
+    /// Check if logged edits are waiting for the writer or being written
+    bool isWriting() const;
+
+    /// Check if the last batch failed to reach the disk; cleared once a
+    /// later batch rewrites the journal
+    bool writeFailed() const { return failed_.load(std::memory_order_relaxed); }
+
+private:
+    // Owned by the calling thread
+    std::string filename_;
+    std::string header_;
+    bool headerQueued_ = false;
+    uint64_t sequence_ = 0;                // Records logged so far
+    std::deque<std::string> retained_;     // Encoded records since the oldest mark
+    uint64_t retainedFrom_ = 0;
+    std::multiset<uint64_t> marks_;
+
+    // Handoff to the writer thread
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable written_;
+    std::string path_;                     // Journal file to write
+    unsigned mode_ = 0600;                 // Permissions it is created with
+    std::vector<std::string> removals_;    // Journal files to delete first
+    bool truncate_ = false;                // Start path_ over
+    std::string pending_;
+    bool urgent_ = false;                  // Write without waiting for more edits
+    bool writing_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+    std::atomic<bool> failed_{false};
+
+    // Owned by the writer thread
+    std::FILE* file_ = nullptr;
+    std::string filePath_;
+    std::string contents_;                 // What filePath_ should hold
+    bool rewrite_ = false;                 // filePath_ may be torn; write it over
+
+    /// Queue bytes to append; the lock must be held
+    void queue(const std::string& bytes);
+
+    void trimRetained();
+
+    /// Check if the writer has anything to do; the lock must be held
+    bool hasWork() const;
+
+    /// Start the writer if needed and wake it; the lock must be held
+    void startWriter();
+    void run();
+
+    /// Bring the journal file at path up to date with contents_, given the
+    /// bytes just added to it; false if they did not all reach the disk
+    bool writeBatch(const std::string& path, bool truncate, unsigned mode,
+                    const std::string& bytes);
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_JOURNAL_H
@@ -0,0 +1,106 @@
+#ifndef ASTRAX_LINE_INDEX_H
+#define ASTRAX_LINE_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief Line terminator convention of a file
+ */
+enum class LineEnding {
+    LF,
+    CRLF
+};
+
+/// Line ending used for new buffers
+#ifdef ASTRAX_PLATFORM_WINDOWS
+constexpr LineEnding NATIVE_LINE_ENDING = LineEnding::CRLF;
+#else
+constexpr LineEnding NATIVE_LINE_ENDING = LineEnding::LF;
+#endif
+
+/**
+ * @brief Running totals of a newline scan
+ *
+ * Scans may be split into consecutive calls; pendingCr carries a '\r' at
+ * the end of one call over to a '\n' at the start of the next.
+ */
+struct NewlineStats {
+    size_t newlines = 0;     // '\n' bytes
+    size_t crlf = 0;         // '\n' bytes preceded by '\r'
+    bool pendingCr = false;  // Last byte scanned was '\r'
+
+    /// Majority convention; LF when there are no newlines
+    LineEnding lineEnding() const {
+        return crlf * 2 > newlines ? LineEnding::CRLF : LineEnding::LF;
+    }
+};
+
+/// Count '\n' bytes in [data, data + size), updating stats
+///
+/// Uses AVX2 or SSE2 when the CPU supports them, scalar code otherwise.
+size_t countNewlines(const char* data, size_t size, NewlineStats& stats);
+
+/// Count '\n' bytes in [data, data + size)
+size_t countNewlines(const char* data, size_t size);
+
+/// Name of the kernel selected for this CPU ("avx2", "sse2" or "scalar")
+const char* newlineKernelName();
+
+/**
+ * @brief Compact, sorted array of newline offsets
+ *
+ * Offsets are stored as 32-bit values; for text over 4 GB a small table
+ * records where each further 4 GB segment starts, so memory stays at four
+ * bytes per line regardless of file size.
+ */
+class LineIndex {
+public:
+    /// Index every '\n' in [data, data + size)
+    void build(const char* data, size_t size);
+
+    /// Append a newline offset (must not be less than the last one)
+    void append(size_t offset);
+
+    /// Drop the last offset
+    void removeLast();
+
+    /// Remove the '\r' of every "\r\n" from text, adjusting the offsets
+    ///
+    /// text must be the string this index was built from. Runs in one
+    /// pass of block moves between newlines.
+    void stripCarriageReturns(std::string& text);
+
+    /// Number of newlines
+    size_t size() const { return low_.size(); }
+    bool empty() const { return low_.empty(); }
+
+    /// Offset of the i-th newline
+    size_t operator[](size_t i) const;
+
+    /// Index of the first newline at or after offset (size() if none)
+    size_t lowerBound(size_t offset) const;
+
+    /// Statistics gathered by build()
+    const NewlineStats& stats() const { return stats_; }
+
+    /// Dominant line ending of the indexed text
+    LineEnding lineEnding() const { return stats_.lineEnding(); }
+
+    /// Approximate heap footprint in bytes
+    size_t memoryUsage() const;
+
+private:
+    std::vector<uint32_t> low_;        // Low 32 bits of each offset
+    std::vector<size_t> segments_;     // First index in each 4 GB segment
+    NewlineStats stats_;
+
+    size_t segmentOf(size_t index) const;
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_LINE_INDEX_H
@@ -0,0 +1,55 @@
+#ifndef ASTRAX_LITERAL_SEARCHER_H
+#define ASTRAX_LITERAL_SEARCHER_H
+
+#include <cstddef>
+#include <string>
+
+namespace astrax {
+
+/**
+ * @brief Finds a literal string in text, optionally ignoring ASCII case
+ *
+ * Candidates are found by comparing two probe bytes of the pattern, the
+ * rarest ones by typical text frequency, at every position at once: 32
+ * positions per step with AVX2, 16 with SSE2, or with memchr on the rarer
+ * probe where neither is available. Only candidates are compared in full,
+ * against a copy of the pattern case-folded once up front.
+ */
+class LiteralSearcher {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    
+    /// Byte of the pattern that candidates are filtered on
+    struct Probe {
+        size_t offset = 0;         // Position in the pattern
+        unsigned char byte = 0;    // Expected byte, lower case if folded
+        unsigned char fold = 0;    // 0x20 if case is ignored for this byte
+    };
+    
+    LiteralSearcher() = default;
+    LiteralSearcher(const std::string& pattern, bool caseSensitive);
+    
+    /// Position of the first match starting at or after from; npos if none
+    size_t find(const char* data, size_t size, size_t from = 0) const;
+    size_t find(const std::string& text, size_t from = 0) const {
+        return find(text.data(), text.size(), from);
+    }
+    
+    /// Check if the pattern matches at data (size() bytes must be readable)
+    bool matchesAt(const char* data) const;
+    
+    size_t size() const { return pattern_.size(); }
+    bool empty() const { return pattern_.empty(); }
+    
+    /// Probe bytes, rarer first (both the same for a one-byte pattern)
+    const Probe& probe(size_t index) const { return probes_[index]; }
+    
+private:
+    std::string pattern_;   // Lower case unless case-sensitive
+    bool caseSensitive_ = true;
+    Probe probes_[2];
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_LITERAL_SEARCHER_H
@@ -0,0 +1,87 @@
+#ifndef ASTRAX_MAPPED_FILE_H
+#define ASTRAX_MAPPED_FILE_H
+
+#include "piece_table.h"
+#include "line_index.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief Read-only memory mapping of a file used as an original text block
+ *
+ * The file bytes back the piece table directly; edits go to add blocks, so
+ * the mapping is never written and pages are only read when touched. The
+ * newline index is coarse: one count per CHUNK_SIZE bytes. Positions inside
+ * a chunk are found on demand with a bounded scan, which keeps the index at
+ * a few bytes per megabyte instead of one entry per line.
+ *
+ * The index is built front to back by indexTo(); newline queries are only
+ * valid below indexedSize(). Indexing may run on a loader thread while
+ * other threads query the already indexed prefix: the count of indexed
+ * chunks is published with release ordering after their entries are
+ * written, and queries never look at entries past it.
+ */
+class MappedFile : public TextBlock {
+public:
+    /// Granularity of the newline index
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    ~MappedFile() override;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// Map a file read-only; returns nullptr on failure
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+    
+    /// Extend the newline index to cover at least [0, end)
+    void indexTo(size_t end);
+    
+    /// Bytes covered by the newline index
+    size_t indexedSize() const;
+
+    /// Newline totals of the indexed prefix, including CRLF pairs
+    ///
+    /// Only for the thread calling indexTo().
+    const NewlineStats& stats() const { return stats_; }
+
+    /// Check if path refers to the mapped file (same device and inode)
+    bool isSameFile(const std::string& path) const;
+    
+#ifndef ASTRAX_PLATFORM_WINDOWS
+    /// Read-only descriptor of the mapped file, for in-kernel copies
+    int descriptor() const { return fd_; }
+#endif
+
+    size_t countNewlines(size_t start, size_t length) const override;
+    size_t nthNewline(size_t start, size_t length, size_t n) const override;
+
+private:
+    MappedFile() = default;
+
+    void initIndex();
+
+    /// Newlines before offset
+    size_t newlinesBefore(size_t offset) const;
+
+    std::vector<size_t> chunkNewlines_;   // Newlines before each chunk start
+    std::atomic<size_t> indexedChunks_{0};
+    NewlineStats stats_;                  // Owned by the indexing thread
+    uint64_t device_ = 0;
+    uint64_t inode_ = 0;
+#ifdef ASTRAX_PLATFORM_WINDOWS
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_MAPPED_FILE_H
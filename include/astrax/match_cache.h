@@ -0,0 +1,94 @@
+#ifndef ASTRAX_MATCH_CACHE_H
+#define ASTRAX_MATCH_CACHE_H
+
+#include "buffer.h"
+#include "search.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief Read-only view of the matches in one line
+ */
+struct MatchSpan {
+    const LineMatch* matches = nullptr;
+    size_t count = 0;
+    
+    const LineMatch* begin() const { return matches; }
+    const LineMatch* end() const { return matches + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const LineMatch& operator[](size_t index) const { return matches[index]; }
+};
+
+/**
+ * @brief Matches of the search pattern in the lines around the viewport
+ *
+ * Only a window of lines is searched: the visible ones plus MARGIN_LINES
+ * on either side, so a short scroll finds its new lines already searched.
+ * Lines that stay in the window as it moves keep their matches.
+ *
+ * Edits are followed the way HighlightCache follows them: the buffer's
+ * line changes shift the lines below an edit to their new numbers and
+ * forget only the lines the edit rewrote, which the next prepare()
+ * searches again. A new pattern, or a buffer whose changes are no longer
+ * known, starts the window over.
+ */
+class MatchCache {
+public:
+    /// Lines searched above and below the requested ones
+    static constexpr size_t MARGIN_LINES = 64;
+    
+    MatchCache() = default;
+    
+    /// Have the matches of lines [firstLine, endLine) of the buffer as it
+    /// is now, and of the margin around them, searching the lines not
+    /// searched since they last changed
+    void prepare(const Buffer& buffer, const Search& search, size_t firstLine, size_t endLine);
+    
+    /// Matches of a line in the prepared window; empty outside it
+    ///
+    /// The span is valid until the next prepare().
+    MatchSpan lineMatches(size_t line) const;
+    
+    /// Forget every line
+    void clear();
+    
+    /// Lines searched so far, counting each time a line is searched again
+    size_t searchedLines() const { return searchedLines_; }
+    
+private:
+    struct Line {
+        bool known = false;               // Searched since it last changed
+        std::vector<LineMatch> matches;
+    };
+    
+    // What the window was searched for
+    std::string pattern_;
+    SearchOptions options_;
+    uint64_t bufferId_ = 0;
+    uint64_t changeCount_ = 0;
+    std::vector<LineChange> changes_;     // Scratch for prepare()
+    
+    // lines_[i] holds line first_ + i
+    size_t first_ = 0;
+    std::vector<Line> lines_;
+    std::vector<Line> moved_;             // Scratch for moving the window
+    std::string scratch_;                 // Lines split across pieces
+    size_t searchedLines_ = 0;
+    
+    /// Check if the window was searched with this pattern and these options
+    bool sameSearch(const Search& search) const;
+    
+    void applyChange(const LineChange& change);
+    
+    /// Make the window cover [first, end), keeping the lines it already has
+    void moveWindow(size_t first, size_t end);
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_MATCH_CACHE_H
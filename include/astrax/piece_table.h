@@ -0,0 +1,253 @@
+#ifndef ASTRAX_PIECE_TABLE_H
+#define ASTRAX_PIECE_TABLE_H
+
+#include "types.h"
+#include "line_index.h"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief Contiguous, immutable run of document bytes
+ *
+ * The original block holds the loaded file (in memory or mapped) and
+ * carries a newline index. Add blocks hold inserted text; bytes are written
+ * once at the tail and never modified afterwards, so pieces can reference
+ * them freely.
+ */
+class TextBlock {
+public:
+    virtual ~TextBlock() = default;
+    
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    
+    /// Check if newline queries are answered from an index (original blocks)
+    bool isIndexed() const { return indexed_; }
+    
+    /// Number of '\n' bytes in [start, start + length)
+    virtual size_t countNewlines(size_t start, size_t length) const;
+    
+    /// Offset relative to start of the n-th (1-based) '\n' in
+    /// [start, start + length), or length if there are fewer than n
+    virtual size_t nthNewline(size_t start, size_t length, size_t n) const;
+
+protected:
+    TextBlock() = default;
+    
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool indexed_ = false;
+};
+
+/**
+ * @brief Piece table storage engine
+ *
+ * Text lives in an immutable original block plus append-only add blocks.
+ * The document is a sequence of pieces (block ranges) kept in a persistent
+ * treap ordered by document offset. Every node caches its subtree byte and
+ * newline counts, so offset and line lookups as well as edits are
+ * O(log pieces). Nodes are never mutated once built, which makes copying a
+ * PieceTable O(1) and safe to read from another thread.
+ */
+class PieceTable {
+public:
+    PieceTable();
+    
+    /// Take ownership of text as the original block (one allocation, no copy)
+    explicit PieceTable(std::string text);
+    
+    /// Same, reusing a newline index already built for text
+    PieceTable(std::string text, LineIndex index);
+    
+    /// Copies share all pieces; the copy starts a fresh add block on insert
+    PieceTable(const PieceTable& other);
+    PieceTable& operator=(const PieceTable& other);
+    PieceTable(PieceTable&&) noexcept = default;
+    PieceTable& operator=(PieceTable&&) noexcept = default;
+    
+    // ========================================================================
+    // Queries
+    // ========================================================================
+    
+    /// Total document size in bytes
+    size_t size() const;
+    
+    /// Number of lines (newline count + 1)
+    size_t lineCount() const;
+    
+    /// Number of pieces in the tree
+    size_t pieceCount() const;
+    
+    /// Offset of the first byte of a line (clamped to size())
+    size_t lineStart(size_t line) const;
+    
+    /// Length of a line, excluding its newline
+    size_t lineLength(size_t line) const;
+    
+    /// Line containing a byte offset
+    size_t lineOfOffset(size_t offset) const;
+    
+    /// Byte at offset (offset must be < size())
+    char charAt(size_t offset) const;
+    
+    /// View of a line, excluding its newline
+    ///
+    /// Points into block storage when the line lies in a single piece,
+    /// otherwise the line is assembled in scratch. The view is valid until
+    /// the table is modified or scratch is reused.
+    StringView lineView(size_t line, std::string& scratch) const;
+    
+    /// Copy a range of text
+    std::string text(size_t offset, size_t length) const;
+    
+    /// Copy the whole document
+    std::string text() const { return text(0, size()); }
+    
+    /// Visit the contiguous chunks covering [offset, offset + length) in order
+    template <typename Fn>
+    void forEachChunk(size_t offset, size_t length, Fn&& fn) const {
+        visitChunks(root_.get(), offset, length, fn);
+    }
+    
+    /// Visit lines [firstLine, endLine) in order as fn(line, view)
+    ///
+    /// Walks the chunks once, so it is much cheaper than lineView() per
+    /// line. A line spanning pieces is assembled in scratch; each view is
+    /// valid only during its call.
+    template <typename Fn>
+    void forEachLine(size_t firstLine, size_t endLine, std::string& scratch, Fn&& fn) const {
+        endLine = std::min(endLine, lineCount());
+        if (firstLine >= endLine) {
+            return;
+        }
+        size_t begin = lineStart(firstLine);
+        size_t end = endLine < lineCount() ? lineStart(endLine) : size();
+        size_t line = firstLine;
+        bool partial = false;   // scratch holds the start of the current line
+        scratch.clear();
+        
+        forEachChunk(begin, end - begin, [&](const char* data, size_t length) {
+            const char* stop = data + length;
+            while (data < stop) {
+                const char* newline = static_cast<const char*>(
+                    std::memchr(data, '\n', static_cast<size_t>(stop - data)));
+                if (!newline) {
+                    scratch.append(data, static_cast<size_t>(stop - data));
+                    partial = true;
+                    return;
+                }
+                if (partial) {
+                    scratch.append(data, static_cast<size_t>(newline - data));
+                    fn(line++, StringView(scratch.data(), scratch.size()));
+                    scratch.clear();
+                    partial = false;
+                } else {
+                    fn(line++, StringView(data, static_cast<size_t>(newline - data)));
+                }
+                data = newline + 1;
+            }
+        });
+        
+        // The last line of the document ends without a newline
+        if (line < endLine) {
+            fn(line, StringView(scratch.data(), scratch.size()));
+        }
+    }
+    
+    // ========================================================================
+    // Editing
+    // ========================================================================
+    
+    /// Insert bytes at offset (clamped to size())
+    void insert(size_t offset, const char* text, size_t length);
+    void insert(size_t offset, StringView text) { insert(offset, text.data(), text.size()); }
+    
+    /// Erase bytes starting at offset (clamped to the document)
+    void erase(size_t offset, size_t length);
+    
+    /// Append [start, start + length) of an original block to the document
+    ///
+    /// Used while loading: a range continuing the last piece extends it.
+    void append(std::shared_ptr<const TextBlock> block, size_t start, size_t length);
+    
+    /// Append text as a new original block with its newline index
+    void append(std::string text, LineIndex index);
+    
+private:
+    struct Piece {
+        const TextBlock* block = nullptr;
+        size_t start = 0;
+        size_t length = 0;
+        size_t newlines = 0;
+    };
+    
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+    
+    struct Node {
+        Piece piece;
+        uint32_t priority;
+        NodePtr left;
+        NodePtr right;
+        size_t length;     // Bytes in subtree
+        size_t newlines;   // Newlines in subtree
+        size_t pieces;     // Pieces in subtree
+        
+        Node(const Piece& p, uint32_t prio, NodePtr l, NodePtr r);
+    };
+    
+    class AddBlock;
+    
+    NodePtr root_;
+    std::vector<std::shared_ptr<const TextBlock>> blocks_;  // Keeps pieces alive
+    std::shared_ptr<AddBlock> addBlock_;                     // Block we may append to
+    uint32_t seed_ = 0x9E3779B9u;
+    
+    /// Largest piece created from inserted text; bounds newline scans
+    static constexpr size_t MAX_ADD_PIECE = 64 * 1024;
+    static constexpr size_t ADD_BLOCK_SIZE = 256 * 1024;
+    
+    uint32_t nextPriority();
+    NodePtr makeNode(const Piece& piece, uint32_t priority,
+                     NodePtr left, NodePtr right) const;
+    Piece slice(const Piece& piece, size_t from, size_t length) const;
+    size_t nthNewline(const Piece& piece, size_t n) const;
+    size_t findNewline(size_t n) const;
+    
+    void split(const NodePtr& node, size_t offset, NodePtr& left, NodePtr& right) const;
+    NodePtr merge(const NodePtr& left, const NodePtr& right) const;
+    NodePtr appendToLast(const NodePtr& node, size_t extra, size_t newlines) const;
+    const Node* lastNode(const Node* node) const;
+    
+    template <typename Fn>
+    static void visitChunks(const Node* node, size_t offset, size_t length, Fn& fn) {
+        while (node && length > 0) {
+            size_t leftLength = node->left ? node->left->length : 0;
+            if (offset < leftLength) {
+                size_t taken = std::min(length, leftLength - offset);
+                visitChunks(node->left.get(), offset, taken, fn);
+                offset = leftLength;
+                length -= taken;
+                if (length == 0) return;
+            }
+            size_t inPiece = offset - leftLength;
+            if (inPiece < node->piece.length) {
+                size_t taken = std::min(length, node->piece.length - inPiece);
+                fn(node->piece.block->data() + node->piece.start + inPiece, taken);
+                length -= taken;
+                offset += taken;
+            }
+            offset -= leftLength + node->piece.length;
+            node = node->right.get();
+        }
+    }
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_PIECE_TABLE_H
@@ -0,0 +1,148 @@
+#ifndef ASTRAX_REGEX_H
+#define ASTRAX_REGEX_H
+
+#include "literal_searcher.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace astrax {
+
+class RegexCompiler;
+
+/**
+ * @brief Regular expression matcher that runs in linear time
+ *
+ * Supports the ECMAScript subset typed into searches: literals and escapes,
+ * ".", classes with ranges and \d \w \s (and their negations), groups,
+ * "|", the greedy and lazy quantifiers * + ? {n} {n,} {n,m}, and the
+ * assertions ^ $ \b \B. Backreferences and lookaround are rejected, since
+ * no automaton can match them in linear time. Text is matched byte by byte,
+ * and case folding covers ASCII letters.
+ *
+ * The pattern compiles to a Thompson NFA. A search skips to the literal
+ * every match starts with, if the pattern has one, then runs a DFA built
+ * lazily from sets of NFA states to learn whether the text matches at all.
+ * Only text that does is simulated on the NFA itself (a Pike VM), which
+ * finds the match ECMAScript's backtracking would prefer. Each stage is
+ * linear in the length of the text.
+ *
+ * The DFA is cached between searches, so a Regex must not search on
+ * several threads at once; give each thread its own copy.
+ */
+class Regex {
+public:
+    /// Longest compiled program, in instructions
+    static constexpr size_t MAX_PROGRAM = 20000;
+    
+    /// Largest count in a {n,m} quantifier
+    static constexpr size_t MAX_REPEAT = 1000;
+    
+    /// DFA states cached before the cache starts over
+    static constexpr size_t MAX_DFA_STATES = 2048;
+    
+    Regex() = default;
+    
+    /// Compile a pattern; on error returns false with a message in error
+    bool compile(const std::string& pattern, bool caseSensitive, std::string& error);
+    
+    /// Find the leftmost match starting at or after from
+    ///
+    /// Assertions see the whole text, so ^ only matches at its start and
+    /// \b looks at the byte before from.
+    bool search(const char* data, size_t size, size_t from, size_t& start, size_t& length) const;
+    bool search(const std::string& text, size_t from, size_t& start, size_t& length) const {
+        return search(text.data(), text.size(), from, start, length);
+    }
+    
+    /// Check if a pattern has been compiled
+    bool empty() const { return program_.empty(); }
+    
+    /// Literal every match starts with, used to skip ahead; may be empty
+    const LiteralSearcher& prefix() const { return prefix_; }
+    
+private:
+    friend class RegexCompiler;
+    
+    enum class Op : uint8_t {
+        Byte,               // Consume a byte in sets_[x]
+        Split,              // Continue at x, or failing that at y
+        Jump,               // Continue at x
+        Match,
+        LineStart,          // ^
+        LineEnd,            // $
+        WordBoundary,       // \b
+        NotWordBoundary     // \B
+    };
+    
+    struct Inst {
+        Op op;
+        uint32_t x;
+        uint32_t y;
+    };
+    
+    struct ByteSet {
+        uint64_t bits[4] = {};
+        
+        void add(unsigned char c) { bits[c >> 6] |= uint64_t(1) << (c & 63); }
+        bool has(unsigned char c) const { return (bits[c >> 6] >> (c & 63)) & 1; }
+    };
+    
+    /// A thread of the Pike VM: where it is and where its match began
+    struct Thread {
+        uint32_t pc;
+        size_t start;
+    };
+    
+    /// A set of NFA states; pcs lists its Byte instructions, sorted
+    struct DfaState {
+        std::vector<uint32_t> pcs;
+        bool matched = false;       // A match ends here
+        bool matchedAtEnd = false;  // A match ends here if the text does
+    };
+    
+    enum class DfaResult { NoMatch, Match, GaveUp };
+    
+    std::vector<Inst> program_;
+    std::vector<ByteSet> sets_;
+    LiteralSearcher prefix_;
+    bool dfaUsable_ = false;        // False with \b or \B, which look back
+    
+    // Bytes no set tells apart share a class, which keeps DFA rows short
+    unsigned char classOf_[256] = {};
+    std::vector<unsigned char> classByte_;   // A byte of each class
+    
+    // Lazily built DFA; row i of dfaNext_ holds state i's transitions by
+    // byte class, -1 where not built yet
+    mutable std::vector<DfaState> dfaStates_;
+    mutable std::vector<int32_t> dfaNext_;
+    mutable std::map<std::vector<uint32_t>, int32_t> dfaIndex_;
+    mutable int32_t dfaStart_[2] = {-1, -1};   // Elsewhere, at text start
+    
+    // Scratch
+    mutable std::vector<uint32_t> marks_;      // Generation that visited each pc
+    mutable uint32_t generation_ = 0;
+    mutable std::vector<uint32_t> stack_;
+    mutable std::vector<uint32_t> seeds_;
+    mutable std::vector<uint32_t> key_;
+    mutable std::vector<Thread> threads_;
+    mutable std::vector<Thread> nextThreads_;
+    
+    void finish(bool caseSensitive, const std::string& prefix);
+    void nextGeneration() const;
+    
+    DfaResult dfaSearch(const char* data, size_t size, size_t from) const;
+    int32_t dfaState(bool atTextStart) const;
+    int32_t dfaStep(int32_t state, unsigned char byteClass) const;
+    void dfaReset() const;
+    
+    bool nfaSearch(const char* data, size_t size, size_t from, size_t& start, size_t& length) const;
+    void addThread(std::vector<Thread>& list, uint32_t pc, size_t start,
+                   const char* data, size_t size, size_t pos) const;
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_REGEX_H
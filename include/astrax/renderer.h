@@ -4,9 +4,16 @@
 #include "types.h"
 #include "terminal.h"
 #include "buffer.h"
+#include "config.h"
+#include "match_cache.h"
+#include "screen_grid.h"
+#include "search.h"
+#include "syntax/highlight_cache.h"
+#include "syntax/highlight_worker.h"
 #include "syntax/highlighter.h"
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace astrax {
 
@@ -28,6 +35,19 @@ struct Viewport {
  * 
  * Handles syntax highlighting, line numbers, status bar,
  * and efficient partial screen updates.
+ *
+ * Each frame is composed into a back grid of cells and compared with the
+ * front grid, which mirrors the terminal; only changed cells are sent.
+ * When the view scrolls vertically the terminal shifts the lines already
+ * on screen, leaving only the uncovered lines to be sent.
+ *
+ * A frame lexes at most SYNC_LEX_LINES lines to find where highlighting
+ * starts. Lines further than that are drawn plain and handed to a
+ * HighlightWorker; they are redrawn colored once its result arrives.
+ *
+ * Matches of the search set with setSearch() are drawn over the syntax
+ * colors, the one under the cursor in its own color. A MatchCache keeps
+ * them for the lines around the viewport.
  */
 class Renderer {
 public:
@@ -37,15 +57,21 @@ public:
     // Rendering
     // ========================================================================
     
-    /// Full screen render
+    /// Render a frame, sending only the cells that changed
     void render(const Buffer& buffer, EditorMode mode);
     
-    /// Refresh only changed portions (optimization)
+    /// Same as render()
     void refresh(const Buffer& buffer, EditorMode mode);
     
-    /// Force full redraw on next render
+    /// Force full redraw on next render (e.g. after other output)
     void invalidate() { needsFullRedraw_ = true; }
     
+    /// Check if the last frame left lines plain for the highlight worker
+    bool awaitingHighlights() const { return awaitingHighlights_; }
+    
+    /// Check if the highlight worker has a result for the next frame
+    bool highlightsArrived() const { return worker_ && worker_->hasResult(); }
+    
     // ========================================================================
     // Configuration
     // ========================================================================
@@ -53,6 +79,9 @@ public:
     /// Set syntax highlighter
     void setHighlighter(std::unique_ptr<ISyntaxHighlighter> highlighter);
     
+    /// Take colors from a theme; pens are derived once here, not per frame
+    void setTheme(const Theme& theme);
+    
     /// Enable/disable line numbers
     void showLineNumbers(bool show) { showLineNumbers_ = show; }
     
@@ -65,6 +94,12 @@ public:
     /// Set command line content (for command mode)
     void setCommandLine(const std::string& content) { commandLine_ = content; }
     
+    /// Set search progress, such as a match count, shown before the cursor position
+    void setSearchInfo(const std::string& info) { searchInfo_ = info; }
+    
+    /// Search whose matches are highlighted (not owned, may be null)
+    void setSearch(const Search* search) { search_ = search; }
+    
     // ========================================================================
     // Viewport
     // ========================================================================
@@ -82,6 +117,28 @@ private:
     ITerminal& terminal_;
     Viewport viewport_;
     std::unique_ptr<ISyntaxHighlighter> highlighter_;
+    HighlightCache highlights_;  // Lexer state per line for highlighter_
+    
+    // Background lexing for lines too far below the known states
+    std::unique_ptr<HighlightWorker> worker_;
+    std::unique_ptr<HighlightResult> workerResult_;   // Matches the buffer if set
+    bool awaitingHighlights_ = false;
+    
+    // Matches of search_ around the viewport
+    const Search* search_ = nullptr;
+    MatchCache matches_;
+    
+    /// Part of a line drawn in a search color
+    struct MatchOverlay {
+        size_t start;
+        size_t end;
+        const Pen* pen;
+    };
+    std::vector<MatchOverlay> overlays_;   // Scratch for renderLine()
+    Position cursor_;                      // Cursor of the frame being composed
+    
+    // Lines a frame lexes itself before leaving the rest to worker_
+    static constexpr size_t SYNC_LEX_LINES = 2000;
     
     // Display options
     bool showLineNumbers_ = true;
@@ -91,32 +148,58 @@ private:
     // Status
     std::string statusMessage_;
     std::string commandLine_;
+    std::string searchInfo_;
     bool needsFullRedraw_ = true;
     
-    // Theme colors
-    ColorPair normalColor_{Color::White, Color::Default};
-    ColorPair lineNumberColor_{Color::Yellow, Color::Default};
-    ColorPair statusBarColor_{Color::Black, Color::White};
-    ColorPair modeColors_[5] = {
-        {Color::Blue, Color::Default},     // Normal
-        {Color::Green, Color::Default},    // Insert
-        {Color::Red, Color::Default},      // Command
-        {Color::Magenta, Color::Default},  // Visual
-        {Color::Cyan, Color::Default}      // Search
-    };
+    // Screen contents: front_ is what the terminal shows, back_ the next frame
+    ScreenGrid front_;
+    ScreenGrid back_;
+    size_t frontTopLine_ = 0;      // Viewport front_ was drawn from
+    size_t frontLeftColumn_ = 0;
+    
+    // Unchanged cells a run of changes may span rather than moving the cursor
+    static constexpr int MAX_RUN_GAP = 4;
+    
+    // Output state while a frame is painted
+    bool painting_ = false;   // Cursor hidden, changes sent
+    
+    // Pens derived from the theme
+    static constexpr size_t TOKEN_TYPE_COUNT = static_cast<size_t>(TokenType::Bracket) + 1;
+    Pen tokenPens_[TOKEN_TYPE_COUNT];
+    Pen lineNumberPen_;
+    Pen statusBarPen_;
+    Pen searchMatchPen_;
+    Pen searchCurrentPen_;
+    Pen modePens_[5];
+    Pen tildePen_{Color::Blue};
+    Pen commandLinePen_{Color::White};
     
     // ========================================================================
     // Private Methods
     // ========================================================================
     
-    void renderLine(size_t lineIndex, const std::string& content, int screenY);
+    void renderLine(size_t lineIndex, StringView content, TokenSpan tokens, MatchSpan matches, int screenY);
+    
+    /// Take a worker result that matches the buffer
+    void takeHighlights(const Buffer& buffer);
+    
+    /// Tokens of a line; false if it is not lexed yet and budget ran out
+    bool lineTokens(const Buffer& buffer, size_t line, size_t& budget, TokenSpan& tokens);
     void renderStatusBar(const Buffer& buffer, EditorMode mode, int screenY);
-    void renderCommandLine(int screenY);
+    void renderCommandLine(EditorMode mode, int screenY);
+    
+    /// Shift the editor rows on screen to follow a vertical scroll
+    void scrollEditorArea(int editorHeight);
+    
+    /// Send the changed cells of a row
+    void paintRow(int screenY);
+    void beginPaint();
+    
     void updateViewportSize();
     int getLineNumberWidth(size_t totalLines) const;
     
-    ColorPair getModeColor(EditorMode mode) const {
-        return modeColors_[static_cast<int>(mode)];
+    const Pen& getModePen(EditorMode mode) const {
+        return modePens_[static_cast<int>(mode)];
     }
 };
 
@@ -0,0 +1,58 @@
+#ifndef ASTRAX_SCREEN_GRID_H
+#define ASTRAX_SCREEN_GRID_H
+
+#include "types.h"
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief One character cell of the screen
+ */
+struct Cell {
+    char ch = ' ';
+    Pen pen;
+    
+    bool operator==(const Cell& other) const { return ch == other.ch && pen == other.pen; }
+    bool operator!=(const Cell& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief A width x height matrix of cells
+ *
+ * The renderer composes each frame into one grid and compares it with the
+ * grid of the previous frame, so only changed cells reach the terminal.
+ */
+class ScreenGrid {
+public:
+    /// Change the size; all cells become blank
+    void resize(int width, int height);
+    
+    /// Make every cell blank
+    void clear();
+    
+    int width() const { return width_; }
+    int height() const { return height_; }
+    
+    /// First cell of a row
+    Cell* row(int y) { return &cells_[static_cast<size_t>(y) * static_cast<size_t>(width_)]; }
+    const Cell* row(int y) const { return &cells_[static_cast<size_t>(y) * static_cast<size_t>(width_)]; }
+    
+    /// Write text from (x, y), clipped to the row; returns the column after it
+    int put(int x, int y, StringView text, const Pen& pen);
+    
+    /// Set the pen of count cells from (x, y), clipped to the row
+    void paint(int x, int y, int count, const Pen& pen);
+    
+    /// Shift rows top..bottom up by lines (down if negative), blanking the rest
+    void scroll(int top, int bottom, int lines);
+    
+private:
+    int width_ = 0;
+    int height_ = 0;
+    std::vector<Cell> cells_;
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_SCREEN_GRID_H
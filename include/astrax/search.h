@@ -2,9 +2,12 @@
 #define ASTRAX_SEARCH_H
 
 #include "types.h"
+#include "literal_searcher.h"
+#include "piece_table.h"
+#include "regex.h"
+#include <atomic>
 #include <string>
 #include <vector>
-#include <regex>
 
 namespace astrax {
 
@@ -24,6 +27,14 @@ struct SearchMatch {
     operator bool() const { return valid; }
 };
 
+/**
+ * @brief Where a match lies within its line
+ */
+struct LineMatch {
+    size_t column = 0;
+    size_t length = 0;
+};
+
 /**
  * @brief Search direction
  */
@@ -43,11 +54,29 @@ struct SearchOptions {
     SearchDirection direction = SearchDirection::Forward;
 };
 
+/// Flag another thread sets to stop a scan early
+using CancelFlag = std::atomic<bool>;
+
 /**
  * @brief Search and replace engine
+ *
+ * Whole-text scans (findAll, countMatches) split texts of many lines into
+ * blocks that the shared ThreadPool searches in parallel, each thread with
+ * its own copy of the regex; matches still come back in text order.
+ *
+ * Scans of a PieceTable take an optional CancelFlag, checked between
+ * blocks, so a scan another thread no longer wants stops within a block.
+ * A cancelled findNext or findPrevious finds nothing, and a cancelled
+ * countMatches returns a partial count.
  */
 class Search {
 public:
+    /// Lines below which whole-text scans stay on the calling thread
+    static constexpr size_t PARALLEL_MIN_LINES = 16384;
+    
+    /// Lines per block handed to a scanning thread
+    static constexpr size_t BLOCK_LINES = 4096;
+    
     Search() = default;
     
     // ========================================================================
@@ -60,6 +89,9 @@ public:
     /// Get current pattern
     const std::string& getPattern() const { return pattern_; }
     
+    /// Get the options the pattern was set with
+    const SearchOptions& getOptions() const { return options_; }
+    
     /// Check if pattern is valid (for regex mode)
     bool isPatternValid() const { return patternValid_; }
     
@@ -71,20 +103,29 @@ public:
         const std::vector<std::string>& lines,
         Position from
     ) const;
+    SearchMatch findNext(const PieceTable& text, Position from,
+                         const CancelFlag* cancel = nullptr) const;
     
     /// Find previous match from position
     SearchMatch findPrevious(
         const std::vector<std::string>& lines,
         Position from
     ) const;
+    SearchMatch findPrevious(const PieceTable& text, Position from,
+                             const CancelFlag* cancel = nullptr) const;
     
     /// Find all matches
     std::vector<SearchMatch> findAll(
         const std::vector<std::string>& lines
     ) const;
+    std::vector<SearchMatch> findAll(const PieceTable& text) const;
     
-    /// Count matches
+    /// Append the matches in one line to matches, in findAll order
+    void matchLine(StringView line, std::vector<LineMatch>& matches) const;
+    
+    /// Count matches without building them
     size_t countMatches(const std::vector<std::string>& lines) const;
+    size_t countMatches(const PieceTable& text, const CancelFlag* cancel = nullptr) const;
     
     // ========================================================================
     // Replace
@@ -115,20 +156,44 @@ public:
     
     /// Navigate history (returns pattern at index, empty string if invalid)
     std::string getHistoryItem(size_t index) const;
-
+    
 private:
     std::string pattern_;
     SearchOptions options_;
     bool patternValid_ = true;
     std::string errorMessage_;
-    std::regex compiledRegex_;
+    Regex regex_;
+    LiteralSearcher literal_;
     
     std::vector<std::string> history_;
     static const size_t MAX_HISTORY = 100;
     
     // Helper methods
-    bool matchesAt(const std::string& line, size_t pos) const;
     size_t patternLength() const;
+    
+    /// First match in a line starting at or after from
+    bool matchFrom(StringView line, size_t from, size_t& col, size_t& length) const;
+    
+    /// Column of the last literal match starting at or before maxColumn
+    size_t findLastLiteral(StringView line, size_t maxColumn) const;
+    
+    /// Column and length of the last regex match starting at or before maxColumn
+    size_t findLastRegex(StringView line, size_t maxColumn, size_t& length) const;
+    
+    /// Regex to match with, or null for a literal search
+    const Regex* activeRegex() const { return options_.useRegex ? &regex_ : nullptr; }
+    
+    template <typename Lines>
+    SearchMatch findNextIn(const Lines& lines, Position from, const CancelFlag* cancel) const;
+    
+    template <typename Lines>
+    SearchMatch findPreviousIn(const Lines& lines, Position from, const CancelFlag* cancel) const;
+    
+    template <typename Lines>
+    std::vector<SearchMatch> findAllIn(const Lines& lines) const;
+    
+    template <typename Lines>
+    size_t countIn(const Lines& lines, const CancelFlag* cancel) const;
 };
 
 } // namespace astrax
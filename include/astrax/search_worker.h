@@ -0,0 +1,106 @@
+#ifndef ASTRAX_SEARCH_WORKER_H
+#define ASTRAX_SEARCH_WORKER_H
+
+#include "buffer.h"
+#include "piece_table.h"
+#include "search.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace astrax {
+
+/**
+ * @brief How far the worker got with the latest search
+ */
+struct SearchProgress {
+    uint64_t generation = 0;    // Returned by the start() this belongs to
+    uint64_t bufferId = 0;
+    uint64_t changeCount = 0;   // Buffer::changeCount() of the snapshot
+    
+    bool matchDone = false;
+    SearchMatch match;          // First match after the start position
+    
+    bool countDone = false;
+    size_t count = 0;           // Matches in the whole text
+};
+
+/**
+ * @brief Runs searches as the user types them, on a worker thread
+ *
+ * Each start() snapshots the buffer's table and hands the worker a copy of
+ * the search. The worker first finds the match after the start position,
+ * which is what the cursor jumps to, then counts every match in the text.
+ *
+ * A start() replaces any search still running: the old scan sees the
+ * cancel flag between blocks of lines and gives up, so typing on a huge
+ * file never queues up stale scans. Progress of the latest search is kept
+ * under a lock that the worker holds only to publish.
+ */
+class SearchWorker {
+public:
+    SearchWorker() = default;
+    
+    /// Cancels the current search and waits for the thread
+    ~SearchWorker();
+    
+    SearchWorker(const SearchWorker&) = delete;
+    SearchWorker& operator=(const SearchWorker&) = delete;
+    
+    /// Search the buffer as it is now from position from; returns the
+    /// generation its progress will carry
+    uint64_t start(const Buffer& buffer, const Search& search, Position from);
+    
+    /// Stop the current search and drop its progress
+    void cancel();
+    
+    /// Copy the latest search's progress; false if nothing changed since
+    /// the last poll
+    bool poll(SearchProgress& progress);
+    
+    /// Wait until the latest search has found its match or gave up, for at
+    /// most timeout; false on timeout or if no search is running
+    bool waitForMatch(std::chrono::milliseconds timeout);
+    
+    /// Check if a search is running or has progress not yet polled
+    bool busy() const;
+    
+private:
+    struct Job {
+        PieceTable snapshot;
+        Search search;
+        Position from;
+        uint64_t generation = 0;
+        uint64_t bufferId = 0;
+        uint64_t changeCount = 0;
+    };
+    
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;       // Signals a new job or shutdown
+    std::condition_variable progressed_; // Signals new progress
+    Job job_;
+    bool hasJob_ = false;
+    bool working_ = false;               // The worker is running a job
+    bool stop_ = false;
+    CancelFlag cancel_{false};           // A newer job is waiting, or none is wanted
+    std::thread thread_;
+    
+    // Progress of the latest job, under mutex_
+    uint64_t generation_ = 0;
+    SearchProgress progress_;
+    bool changed_ = false;               // Progress not yet polled
+    
+    void run();
+    void work(const Job& job);
+    
+    /// Publish progress of job generation, unless a newer job replaced it
+    template <typename Update>
+    void publish(uint64_t generation, Update&& update);
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_SEARCH_WORKER_H
@@ -2,17 +2,18 @@
 #define ASTRAX_CPP_HIGHLIGHTER_H
 
 #include "highlighter.h"
-#include <unordered_set>
 
 namespace astrax {
 
 /**
  * @brief C/C++ syntax highlighter
+ *
+ * Keywords, types and directives are looked up in compile-time perfect-hash
+ * tables, straight from the line, so constructing a highlighter does no
+ * work and classifying an identifier allocates nothing.
  */
 class CppHighlighter : public ISyntaxHighlighter {
 public:
-    CppHighlighter();
-    
     std::string getLanguage() const override { return "C++"; }
     
     std::vector<std::string> getExtensions() const override {
@@ -29,19 +30,26 @@ public:
         return inBlockComment_ || inRawString_; 
     }
     
+    HighlightState getState() const override {
+        return (inBlockComment_ ? BLOCK_COMMENT : 0u) | (inRawString_ ? RAW_STRING : 0u);
+    }
+    
+    void setState(HighlightState state) override {
+        inBlockComment_ = (state & BLOCK_COMMENT) != 0;
+        inRawString_ = (state & RAW_STRING) != 0;
+    }
+    
 private:
+    static constexpr HighlightState BLOCK_COMMENT = 1;
+    static constexpr HighlightState RAW_STRING = 2;
+    
     bool inBlockComment_ = false;
     bool inRawString_ = false;
     std::string rawStringDelimiter_;
     
-    std::unordered_set<std::string> keywords_;
-    std::unordered_set<std::string> types_;
-    std::unordered_set<std::string> preprocessor_;
-    
-    void initializeKeywords();
-    
-    bool isKeyword(const std::string& word) const;
-    bool isType(const std::string& word) const;
+    static bool isKeyword(StringView word);
+    static bool isType(StringView word);
+    static bool isDirective(StringView name);
     bool isNumber(const std::string& word) const;
     
     size_t skipString(const std::string& line, size_t start, std::vector<Token>& tokens);
@@ -0,0 +1,98 @@
+#ifndef ASTRAX_SYNTAX_HIGHLIGHT_CACHE_H
+#define ASTRAX_SYNTAX_HIGHLIGHT_CACHE_H
+
+#include "highlighter.h"
+#include "token_cache.h"
+#include "../buffer.h"
+#include "../piece_table.h"
+#include <string>
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief Lexer state at the start of every line, kept across edits
+ *
+ * A line can only be highlighted correctly from the state the lines above
+ * it leave behind, such as an open block comment. The cache lexes forward
+ * once and remembers the state at each line start. An edit invalidates the
+ * states from its first line on; re-lexing stops as soon as a line start
+ * past the edit gets the same state as before it, since everything below
+ * then lexes exactly as it did. Highlighting the visible lines therefore
+ * costs the visible lines plus whatever an edit really changed.
+ *
+ * Tokens of lexed lines are kept in a TokenCache, so a line seen before
+ * with the same text and start state is not lexed again.
+ *
+ * Lexing reads a PieceTable, so a cache can also follow a snapshot of a
+ * buffer on another thread, given the buffer's changes through apply().
+ */
+class HighlightCache {
+public:
+    HighlightCache();
+    
+    /// Highlighter to lex with (not owned, may be null); clears the cache
+    void setHighlighter(ISyntaxHighlighter* highlighter);
+    
+    /// Follow the buffer's changes since the last sync, or start over for
+    /// a different buffer
+    void sync(const Buffer& buffer);
+    
+    /// Follow line changes made to the text since the states were computed
+    void apply(const std::vector<LineChange>& changes);
+    
+    /// State at the start of a line, lexing forward as far as needed
+    HighlightState stateAt(const PieceTable& text, size_t line);
+    HighlightState stateAt(const Buffer& buffer, size_t line) { return stateAt(buffer.getTable(), line); }
+    
+    /// Lex forward until the state of a line is known, at most budget lines
+    ///
+    /// Returns false if the budget ran out first; budget is reduced by the
+    /// lines lexed, and a later call resumes where this one stopped.
+    bool advance(const PieceTable& text, size_t line, size_t& budget);
+    
+    /// Tokens of a line, lexed from its cached start state unless cached
+    ///
+    /// The span is valid until the next call.
+    TokenSpan highlightLine(const PieceTable& text, size_t line);
+    TokenSpan highlightLine(const Buffer& buffer, size_t line) { return highlightLine(buffer.getTable(), line); }
+    
+    /// Forget every state
+    void clear();
+    
+    /// Line starts whose state is known to be exact
+    size_t validLines() const { return valid_; }
+    
+    /// Copy the exact states, one per line start from the first
+    void copyStates(std::vector<HighlightState>& states) const;
+    
+    /// Take exact states computed elsewhere for the same text, if they
+    /// reach further than the ones known here
+    void adopt(std::vector<HighlightState>& states);
+    
+private:
+    ISyntaxHighlighter* highlighter_ = nullptr;
+    uint64_t bufferId_ = 0;
+    uint64_t changeCount_ = 0;
+    std::vector<LineChange> changes_;  // Scratch for sync()
+    TokenCache tokens_;
+    std::vector<Token> lexed_;         // Scratch for highlightLine()
+    std::string lineScratch_;          // Lines split across pieces
+    std::string line_;                 // Line handed to the highlighter
+    
+    // states_[i] is the state at the start of line i. Entries below valid_
+    // are exact; those from valid_ up to the end predate the latest edits
+    // and are trusted again once re-lexing past dirtyEnd_ reproduces one.
+    std::vector<HighlightState> states_;
+    size_t valid_ = 1;
+    size_t dirtyEnd_ = 0;
+    
+    void applyChange(const LineChange& change);
+    
+    /// Line text as the highlighter takes it; valid until the next call
+    const std::string& lineText(const PieceTable& text, size_t line);
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_SYNTAX_HIGHLIGHT_CACHE_H
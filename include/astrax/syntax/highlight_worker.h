@@ -0,0 +1,128 @@
+#ifndef ASTRAX_SYNTAX_HIGHLIGHT_WORKER_H
+#define ASTRAX_SYNTAX_HIGHLIGHT_WORKER_H
+
+#include "highlighter.h"
+#include "highlight_cache.h"
+#include "token_cache.h"
+#include "../buffer.h"
+#include "../piece_table.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief Line states and tokens the worker computed for one buffer change
+ */
+struct HighlightResult {
+    uint64_t bufferId = 0;
+    uint64_t changeCount = 0;   // Buffer::changeCount() of the snapshot
+    
+    /// Exact state at the start of each line, from the first
+    std::vector<HighlightState> states;
+    
+    /// Tokens of the lines from firstLine on, tokenStarts[i] indexing the
+    /// first token of line firstLine + i; one extra entry ends the last line
+    size_t firstLine = 0;
+    std::vector<size_t> tokenStarts;
+    std::vector<Token> tokens;
+    
+    /// Check if the tokens of a line are included
+    bool covers(size_t line) const {
+        return line >= firstLine && line - firstLine + 1 < tokenStarts.size();
+    }
+    
+    /// Tokens of a covered line
+    TokenSpan lineTokens(size_t line) const {
+        size_t index = line - firstLine;
+        return TokenSpan{tokens.data() + tokenStarts[index], tokenStarts[index + 1] - tokenStarts[index]};
+    }
+};
+
+/**
+ * @brief Lexes buffer snapshots ahead of the viewport on a worker thread
+ *
+ * Finding the state a line starts in may take lexing everything above it,
+ * which for a large file is too slow to do while drawing a frame. The
+ * worker does that from a PieceTable snapshot, keeping its own
+ * HighlightCache that follows the buffer's line changes, so after the
+ * first pass it only re-lexes what edits change.
+ *
+ * Requests replace one another; a long pass stops early for a newer one
+ * and keeps the states it found. Each finished pass is published as a
+ * HighlightResult through a single atomic pointer, which take() swaps out
+ * without locking.
+ */
+class HighlightWorker {
+public:
+    /// Lines lexed past the end of the requested range
+    static constexpr size_t AHEAD_LINES = 256;
+    
+    /// Lines lexed between checks for a newer request
+    static constexpr size_t CHUNK_LINES = 4096;
+    
+    /// The worker lexes with its own highlighter
+    explicit HighlightWorker(std::unique_ptr<ISyntaxHighlighter> highlighter);
+    
+    /// Abandons the current pass and waits for the thread
+    ~HighlightWorker();
+    
+    HighlightWorker(const HighlightWorker&) = delete;
+    HighlightWorker& operator=(const HighlightWorker&) = delete;
+    
+    /// Ask for the states and tokens of lines [firstLine, lastLine) of the
+    /// buffer as it is now; repeating the latest request does nothing
+    void request(const Buffer& buffer, size_t firstLine, size_t lastLine);
+    
+    /// Take the newest result; null if none arrived since the last take
+    std::unique_ptr<HighlightResult> take();
+    
+    /// Check if a result is waiting to be taken
+    bool hasResult() const { return published_.load(std::memory_order_acquire) != nullptr; }
+    
+private:
+    struct Job {
+        PieceTable snapshot;
+        uint64_t bufferId = 0;
+        uint64_t changeCount = 0;
+        bool restart = false;               // Text unrelated to the last job's
+        std::vector<LineChange> changes;    // Since the last job, if not restart
+        size_t firstLine = 0;
+        size_t lastLine = 0;
+    };
+    
+    // Owned by the calling thread
+    uint64_t requestedId_ = 0;
+    uint64_t requestedCount_ = 0;
+    size_t requestedFirst_ = 0;
+    size_t requestedLast_ = 0;
+    std::vector<LineChange> changes_;   // Scratch for request()
+    
+    // Handoff to the worker thread
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    Job job_;
+    bool hasJob_ = false;
+    bool stop_ = false;
+    std::atomic<bool> interrupt_{false};   // A newer job is waiting
+    std::thread thread_;
+    
+    // Handoff back
+    std::atomic<HighlightResult*> published_{nullptr};
+    
+    // Owned by the worker thread
+    std::unique_ptr<ISyntaxHighlighter> highlighter_;
+    HighlightCache cache_;
+    
+    void run();
+    void work(Job& job);
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_SYNTAX_HIGHLIGHT_WORKER_H
@@ -8,6 +8,9 @@
 
 namespace astrax {
 
+/// Lexer state carried from the end of one line to the next; 0 at file start
+using HighlightState = uint32_t;
+
 /**
  * @brief Abstract interface for syntax highlighting
  */
@@ -32,6 +35,12 @@ public:
     
     /// Check if currently in a multiline construct
     virtual bool inMultilineConstruct() const = 0;
+    
+    /// Current state, to resume lexing at the next line later
+    virtual HighlightState getState() const = 0;
+    
+    /// Resume from a state returned by getState()
+    virtual void setState(HighlightState state) = 0;
 };
 
 /**
@@ -0,0 +1,84 @@
+#ifndef ASTRAX_SYNTAX_KEYWORD_TABLE_H
+#define ASTRAX_SYNTAX_KEYWORD_TABLE_H
+
+#include "../types.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace astrax {
+
+/**
+ * @brief Fixed word set with a perfect hash, built at compile time
+ *
+ * Each word hashes, with the table's seed, to a slot of its own, so a
+ * lookup is one hash of the candidate and at most one comparison. Words
+ * are string literals referenced in place; nothing is allocated, and a
+ * constexpr table costs nothing at startup.
+ *
+ * The seed is chosen by hand: check perfect() with a static_assert where
+ * the table is defined, and try other seeds if a new word collides.
+ */
+template <size_t SLOTS>
+class KeywordTable {
+    static_assert((SLOTS & (SLOTS - 1)) == 0, "SLOTS must be a power of two");
+    
+public:
+    template <size_t N>
+    constexpr KeywordTable(const char* const (&words)[N], uint32_t seed) : seed_(seed) {
+        for (size_t i = 0; i < N; ++i) {
+            size_t length = lengthOf(words[i]);
+            size_t slot = hash(words[i], length, seed) & (SLOTS - 1);
+            if (words_[slot] != nullptr) {
+                perfect_ = false;
+            }
+            words_[slot] = words[i];
+            lengths_[slot] = length;
+        }
+    }
+    
+    /// Check if every word got a slot of its own
+    constexpr bool perfect() const { return perfect_; }
+    
+    /// Check if a word is in the set
+    constexpr bool contains(const char* word, size_t length) const {
+        size_t slot = hash(word, length, seed_) & (SLOTS - 1);
+        if (lengths_[slot] != length || words_[slot] == nullptr) {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i) {
+            if (words_[slot][i] != word[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    bool contains(StringView word) const { return contains(word.data(), word.size()); }
+    
+private:
+    const char* words_[SLOTS] = {};
+    size_t lengths_[SLOTS] = {};
+    uint32_t seed_;
+    bool perfect_ = true;
+    
+    static constexpr size_t lengthOf(const char* word) {
+        size_t length = 0;
+        while (word[length] != '\0') {
+            ++length;
+        }
+        return length;
+    }
+    
+    /// FNV-1a over the bytes, seeded and mixed with the length
+    static constexpr size_t hash(const char* word, size_t length, uint32_t seed) {
+        uint32_t value = seed ^ static_cast<uint32_t>(length);
+        for (size_t i = 0; i < length; ++i) {
+            value = (value ^ static_cast<unsigned char>(word[i])) * 16777619u;
+        }
+        return value ^ (value >> 15);
+    }
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_SYNTAX_KEYWORD_TABLE_H
@@ -0,0 +1,84 @@
+#ifndef ASTRAX_SYNTAX_TOKEN_CACHE_H
+#define ASTRAX_SYNTAX_TOKEN_CACHE_H
+
+#include "highlighter.h"
+#include <cstdint>
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief Read-only view of consecutive tokens
+ */
+struct TokenSpan {
+    const Token* tokens = nullptr;
+    size_t count = 0;
+    
+    const Token* begin() const { return tokens; }
+    const Token* end() const { return tokens + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const Token& operator[](size_t index) const { return tokens[index]; }
+};
+
+/**
+ * @brief Bounded map from (entry state, line content) to the line's tokens
+ *
+ * A line's tokens depend only on its text and the lexer state it starts
+ * in, so lines that scroll back into view, or that did not change, need
+ * no lexing. Lines are identified by a 64-bit hash of their text plus
+ * their length; the text itself is not kept. Tokens live in one flat
+ * arena, and the whole cache is dropped when either the arena or the
+ * table fills up, so memory stays fixed and lookups never allocate.
+ */
+class TokenCache {
+public:
+    /// Lines cached at most
+    static constexpr size_t MAX_LINES = 4096;
+    
+    /// Tokens cached at most, over all lines
+    static constexpr size_t MAX_TOKENS = 64 * 1024;
+    
+    TokenCache();
+    
+    /// Hash of a line's text
+    static uint64_t hashLine(StringView text);
+    
+    /// Look up the tokens of a line; false if not cached
+    bool find(HighlightState state, uint64_t hash, size_t length, TokenSpan& tokens) const;
+    
+    /// Cache the tokens of a line; returns them as stored
+    ///
+    /// Spans stay valid until the next insert() or clear().
+    TokenSpan insert(HighlightState state, uint64_t hash, size_t length, const std::vector<Token>& tokens);
+    
+    /// Drop every line
+    void clear();
+    
+    /// Lines cached
+    size_t size() const { return size_; }
+    
+private:
+    struct Entry {
+        uint64_t hash = 0;
+        uint64_t length = 0;
+        HighlightState state = 0;
+        uint32_t first = 0;   // Index of the first token in arena_
+        uint32_t count = 0;
+        bool used = false;
+    };
+    
+    // Open addressing at most half full, so probe runs stay short
+    static constexpr size_t SLOTS = MAX_LINES * 2;
+    
+    std::vector<Entry> slots_;
+    std::vector<Token> arena_;
+    std::vector<Token> overflow_;  // A line too big for the arena, uncached
+    size_t size_ = 0;
+    
+    size_t slotFor(HighlightState state, uint64_t hash) const;
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_SYNTAX_TOKEN_CACHE_H
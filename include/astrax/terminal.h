@@ -52,23 +52,44 @@ public:
     /// Get terminal size
     virtual Size getSize() = 0;
     
+    /// Shift rows top..bottom (inclusive) up by lines, or down if negative
+    ///
+    /// Rows scrolled in are blank; rows outside the range do not move. The
+    /// cursor position is unspecified afterwards. Returns false if the
+    /// terminal cannot scroll a region, in which case nothing was sent.
+    virtual bool scrollRows(int top, int bottom, int lines) = 0;
+    
     // ========================================================================
     // Output
     // ========================================================================
     
     /// Write a string at current cursor position
+    ///
+    /// Output may be queued until flush(); the renderer flushes once per frame.
     virtual void write(const std::string& text) = 0;
     
     /// Write a character at current cursor position
     virtual void writeChar(char c) = 0;
     
-    /// Flush output buffer
+    /// Send all queued output to the terminal
     virtual void flush() = 0;
     
+    /// Start a frame the terminal should show all at once, not as it arrives
+    ///
+    /// Uses synchronized output (DEC mode 2026) where available; a no-op
+    /// otherwise. Every begin must be matched by endSynchronizedUpdate().
+    virtual void beginSynchronizedUpdate() = 0;
+    
+    /// Show everything sent since beginSynchronizedUpdate()
+    virtual void endSynchronizedUpdate() = 0;
+    
     // ========================================================================
     // Colors
     // ========================================================================
     
+    /// Switch to a pen, sending only what differs from the current one
+    virtual void setPen(const Pen& pen) = 0;
+    
     /// Set foreground and background color
     virtual void setColor(Color fg, Color bg = Color::Default) = 0;
     
@@ -91,6 +112,18 @@ public:
     /// Check if a key is available (non-blocking)
     virtual bool hasKey() = 0;
     
+    /// Check if a key has already been received, without asking the system
+    ///
+    /// Keys that arrive together (a paste, key repeat) are read in one go;
+    /// the editor handles all of them before drawing a frame.
+    virtual bool hasBufferedKey() = 0;
+    
+    /// Text of the last SpecialKey::Paste event, line breaks as received
+    virtual std::string takePaste() = 0;
+    
+    /// Wait up to timeoutMs for a key; returns hasKey()
+    virtual bool waitForKey(int timeoutMs) = 0;
+    
     // ========================================================================
     // Window Management
     // ========================================================================
@@ -0,0 +1,70 @@
+#ifndef ASTRAX_THREAD_POOL_H
+#define ASTRAX_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief Fixed set of worker threads that run a batch of tasks together
+ *
+ * run() hands tasks 0..count-1 to the workers and the calling thread,
+ * which take indices from a shared counter until none are left, and
+ * returns once all have finished. Workers start on the first run and
+ * sleep between batches.
+ *
+ * One batch runs at a time. A run() made while another is in progress,
+ * from another thread or from inside a task, runs its tasks on its own
+ * thread instead of waiting.
+ */
+class ThreadPool {
+public:
+    /// Pool of threads workers, plus the caller; 0 for one less than the
+    /// number of hardware threads
+    explicit ThreadPool(size_t threads = 0);
+    
+    /// Waits for the workers to exit
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    /// Threads a batch runs on, the caller included
+    size_t concurrency() const { return threadCount_ + 1; }
+    
+    /// Run task(i) for every i below count and wait for all of them
+    void run(size_t count, const std::function<void(size_t)>& task);
+    
+    /// Pool shared by the whole program
+    static ThreadPool& shared();
+    
+private:
+    size_t threadCount_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> running_{false};   // A batch is in progress
+    
+    // Current batch
+    std::mutex mutex_;
+    std::condition_variable wake_;       // Signals a new batch or shutdown
+    std::condition_variable finished_;   // Signals a worker leaving a batch
+    const std::function<void(size_t)>* task_ = nullptr;
+    size_t count_ = 0;
+    std::atomic<size_t> next_{0};
+    uint64_t batch_ = 0;
+    size_t busy_ = 0;                    // Workers still in the batch
+    bool stop_ = false;
+    
+    void work();
+    void drain(const std::function<void(size_t)>& task, size_t count);
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_THREAD_POOL_H
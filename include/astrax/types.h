@@ -2,13 +2,97 @@
 #define ASTRAX_TYPES_H
 
 #include <cstdint>
+#include <cstring>
+#include <ostream>
 #include <string>
 #include <vector>
 #include <memory>
 #include <functional>
+#include <algorithm>
 
 namespace astrax {
 
+// ============================================================================
+// Text Views
+// ============================================================================
+
+/**
+ * @brief Non-owning view of a character range
+ * 
+ * Stand-in for std::string_view while the project targets C++14.
+ * A view never owns its bytes; see the producer for how long they stay valid.
+ */
+class StringView {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    
+    constexpr StringView() noexcept : data_(nullptr), size_(0) {}
+    constexpr StringView(const char* data, size_t size) noexcept : data_(data), size_(size) {}
+    StringView(const std::string& str) noexcept : data_(str.data()), size_(str.size()) {}
+    StringView(const char* str) : data_(str), size_(std::strlen(str)) {}
+    
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    size_t length() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    
+    char operator[](size_t index) const { return data_[index]; }
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    char back() const { return data_[size_ - 1]; }
+    
+    /// Sub-range, clamped to the view
+    StringView substr(size_t pos, size_t count = npos) const {
+        if (pos > size_) pos = size_;
+        return StringView(data_ + pos, std::min(count, size_ - pos));
+    }
+    
+    /// Find a character at or after pos
+    size_t find(char c, size_t pos = 0) const {
+        if (pos >= size_) return npos;
+        const void* hit = std::memchr(data_ + pos, c, size_ - pos);
+        return hit ? static_cast<size_t>(static_cast<const char*>(hit) - data_) : npos;
+    }
+    
+    /// Find a substring at or after pos
+    size_t find(StringView needle, size_t pos = 0) const {
+        if (needle.empty()) return pos <= size_ ? pos : npos;
+        while (needle.size_ <= size_ && pos <= size_ - needle.size_) {
+            size_t hit = find(needle[0], pos);
+            if (hit == npos || hit > size_ - needle.size_) return npos;
+            if (std::memcmp(data_ + hit, needle.data_, needle.size_) == 0) return hit;
+            pos = hit + 1;
+        }
+        return npos;
+    }
+    
+    int compare(StringView other) const {
+        size_t common = std::min(size_, other.size_);
+        int result = common ? std::memcmp(data_, other.data_, common) : 0;
+        if (result != 0) return result;
+        return size_ < other.size_ ? -1 : (size_ > other.size_ ? 1 : 0);
+    }
+    
+    /// Copy the viewed bytes into an owning string
+    std::string str() const { return std::string(data_, size_); }
+    
+private:
+    const char* data_;
+    size_t size_;
+};
+
+inline bool operator==(StringView a, StringView b) {
+    return a.size() == b.size() && a.compare(b) == 0;
+}
+
+inline bool operator!=(StringView a, StringView b) {
+    return !(a == b);
+}
+
+inline std::ostream& operator<<(std::ostream& os, StringView view) {
+    return os.write(view.data(), static_cast<std::streamsize>(view.size()));
+}
+
 // ============================================================================
 // Basic Types
 // ============================================================================
@@ -104,6 +188,28 @@ struct ColorPair {
     Color background = Color::Default;
 };
 
+/**
+ * @brief Colors and attributes text is drawn with
+ */
+struct Pen {
+    static constexpr uint8_t BOLD = 1;
+    static constexpr uint8_t UNDERLINE = 2;
+    
+    Color foreground = Color::Default;
+    Color background = Color::Default;
+    uint8_t attributes = 0;
+    
+    Pen() = default;
+    Pen(Color fg, Color bg = Color::Default, uint8_t attrs = 0)
+        : foreground(fg), background(bg), attributes(attrs) {}
+    
+    bool operator==(const Pen& other) const {
+        return foreground == other.foreground && background == other.background &&
+               attributes == other.attributes;
+    }
+    bool operator!=(const Pen& other) const { return !(*this == other); }
+};
+
 // ============================================================================
 // Syntax Highlighting
 // ============================================================================
@@ -151,7 +257,10 @@ enum class SpecialKey : int {
     
     // Function keys
     F1 = 1100,
-    F2, F3, F4, F5, F6, F7, F8, F9, F10, F11, F12
+    F2, F3, F4, F5, F6, F7, F8, F9, F10, F11, F12,
+    
+    // Bracketed paste; the text comes from ITerminal::takePaste()
+    Paste = 1200
 };
 
 struct KeyEvent {
@@ -192,6 +301,9 @@ struct EditorConfig {
     bool autoIndent = true;
     int tabSize = 4;
     bool expandTabs = true;
+    size_t undoMemoryLimit = 64 * 1024 * 1024;  // Bytes of undo history per buffer
+    size_t mmapThreshold = 16 * 1024 * 1024;    // Files this large are mapped, not read
+    int maxFps = 60;                            // Redraw limit while keys arrive; 0 for none
     std::string theme = "default";
     std::string colorScheme = "dark";
 };
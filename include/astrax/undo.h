@@ -0,0 +1,96 @@
+#ifndef ASTRAX_UNDO_H
+#define ASTRAX_UNDO_H
+
+#include "types.h"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace astrax {
+
+/**
+ * @brief A primitive edit: at offset, removed text was replaced by inserted text
+ *
+ * Applying an op forward erases removed.size() bytes and inserts inserted;
+ * its inverse erases inserted.size() bytes and inserts removed.
+ */
+struct EditOp {
+    size_t offset = 0;
+    std::string removed;
+    std::string inserted;
+};
+
+/**
+ * @brief Edits that are undone and redone as one step
+ */
+struct UndoEntry {
+    std::vector<EditOp> ops;
+    Position cursorBefore;
+    Position cursorAfter;
+    uint64_t versionBefore = 0;   // Buffer version the entry starts from
+    uint64_t versionAfter = 0;    // Buffer version once all ops are applied
+
+    /// Approximate heap footprint, used for the memory budget
+    size_t memoryUsage() const;
+
+    /// Append an op, folding it into the previous one when contiguous
+    void addOp(EditOp op);
+
+    /// Put the ops in their final form; call before the entry is applied
+    void close();
+
+private:
+    /// The last op's removed text is a backspace run kept back to front,
+    /// so each further backspace appends instead of shifting the run
+    bool lastRemovedReversed_ = false;
+
+    /// Turn a reversed backspace run back into text order
+    void restoreLastRemoved();
+};
+
+/**
+ * @brief Undo/redo stacks of inverse edit operations
+ *
+ * Memory scales with the amount of text edited, not with document size.
+ * The oldest entries are dropped once the byte budget is exceeded.
+ */
+class UndoHistory {
+public:
+    static constexpr size_t DEFAULT_MEMORY_LIMIT = 64 * 1024 * 1024;
+
+    /// Record a finished entry; clears the redo stack
+    void push(UndoEntry entry);
+
+    /// Move the newest entry to the redo stack and return it (nullptr if none)
+    const UndoEntry* undo();
+
+    /// Move the newest undone entry back and return it (nullptr if none)
+    const UndoEntry* redo();
+
+    bool canUndo() const { return !undoStack_.empty(); }
+    bool canRedo() const { return !redoStack_.empty(); }
+
+    /// Drop all history
+    void clear();
+
+    /// Set the memory budget in bytes (trims immediately)
+    void setMemoryLimit(size_t bytes);
+    size_t memoryLimit() const { return memoryLimit_; }
+
+    /// Bytes currently held by both stacks
+    size_t memoryUsage() const { return memoryUsage_; }
+
+private:
+    std::deque<UndoEntry> undoStack_;
+    std::deque<UndoEntry> redoStack_;
+    size_t memoryLimit_ = DEFAULT_MEMORY_LIMIT;
+    size_t memoryUsage_ = 0;
+
+    void clearRedo();
+    void trim();
+};
+
+} // namespace astrax
+
+#endif // ASTRAX_UNDO_H
@@ -1,7 +1,6 @@
 #include "astrax/buffer.h"
-#include <fstream>
-#include <sstream>
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 
 namespace astrax {
@@ -10,46 +9,64 @@ namespace astrax {
 // Constructors
 // ============================================================================
 
-Buffer::Buffer() {
-    lines_.push_back("");
+namespace {
+
+uint64_t nextBufferId() {
+    static std::atomic<uint64_t> lastId{0};
+    return ++lastId;
 }
 
-Buffer::Buffer(const std::string& content) {
-    std::istringstream stream(content);
-    std::string line;
-    while (std::getline(stream, line)) {
-        // Remove carriage return if present
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
-        }
-        lines_.push_back(line);
+} // anonymous namespace
+
+constexpr size_t Buffer::CHANGE_LOG_LIMIT;
+
+Buffer::Buffer() : id_(nextBufferId()) {}
+
+Buffer::Buffer(const std::string& content) : id_(nextBufferId()) {
+    setContent(content);
+}
+
+void Buffer::setContent(std::string content) {
+    // One vectorized pass finds every newline and the line ending in use
+    LineIndex index;
+    index.build(content.data(), content.size());
+    lineEnding_ = index.empty() ? NATIVE_LINE_ENDING : index.lineEnding();
+    
+    // Normalize CRLF line endings in place (no extra allocation)
+    if (index.stats().crlf > 0) {
+        index.stripCarriageReturns(content);
     }
-    if (lines_.empty()) {
-        lines_.push_back("");
+    
+    // A trailing newline terminates the last line rather than starting a new one
+    finalNewline_ = !content.empty() && content.back() == '\n';
+    if (finalNewline_) {
+        content.pop_back();
+        index.removeLast();
     }
+    
+    table_ = PieceTable(std::move(content), std::move(index));
+    mapped_.reset();
+    resetChanges();
 }
 
 // ============================================================================
 // Content Access
 // ============================================================================
 
-const std::string& Buffer::getLine(size_t index) const {
-    static const std::string empty;
-    if (index >= lines_.size()) {
-        return empty;
-    }
-    return lines_[index];
+std::string Buffer::getLine(size_t index) const {
+    return getLineView(index).str();
+}
+
+StringView Buffer::getLineView(size_t index) const {
+    return table_.lineView(index, lineScratch_);
 }
 
 std::string Buffer::getContent() const {
-    std::ostringstream oss;
-    for (size_t i = 0; i < lines_.size(); ++i) {
-        oss << lines_[i];
-        if (i < lines_.size() - 1) {
-            oss << '\n';
-        }
-    }
-    return oss.str();
+    return table_.text();
+}
+
+size_t Buffer::offsetOf(const Position& pos) const {
+    return table_.lineStart(pos.line) + std::min(pos.column, table_.lineLength(pos.line));
 }
 
 // ============================================================================
@@ -57,40 +74,39 @@ std::string Buffer::getContent() const {
 // ============================================================================
 
 void Buffer::setCursor(Position pos) {
-    cursor_.line = std::min(pos.line, lines_.size() > 0 ? lines_.size() - 1 : 0);
-    if (cursor_.line < lines_.size()) {
-        cursor_.column = std::min(pos.column, lines_[cursor_.line].size());
-    } else {
-        cursor_.column = 0;
-    }
+    cursor_.line = std::min(pos.line, table_.lineCount() - 1);
+    cursor_.column = std::min(pos.column, table_.lineLength(cursor_.line));
 }
 
 void Buffer::moveCursor(int dx, int dy) {
+    size_t lines = table_.lineCount();
+    
     // Vertical movement
     if (dy != 0) {
         if (dy < 0 && cursor_.line >= static_cast<size_t>(-dy)) {
             cursor_.line += static_cast<size_t>(dy);
         } else if (dy < 0) {
             cursor_.line = 0;
-        } else if (cursor_.line + static_cast<size_t>(dy) < lines_.size()) {
+        } else if (cursor_.line + static_cast<size_t>(dy) < lines) {
             cursor_.line += static_cast<size_t>(dy);
         } else {
-            cursor_.line = lines_.size() - 1;
+            cursor_.line = lines - 1;
         }
         // Clamp column after vertical move
-        cursor_.column = std::min(cursor_.column, lines_[cursor_.line].size());
+        cursor_.column = std::min(cursor_.column, table_.lineLength(cursor_.line));
     }
     
     // Horizontal movement
     if (dx != 0) {
+        size_t length = table_.lineLength(cursor_.line);
         if (dx < 0 && cursor_.column >= static_cast<size_t>(-dx)) {
             cursor_.column += static_cast<size_t>(dx);
         } else if (dx < 0) {
             cursor_.column = 0;
-        } else if (cursor_.column + static_cast<size_t>(dx) <= lines_[cursor_.line].size()) {
+        } else if (cursor_.column + static_cast<size_t>(dx) <= length) {
             cursor_.column += static_cast<size_t>(dx);
         } else {
-            cursor_.column = lines_[cursor_.line].size();
+            cursor_.column = length;
         }
     }
 }
@@ -100,7 +116,7 @@ void Buffer::moveToLineStart() {
 }
 
 void Buffer::moveToLineEnd() {
-    cursor_.column = lines_[cursor_.line].size();
+    cursor_.column = table_.lineLength(cursor_.line);
 }
 
 void Buffer::moveToBufferStart() {
@@ -109,17 +125,18 @@ void Buffer::moveToBufferStart() {
 }
 
 void Buffer::moveToBufferEnd() {
-    cursor_.line = lines_.size() - 1;
-    cursor_.column = lines_[cursor_.line].size();
+    cursor_.line = table_.lineCount() - 1;
+    cursor_.column = table_.lineLength(cursor_.line);
 }
 
 void Buffer::moveForwardWord() {
-    const std::string& line = lines_[cursor_.line];
+    StringView line = getLineView(cursor_.line);
     size_t pos = cursor_.column;
+    size_t lastLine = table_.lineCount() - 1;
     
     if (pos >= line.size()) {
         // Move to next line
-        if (cursor_.line < lines_.size() - 1) {
+        if (cursor_.line < lastLine) {
             cursor_.line++;
             cursor_.column = 0;
         }
@@ -136,7 +153,7 @@ void Buffer::moveForwardWord() {
         pos++;
     }
     
-    if (pos >= line.size() && cursor_.line < lines_.size() - 1) {
+    if (pos >= line.size() && cursor_.line < lastLine) {
         cursor_.line++;
         cursor_.column = 0;
     } else {
@@ -145,14 +162,14 @@ void Buffer::moveForwardWord() {
 }
 
 void Buffer::moveBackwardWord() {
-    const std::string& line = lines_[cursor_.line];
+    StringView line = getLineView(cursor_.line);
     int pos = static_cast<int>(cursor_.column) - 1;
     
     if (pos < 0) {
         // Move to previous line
         if (cursor_.line > 0) {
             cursor_.line--;
-            cursor_.column = lines_[cursor_.line].size();
+            cursor_.column = table_.lineLength(cursor_.line);
         }
         return;
     }
@@ -175,109 +192,145 @@ void Buffer::moveBackwardWord() {
 // ============================================================================
 
 void Buffer::insertChar(char c) {
-    pushUndoState();
-    clearRedoStack();
+    if (isLoading()) {
+        return;  // Read-only while a file loads
+    }
     
-    if (cursor_.line >= lines_.size()) {
-        lines_.push_back("");
+    if (c == '\n') {
+        insertNewline();
+        return;
     }
     
-    lines_[cursor_.line].insert(cursor_.column, 1, c);
+    beginEdit();
+    
+    applyInsert(offsetOf(cursor_), StringView(&c, 1));
     cursor_.column++;
-    modified_ = true;
+    endEdit();
 }
 
 void Buffer::insertString(const std::string& text) {
-    pushUndoState();
-    clearRedoStack();
+    if (isLoading()) {
+        return;
+    }
     
-    for (char c : text) {
-        if (c == '\n') {
-            insertNewline();
-        } else {
-            if (cursor_.line >= lines_.size()) {
-                lines_.push_back("");
-            }
-            lines_[cursor_.line].insert(cursor_.column, 1, c);
-            cursor_.column++;
-        }
+    if (text.empty()) {
+        return;
     }
-    modified_ = true;
+    
+    beginEdit();
+    
+    // One bulk insert, however many lines the text spans
+    applyInsert(offsetOf(cursor_), text);
+    
+    size_t lastNewline = text.rfind('\n');
+    if (lastNewline == std::string::npos) {
+        cursor_.column += text.size();
+    } else {
+        cursor_.line += static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+        cursor_.column = text.size() - lastNewline - 1;
+    }
+    endEdit();
 }
 
 void Buffer::insertNewline() {
-    pushUndoState();
-    clearRedoStack();
+    if (isLoading()) {
+        return;
+    }
     
-    std::string& currentLine = lines_[cursor_.line];
-    std::string remainder = currentLine.substr(cursor_.column);
-    currentLine = currentLine.substr(0, cursor_.column);
+    beginEdit();
     
-    lines_.insert(lines_.begin() + static_cast<long>(cursor_.line) + 1, remainder);
+    applyInsert(offsetOf(cursor_), "\n");
     cursor_.line++;
     cursor_.column = 0;
-    modified_ = true;
+    endEdit();
 }
 
 void Buffer::deleteCharBefore() {
+    if (isLoading()) {
+        return;
+    }
+    
     if (cursor_.column > 0) {
-        pushUndoState();
-        clearRedoStack();
+        beginEdit();
         
-        lines_[cursor_.line].erase(cursor_.column - 1, 1);
+        applyErase(offsetOf(cursor_) - 1, 1);
         cursor_.column--;
-        modified_ = true;
+        endEdit();
     } else if (cursor_.line > 0) {
-        pushUndoState();
-        clearRedoStack();
+        beginEdit();
         
-        cursor_.column = lines_[cursor_.line - 1].size();
-        lines_[cursor_.line - 1] += lines_[cursor_.line];
-        lines_.erase(lines_.begin() + static_cast<long>(cursor_.line));
+        // Remove the newline ending the previous line
+        size_t joinColumn = table_.lineLength(cursor_.line - 1);
+        applyErase(table_.lineStart(cursor_.line) - 1, 1);
         cursor_.line--;
-        modified_ = true;
+        cursor_.column = joinColumn;
+        endEdit();
     }
 }
 
 void Buffer::deleteCharAt() {
-    if (cursor_.column < lines_[cursor_.line].size()) {
-        pushUndoState();
-        clearRedoStack();
-        
-        lines_[cursor_.line].erase(cursor_.column, 1);
-        modified_ = true;
-    } else if (cursor_.line < lines_.size() - 1) {
-        pushUndoState();
-        clearRedoStack();
+    if (isLoading()) {
+        return;
+    }
+    
+    size_t length = table_.lineLength(cursor_.line);
+    
+    if (cursor_.column < length || cursor_.line < table_.lineCount() - 1) {
+        beginEdit();
         
-        lines_[cursor_.line] += lines_[cursor_.line + 1];
-        lines_.erase(lines_.begin() + static_cast<long>(cursor_.line) + 1);
-        modified_ = true;
+        // At end of line this removes the newline, joining the next line
+        applyErase(offsetOf(cursor_), 1);
+        endEdit();
     }
 }
 
 void Buffer::deleteLine() {
-    pushUndoState();
-    clearRedoStack();
+    if (isLoading()) {
+        return;
+    }
     
-    if (lines_.size() > 1) {
-        lines_.erase(lines_.begin() + static_cast<long>(cursor_.line));
-        if (cursor_.line >= lines_.size()) {
-            cursor_.line = lines_.size() - 1;
-        }
+    beginEdit();
+    
+    size_t lines = table_.lineCount();
+    size_t start = table_.lineStart(cursor_.line);
+    
+    if (lines == 1) {
+        applyErase(0, table_.size());
+    } else if (cursor_.line + 1 < lines) {
+        applyErase(start, table_.lineStart(cursor_.line + 1) - start);
     } else {
-        lines_[0].clear();
+        // Last line: take the newline before it instead
+        applyErase(start - 1, table_.size() - start + 1);
+        cursor_.line--;
     }
     cursor_.column = 0;
-    modified_ = true;
+    endEdit();
 }
 
 void Buffer::deleteToEndOfLine() {
-    pushUndoState();
-    clearRedoStack();
+    if (isLoading()) {
+        return;
+    }
+    
+    beginEdit();
+    
+    size_t length = table_.lineLength(cursor_.line);
+    if (cursor_.column < length) {
+        applyErase(offsetOf(cursor_), length - cursor_.column);
+    }
+    endEdit();
+}
+
+void Buffer::applyEdit(size_t offset, size_t removed, StringView text) {
+    if (isLoading()) {
+        return;
+    }
     
-    lines_[cursor_.line] = lines_[cursor_.line].substr(0, cursor_.column);
-    modified_ = true;
+    beginEdit();
+    applyErase(offset, removed);
+    applyInsert(offset, text);
+    setCursor(cursor_);
+    endEdit();
 }
 
 // ============================================================================
@@ -285,37 +338,49 @@ void Buffer::deleteToEndOfLine() {
 // ============================================================================
 
 void Buffer::insertLineBelow() {
-    pushUndoState();
-    clearRedoStack();
+    if (isLoading()) {
+        return;
+    }
+    
+    beginEdit();
     
-    lines_.insert(lines_.begin() + static_cast<long>(cursor_.line) + 1, "");
+    size_t lineEnd = table_.lineStart(cursor_.line) + table_.lineLength(cursor_.line);
+    applyInsert(lineEnd, "\n");
     cursor_.line++;
     cursor_.column = 0;
-    modified_ = true;
+    endEdit();
 }
 
 void Buffer::insertLineAbove() {
-    pushUndoState();
-    clearRedoStack();
+    if (isLoading()) {
+        return;
+    }
     
-    lines_.insert(lines_.begin() + static_cast<long>(cursor_.line), "");
+    beginEdit();
+    
+    applyInsert(table_.lineStart(cursor_.line), "\n");
     cursor_.column = 0;
-    modified_ = true;
+    endEdit();
 }
 
 void Buffer::joinLines() {
-    if (cursor_.line < lines_.size() - 1) {
-        pushUndoState();
-        clearRedoStack();
+    if (isLoading()) {
+        return;
+    }
+    
+    if (cursor_.line < table_.lineCount() - 1) {
+        beginEdit();
+        
+        size_t length = table_.lineLength(cursor_.line);
+        size_t lineEnd = table_.lineStart(cursor_.line) + length;
         
-        cursor_.column = lines_[cursor_.line].size();
-        if (!lines_[cursor_.line].empty() && !lines_[cursor_.line + 1].empty()) {
-            lines_[cursor_.line] += " ";
+        cursor_.column = length;
+        applyErase(lineEnd, 1);
+        if (length > 0 && table_.lineLength(cursor_.line) > length) {
+            applyInsert(lineEnd, " ");
             cursor_.column++;
         }
-        lines_[cursor_.line] += lines_[cursor_.line + 1];
-        lines_.erase(lines_.begin() + static_cast<long>(cursor_.line) + 1);
-        modified_ = true;
+        endEdit();
     }
 }
 
@@ -323,61 +388,146 @@ void Buffer::joinLines() {
 // Undo/Redo
 // ============================================================================
 
-void Buffer::pushUndoState() {
-    UndoState state;
-    state.lines = lines_;
-    state.cursor = cursor_;
+void Buffer::beginEdit() {
+    if (editDepth_++ == 0) {
+        pendingUndo_ = UndoEntry();
+        pendingUndo_.cursorBefore = cursor_;
+        pendingUndo_.versionBefore = version_;
+    }
+}
+
+void Buffer::endEdit() {
+    if (editDepth_ == 0 || --editDepth_ > 0) {
+        return;
+    }
+    pendingUndo_.close();
+    if (!pendingUndo_.ops.empty()) {
+        pendingUndo_.cursorAfter = cursor_;
+        pendingUndo_.versionAfter = version_;
+        history_.push(std::move(pendingUndo_));
+    }
+    pendingUndo_ = UndoEntry();
+}
+
+void Buffer::applyInsert(size_t offset, StringView text) {
+    if (text.empty()) {
+        return;
+    }
+    offset = std::min(offset, table_.size());
+    table_.insert(offset, text);
+    version_ = ++lastVersion_;
+    logChange(offset, StringView(), text);
+    if (editObserver_) {
+        editObserver_(offset, 0, text);
+    }
+    
+    EditOp op;
+    op.offset = offset;
+    op.inserted = text.str();
+    pendingUndo_.addOp(std::move(op));
+}
+
+void Buffer::applyErase(size_t offset, size_t length) {
+    if (offset >= table_.size() || length == 0) {
+        return;
+    }
     
-    undoStack_.push_back(std::move(state));
+    EditOp op;
+    op.offset = offset;
+    op.removed = table_.text(offset, length);
+    table_.erase(offset, op.removed.size());
+    version_ = ++lastVersion_;
+    logChange(offset, op.removed, StringView());
+    if (editObserver_) {
+        editObserver_(offset, op.removed.size(), StringView());
+    }
+    pendingUndo_.addOp(std::move(op));
+}
+
+void Buffer::logChange(size_t offset, StringView removed, StringView inserted) {
+    LineChange change;
+    change.line = table_.lineOfOffset(offset);
+    change.removedLines = countNewlines(removed.data(), removed.size());
+    change.insertedLines = countNewlines(inserted.data(), inserted.size());
     
-    // Limit undo stack size
-    while (undoStack_.size() > MAX_UNDO_SIZE) {
-        undoStack_.pop_front();
+    changes_.push_back(change);
+    if (changes_.size() > CHANGE_LOG_LIMIT) {
+        changes_.pop_front();
+    }
+    ++changeCount_;
+}
+
+void Buffer::resetChanges() {
+    // Counting the reset as a change invalidates every older position
+    changes_.clear();
+    ++changeCount_;
+}
+
+bool Buffer::changesSince(uint64_t since, std::vector<LineChange>& changes) const {
+    changes.clear();
+    uint64_t firstLogged = changeCount_ - changes_.size();
+    if (since < firstLogged || since > changeCount_) {
+        return false;
     }
+    
+    changes.assign(changes_.begin() + static_cast<std::ptrdiff_t>(since - firstLogged), changes_.end());
+    return true;
 }
 
-void Buffer::clearRedoStack() {
-    redoStack_.clear();
+void Buffer::closeEditGroups() {
+    if (editDepth_ > 0) {
+        editDepth_ = 1;
+        endEdit();
+    }
 }
 
 void Buffer::undo() {
-    if (undoStack_.empty()) {
+    if (isLoading()) {
         return;
     }
     
-    // Save current state to redo
-    UndoState redoState;
-    redoState.lines = lines_;
-    redoState.cursor = cursor_;
-    redoStack_.push_back(std::move(redoState));
+    closeEditGroups();
     
-    // Restore from undo
-    UndoState& state = undoStack_.back();
-    lines_ = std::move(state.lines);
-    cursor_ = state.cursor;
-    undoStack_.pop_back();
+    const UndoEntry* entry = history_.undo();
+    if (!entry) {
+        return;
+    }
     
-    modified_ = (undoStack_.size() != savedUndoIndex_);
+    // Apply inverse ops newest first
+    for (auto it = entry->ops.rbegin(); it != entry->ops.rend(); ++it) {
+        table_.erase(it->offset, it->inserted.size());
+        table_.insert(it->offset, it->removed);
+        logChange(it->offset, it->inserted, it->removed);
+        if (editObserver_) {
+            editObserver_(it->offset, it->inserted.size(), it->removed);
+        }
+    }
+    cursor_ = entry->cursorBefore;
+    version_ = entry->versionBefore;
 }
 
 void Buffer::redo() {
-    if (redoStack_.empty()) {
+    if (isLoading()) {
         return;
     }
     
-    // Save current state to undo
-    UndoState undoState;
-    undoState.lines = lines_;
-    undoState.cursor = cursor_;
-    undoStack_.push_back(std::move(undoState));
+    closeEditGroups();
     
-    // Restore from redo
-    UndoState& state = redoStack_.back();
-    lines_ = std::move(state.lines);
-    cursor_ = state.cursor;
-    redoStack_.pop_back();
+    const UndoEntry* entry = history_.redo();
+    if (!entry) {
+        return;
+    }
     
-    modified_ = (undoStack_.size() != savedUndoIndex_);
+    for (const auto& op : entry->ops) {
+        table_.erase(op.offset, op.removed.size());
+        table_.insert(op.offset, op.inserted);
+        logChange(op.offset, op.removed, op.inserted);
+        if (editObserver_) {
+            editObserver_(op.offset, op.removed.size(), op.inserted);
+        }
+    }
+    cursor_ = entry->cursorAfter;
+    version_ = entry->versionAfter;
 }
 
 // ============================================================================
@@ -385,49 +535,59 @@ void Buffer::redo() {
 // ============================================================================
 
 void Buffer::yankLine() {
-    yankBuffer_ = lines_[cursor_.line];
+    yankBuffer_ = getLine(cursor_.line);
     yankIsLine_ = true;
 }
 
-void Buffer::yankSelection(const Range& range) {
+void Buffer::yankSelection(const Range& /*range*/) {
     // TODO: Implement selection yanking
     yankIsLine_ = false;
 }
 
 void Buffer::paste() {
+    if (isLoading()) {
+        return;
+    }
+    
     if (yankBuffer_.empty()) {
         return;
     }
     
-    pushUndoState();
-    clearRedoStack();
+    beginEdit();
     
     if (yankIsLine_) {
-        lines_.insert(lines_.begin() + static_cast<long>(cursor_.line) + 1, yankBuffer_);
+        if (cursor_.line + 1 < table_.lineCount()) {
+            applyInsert(table_.lineStart(cursor_.line + 1), yankBuffer_ + "\n");
+        } else {
+            applyInsert(table_.size(), "\n" + yankBuffer_);
+        }
         cursor_.line++;
         cursor_.column = 0;
     } else {
-        lines_[cursor_.line].insert(cursor_.column, yankBuffer_);
+        applyInsert(offsetOf(cursor_), yankBuffer_);
         cursor_.column += yankBuffer_.size();
     }
-    modified_ = true;
+    endEdit();
 }
 
 void Buffer::pasteBefore() {
+    if (isLoading()) {
+        return;
+    }
+    
     if (yankBuffer_.empty()) {
         return;
     }
     
-    pushUndoState();
-    clearRedoStack();
+    beginEdit();
     
     if (yankIsLine_) {
-        lines_.insert(lines_.begin() + static_cast<long>(cursor_.line), yankBuffer_);
+        applyInsert(table_.lineStart(cursor_.line), yankBuffer_ + "\n");
         cursor_.column = 0;
     } else {
-        lines_[cursor_.line].insert(cursor_.column, yankBuffer_);
+        applyInsert(offsetOf(cursor_), yankBuffer_);
     }
-    modified_ = true;
+    endEdit();
 }
 
 // ============================================================================
@@ -435,51 +595,144 @@ void Buffer::pasteBefore() {
 // ============================================================================
 
 bool Buffer::loadFromFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
+    return loadFromFileAsync(filename) && waitForLoad();
+}
+
+bool Buffer::loadFromFileAsync(const std::string& filename) {
+    // Saves still writing the old content must not race the new load
+    waitForSaves();
+    
+    auto loader = std::make_unique<FileLoader>(mapThreshold_);
+    if (!loader->start(filename)) {
+        return false;
+    }
+    loader_ = std::move(loader);  // Cancels a load still in progress
+    
+    table_ = PieceTable();
+    mapped_.reset();
+    resetChanges();
+    finalNewline_ = false;
+    lineEnding_ = NATIVE_LINE_ENDING;
+    loadFailed_ = false;
+    
+    filename_ = filename;
+    cursor_ = {0, 0};
+    editDepth_ = 0;
+    pendingUndo_ = UndoEntry();
+    history_.clear();
+    version_ = ++lastVersion_;
+    loadVersion_ = version_;
+    markSaved();
+    
+    return true;
+}
+
+bool Buffer::pollLoad() {
+    if (!loader_) {
         return false;
     }
     
-    lines_.clear();
-    std::string line;
-    while (std::getline(file, line)) {
-        // Remove carriage return if present
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
+    // Read done first: the final snapshot is published with it
+    bool done = loader_->isDone();
+    bool changed = loader_->poll(table_);
+    
+    if (done) {
+        if (loader_->succeeded()) {
+            finalNewline_ = loader_->finalNewline();
+            lineEnding_ = loader_->hasNewlines() ? loader_->lineEnding() : NATIVE_LINE_ENDING;
+            mapped_ = loader_->mapping();
+        } else {
+            table_ = PieceTable();
+            loadFailed_ = true;
         }
-        lines_.push_back(line);
+        loader_.reset();
+        changed = true;
+    }
+    
+    if (changed) {
+        version_ = ++lastVersion_;
+        markSaved();
+        resetChanges();
+        setCursor(cursor_);
+    }
+    return changed;
+}
+
+bool Buffer::waitForLoad() {
+    if (loader_) {
+        loader_->wait();
+        pollLoad();
+    }
+    return !loadFailed_;
+}
+
+size_t Buffer::loadedBytes() const {
+    return loader_ ? loader_->loadedBytes() : 0;
+}
+
+size_t Buffer::loadTotalBytes() const {
+    return loader_ ? loader_->totalBytes() : 0;
+}
+
+bool Buffer::saveToFile(const std::string& filename) {
+    if (!saveToFileAsync(filename)) {
+        return false;
     }
+    waitForSaves();
     
-    if (lines_.empty()) {
-        lines_.push_back("");
+    SaveResult result;
+    bool ok = false;
+    while (pollSave(result)) {
+        ok = result.ok;
+    }
+    return ok;
+}
+
+bool Buffer::saveToFileAsync(const std::string& filename) {
+    if (isLoading()) {
+        return false;
     }
     
-    filename_ = filename;
-    cursor_ = {0, 0};
-    modified_ = false;
-    undoStack_.clear();
-    redoStack_.clear();
-    savedUndoIndex_ = 0;
+#ifdef ASTRAX_PLATFORM_WINDOWS
+    // A mapped file cannot be replaced on Windows; take a private copy
+    if (mapped_ && mapped_->isSameFile(filename)) {
+        table_ = PieceTable(table_.text());
+        mapped_.reset();
+    }
+#endif
+    
+    // The file is replaced by rename, so pages still mapped stay readable
+    WriteOptions options;
+    options.lineEnding = lineEnding_;
+    options.finalNewline = finalNewline_;
     
+    if (!saver_) {
+        saver_ = std::make_unique<FileSaver>();
+    }
+    // Copying the table is O(1); the writer reads the snapshot, not table_
+    saver_->save(filename, table_, options, mapped_, version_);
     return true;
 }
 
-bool Buffer::saveToFile(const std::string& filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) {
+bool Buffer::pollSave(SaveResult& result) {
+    if (!saver_ || !saver_->poll(result)) {
         return false;
     }
     
-    for (size_t i = 0; i < lines_.size(); ++i) {
-        file << lines_[i];
-        if (i < lines_.size() - 1) {
-            file << '\n';
+    if (result.ok) {
+        lastWriteStats_ = result.stats;
+        if (result.version >= loadVersion_) {
+            filename_ = result.path;
+            markSaved(result.version);
         }
     }
-    
-    filename_ = filename;
-    markSaved();
     return true;
 }
 
+void Buffer::waitForSaves() {
+    if (saver_) {
+        saver_->wait();
+    }
+}
+
 } // namespace astrax
@@ -60,6 +60,7 @@ void CommandExecutor::registerBuiltinCommands() {
     
     // Quit command
     registerCommand("q", [](Editor& editor, const std::vector<std::string>& /*args*/) {
+        editor.finishSaves();
         if (editor.getBuffer().isModified()) {
             editor.setStatusMessage("No write since last change (add ! to override)");
             return false;
@@ -76,7 +77,8 @@ void CommandExecutor::registerBuiltinCommands() {
     
     // Write and quit
     registerCommand("wq", [](Editor& editor, const std::vector<std::string>& args) {
-        bool saved = args.size() > 1 ? editor.saveFileAs(args[1]) : editor.saveFile();
+        bool saved = (args.size() > 1 ? editor.saveFileAs(args[1]) : editor.saveFile()) &&
+                     editor.finishSaves();
         if (saved) {
             editor.quit();
         }
@@ -86,7 +88,7 @@ void CommandExecutor::registerBuiltinCommands() {
     // Exit (same as wq)
     registerCommand("x", [](Editor& editor, const std::vector<std::string>& /*args*/) {
         if (editor.getBuffer().isModified()) {
-            if (!editor.saveFile()) {
+            if (!editor.saveFile() || !editor.finishSaves()) {
                 return false;
             }
         }
@@ -103,6 +105,22 @@ void CommandExecutor::registerBuiltinCommands() {
         return editor.openFile(args[1]);
     });
     
+    // Replay or discard a journal found when the file was opened
+    registerCommand("recover", [](Editor& editor, const std::vector<std::string>& /*args*/) {
+        if (!editor.hasStaleJournal()) {
+            editor.setStatusMessage("No recovery journal for this file");
+            return false;
+        }
+        if (editor.getBuffer().isModified()) {
+            editor.setStatusMessage("No write since last change");
+            return false;
+        }
+        return editor.recoverFile(editor.getBuffer().getFilename());
+    });
+    registerCommand("deletejournal", [](Editor& editor, const std::vector<std::string>& /*args*/) {
+        return editor.deleteJournal();
+    });
+    
     // New file
     registerCommand("new", [](Editor& editor, const std::vector<std::string>& /*args*/) {
         editor.newBuffer();
@@ -146,6 +164,14 @@ void CommandExecutor::registerBuiltinCommands() {
         return false;
     });
     
+    // Clear search highlighting
+    auto noHighlight = [](Editor& editor, const std::vector<std::string>& /*args*/) {
+        editor.clearSearchHighlight();
+        return true;
+    };
+    registerCommand("noh", noHighlight);
+    registerCommand("nohlsearch", noHighlight);
+    
     // Run (compile and execute)
     registerCommand("run", [](Editor& editor, const std::vector<std::string>& /*args*/) {
         std::string filename = editor.getBuffer().getFilename();
@@ -172,7 +198,8 @@ void CommandExecutor::registerBuiltinCommands() {
         
         // Save file first
         if (editor.getBuffer().isModified()) {
-            if (!editor.saveFile()) {
+            // The compiler reads the file, so the write has to be complete
+            if (!editor.saveFile() || !editor.finishSaves()) {
                 editor.setStatusMessage("Error: Could not save file before compiling");
                 return false;
             }
@@ -215,7 +242,7 @@ void CommandExecutor::registerBuiltinCommands() {
             // Clear screen and re-enable raw mode BEFORE returning
             system("cls");
             editor.getTerminal().enableRawMode();
-            editor.getTerminal().clearScreen();
+            editor.invalidateScreen();
             
             editor.setStatusMessage("Compilation failed");
             return false;
@@ -239,7 +266,7 @@ void CommandExecutor::registerBuiltinCommands() {
         // Clear screen and re-enable raw mode
         system("cls");
         editor.getTerminal().enableRawMode();
-        editor.getTerminal().clearScreen();
+        editor.invalidateScreen();
         
         editor.setStatusMessage("Program finished (exit code " + std::to_string(runResult) + ")");
         return true;
@@ -247,7 +274,7 @@ void CommandExecutor::registerBuiltinCommands() {
     
     // Help
     registerCommand("help", [](Editor& editor, const std::vector<std::string>& /*args*/) {
-        editor.setStatusMessage("Commands: :w :q :wq :e <file> :new :saveas <file> :set <opt> :run");
+        editor.setStatusMessage("Commands: :w :q :wq :e <file> :new :recover :saveas <file> :set <opt> :noh :run");
         return true;
     });
 }
@@ -374,14 +401,15 @@ void KeyBindings::setupDefaultBindings() {
         e.setMode(EditorMode::Insert);
     });
     
+    // Enter Insert first so the new line joins the insert's undo group
     bind(EditorMode::Normal, {static_cast<int>('o')}, [](Editor& e) {
-        e.getBuffer().insertLineBelow();
         e.setMode(EditorMode::Insert);
+        e.getBuffer().insertLineBelow();
     });
     
     bind(EditorMode::Normal, {static_cast<int>('O')}, [](Editor& e) {
-        e.getBuffer().insertLineAbove();
         e.setMode(EditorMode::Insert);
+        e.getBuffer().insertLineAbove();
     });
     
     bind(EditorMode::Normal, {static_cast<int>('x')}, [](Editor& e) {
@@ -424,6 +452,14 @@ void KeyBindings::setupDefaultBindings() {
         e.setMode(EditorMode::Search);
     });
     
+    bind(EditorMode::Normal, {static_cast<int>('n')}, [](Editor& e) {
+        e.searchForward();
+    });
+    
+    bind(EditorMode::Normal, {static_cast<int>('N')}, [](Editor& e) {
+        e.searchBackward();
+    });
+    
     bind(EditorMode::Normal, {static_cast<int>('J')}, [](Editor& e) {
         e.getBuffer().joinLines();
     });
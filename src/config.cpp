@@ -31,6 +31,9 @@ void Config::loadDefaults() {
     editorConfig_.autoIndent = true;
     editorConfig_.tabSize = 4;
     editorConfig_.expandTabs = true;
+    editorConfig_.undoMemoryLimit = 64 * 1024 * 1024;
+    editorConfig_.mmapThreshold = 16 * 1024 * 1024;
+    editorConfig_.maxFps = 60;
     editorConfig_.theme = "default";
     editorConfig_.colorScheme = "dark";
     
@@ -177,6 +180,9 @@ bool Config::save(const std::string& path) const {
     file << "  \"autoIndent\": " << (editorConfig_.autoIndent ? "true" : "false") << ",\n";
     file << "  \"tabSize\": " << editorConfig_.tabSize << ",\n";
     file << "  \"expandTabs\": " << (editorConfig_.expandTabs ? "true" : "false") << ",\n";
+    file << "  \"undoMemoryLimit\": " << editorConfig_.undoMemoryLimit << ",\n";
+    file << "  \"mmapThreshold\": " << editorConfig_.mmapThreshold << ",\n";
+    file << "  \"maxFps\": " << editorConfig_.maxFps << ",\n";
     file << "  \"theme\": \"" << editorConfig_.theme << "\",\n";
     file << "  \"colorScheme\": \"" << editorConfig_.colorScheme << "\"\n";
     file << "}\n";
@@ -1,9 +1,39 @@
 #include "astrax/editor.h"
 #include "astrax/syntax/cpp_highlighter.h"
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <thread>
 
 namespace astrax {
 
+constexpr int Editor::BACKGROUND_POLL_MS;
+constexpr int Editor::INCREMENTAL_WAIT_MS;
+
+namespace {
+
+/// "12345B written, 512.3 MB/s"
+std::string describeWrite(const WriteStats& stats) {
+    std::ostringstream out;
+    out << stats.bytes << "B written";
+    if (stats.seconds > 0.0) {
+        out << ", " << std::fixed << std::setprecision(1)
+            << stats.bytesPerSecond() / (1024.0 * 1024.0) << " MB/s";
+    }
+    return out.str();
+}
+
+/// Patterns typed at the / prompt are regular expressions
+SearchOptions promptSearchOptions() {
+    SearchOptions options;
+    options.useRegex = true;
+    return options;
+}
+
+} // anonymous namespace
+
 // ============================================================================
 // Constructor/Destructor
 // ============================================================================
@@ -22,6 +52,10 @@ void Editor::initialize() {
     
     // Load configuration
     config_.loadDefaults();
+    renderer_->setTheme(config_.theme());
+    buffer_->setUndoMemoryLimit(config_.editor().undoMemoryLimit);
+    buffer_->setMapThreshold(config_.editor().mmapThreshold);
+    attachJournal();
     
     // Setup keybindings
     setupKeyBindings();
@@ -42,8 +76,10 @@ void Editor::setupKeyBindings() {
 // Main Loop
 // ============================================================================
 
-void Editor::run(const std::string& filename) {
-    if (!filename.empty()) {
+void Editor::run(const std::string& filename, bool recover) {
+    if (!filename.empty() && recover) {
+        recoverFile(filename);
+    } else if (!filename.empty()) {
         openFile(filename);
     }
     
@@ -52,16 +88,30 @@ void Editor::run(const std::string& filename) {
     RawModeGuard rawMode(*terminal_);
     
     while (!shouldQuit_) {
-        render();
+        pollJournal();
+        renderPaced();
+        
+        // While a file streams in or out, lines wait for highlighting or
+        // edits wait for the journal, wake up for progress as well as keys
+        if (hasBackgroundWork() && !waitForInput()) {
+            continue;
+        }
         processInput();
     }
     
+    // A clean exit leaves nothing to recover
+    journal_.close();
+    
     // Cleanup
     terminal_->clearScreen();
     terminal_->setCursor(0, 0);
+    terminal_->flush();
 }
 
 void Editor::quit(bool force) {
+    // Writes in flight always complete; wait so the modified flag is final
+    finishSaves();
+    
     if (!force && buffer_->isModified()) {
         setStatusMessage("No write since last change (use :q! to override)");
         return;
@@ -74,6 +124,18 @@ void Editor::quit(bool force) {
 // ============================================================================
 
 void Editor::setMode(EditorMode mode) {
+    if (mode == EditorMode::Insert && buffer_->isLoading()) {
+        setStatusMessage("File is still loading (read-only)");
+        return;
+    }
+    
+    // An insert session (typing, newlines, pastes) undoes as one step
+    if (mode_ == EditorMode::Insert && mode != EditorMode::Insert) {
+        buffer_->commitEditGroup();
+    } else if (mode_ != EditorMode::Insert && mode == EditorMode::Insert) {
+        buffer_->beginEditGroup();
+    }
+    
     mode_ = mode;
     
     switch (mode) {
@@ -91,6 +153,10 @@ void Editor::setMode(EditorMode mode) {
             break;
         case EditorMode::Search:
             commandBuffer_.clear();
+            searchOrigin_ = buffer_->getCursor();
+            highlightSearch_ = true;
+            searchWorker_.cancel();
+            searchProgress_ = SearchProgress();
             break;
     }
 }
@@ -101,14 +167,39 @@ void Editor::setMode(EditorMode mode) {
 
 void Editor::newBuffer() {
     buffer_ = std::make_unique<Buffer>();
+    buffer_->setUndoMemoryLimit(config_.editor().undoMemoryLimit);
+    buffer_->setMapThreshold(config_.editor().mmapThreshold);
+    journal_.close();
+    journalMarks_.clear();
+    recoveryNotice_.clear();
+    attachJournal();
     setMode(EditorMode::Normal);
     setStatusMessage("New buffer");
     terminal_->setTitle("AstraX - [No Name]");
 }
 
 bool Editor::openFile(const std::string& filename) {
-    if (buffer_->loadFromFile(filename)) {
-        setStatusMessage("\"" + filename + "\" loaded");
+    loadFile(filename);
+    
+    // A journal left by a session that did not exit stays untouched until
+    // it is recovered or deleted; journaling now would overwrite it
+    if (Journal::exists(filename)) {
+        offerRecovery(filename);
+    } else {
+        journal_.open(filename);
+    }
+    return true;
+}
+
+void Editor::loadFile(const std::string& filename) {
+    journal_.close();
+    journalMarks_.clear();
+    recoveryNotice_.clear();
+    
+    if (buffer_->loadFromFileAsync(filename)) {
+        // Small files are usually done before the first frame
+        buffer_->pollLoad();
+        updateLoadStatus();
         terminal_->setTitle("AstraX - " + filename);
         
         // Set up syntax highlighting based on file extension
@@ -116,14 +207,11 @@ bool Editor::openFile(const std::string& filename) {
         if (highlighter) {
             renderer_->setHighlighter(std::move(highlighter));
         }
-        
-        return true;
     } else {
         // New file
         buffer_->setFilename(filename);
         setStatusMessage("\"" + filename + "\" [New File]");
         terminal_->setTitle("AstraX - " + filename);
-        return true;
     }
 }
 
@@ -132,25 +220,196 @@ bool Editor::saveFile() {
         setStatusMessage("No filename specified (use :saveas <filename>)");
         return false;
     }
+    return saveFileAs(buffer_->getFilename());
+}
+
+bool Editor::saveFileAs(const std::string& filename) {
+    if (buffer_->isLoading()) {
+        setStatusMessage("File is still loading");
+        return false;
+    }
     
-    if (buffer_->saveToFile(buffer_->getFilename())) {
-        setStatusMessage("\"" + buffer_->getFilename() + "\" written");
-        return true;
-    } else {
+    // The buffer is snapshotted; typing continues while the file is written
+    if (!buffer_->saveToFileAsync(filename)) {
         setStatusMessage("Error: Could not write file");
         return false;
     }
+    journalMarks_.emplace_back(buffer_->version(), journal_.mark());
+    setStatusMessage("\"" + filename + "\" writing...");
+    terminal_->setTitle("AstraX - " + filename);
+    return true;
 }
 
-bool Editor::saveFileAs(const std::string& filename) {
-    if (buffer_->saveToFile(filename)) {
-        setStatusMessage("\"" + filename + "\" written");
-        terminal_->setTitle("AstraX - " + filename);
-        return true;
+bool Editor::finishSaves() {
+    buffer_->waitForSaves();
+    
+    bool ok = true;
+    SaveResult result;
+    while (buffer_->pollSave(result)) {
+        completeSave(result);
+        ok = ok && result.ok;
+    }
+    return ok;
+}
+
+void Editor::completeSave(const SaveResult& result) {
+    // Marks of saves that were superseded before they ran have no result
+    while (!journalMarks_.empty()) {
+        auto entry = journalMarks_.front();
+        journalMarks_.pop_front();
+        if (entry.first != result.version) {
+            journal_.release(entry.second);
+            continue;
+        }
+        
+        // The file now has every edit up to the mark; only later ones stay journaled
+        if (result.ok) {
+            journal_.rebase(entry.second, result.path);
+        } else {
+            journal_.release(entry.second);
+        }
+        break;
+    }
+    
+    if (result.ok) {
+        setStatusMessage("\"" + result.path + "\" " + describeWrite(result.stats));
     } else {
-        setStatusMessage("Error: Could not write file");
+        setStatusMessage("Error: Could not write \"" + result.path + "\"");
+    }
+}
+
+void Editor::attachJournal() {
+    buffer_->setEditObserver([this](size_t offset, size_t removed, StringView inserted) {
+        journal_.record(offset, removed, inserted);
+    });
+}
+
+bool Editor::recoverFile(const std::string& filename) {
+    // Read before opening: the first replayed edit starts the journal over
+    std::vector<JournalRecord> records;
+    std::string error;
+    bool readable = Journal::read(filename, records, error);
+    if (!readable) {
+        openFile(filename);
+        setStatusMessage("Error: Could not recover \"" + filename + "\": " + error);
+        return false;
+    }
+    
+    loadFile(filename);
+    journal_.open(filename);
+    buffer_->waitForLoad();
+    updateLoadStatus();
+    
+    // Recovered edits undo as one step and leave the buffer modified
+    buffer_->beginEditGroup();
+    for (const auto& record : records) {
+        buffer_->applyEdit(record.offset, record.removed, record.inserted);
+    }
+    buffer_->commitEditGroup();
+    
+    setStatusMessage("\"" + filename + "\" recovered " + std::to_string(records.size()) + " edits");
+    return true;
+}
+
+bool Editor::deleteJournal() {
+    const std::string& filename = buffer_->getFilename();
+    if (recoveryNotice_.empty()) {
+        setStatusMessage("No recovery journal for this file");
+        return false;
+    }
+    std::remove(Journal::pathFor(filename).c_str());
+    recoveryNotice_.clear();
+    journal_.open(filename);
+    setStatusMessage("Deleted recovery journal " + Journal::pathFor(filename));
+    return true;
+}
+
+void Editor::offerRecovery(const std::string& filename) {
+    // The same check main() makes before the first file is opened
+    std::vector<JournalRecord> records;
+    std::string error;
+    if (Journal::read(filename, records, error)) {
+        recoveryNotice_ = "journal has " + std::to_string(records.size()) +
+                          " unsaved edit(s): :recover, or :deletejournal";
+    } else {
+        recoveryNotice_ = "journal cannot be replayed (" + error + "): :deletejournal";
+    }
+    setStatusMessage(statusMessage_ + "; " + recoveryNotice_);
+}
+
+bool Editor::updateLoadStatus() {
+    const std::string& name = buffer_->getFilename();
+    std::string message;
+    
+    if (buffer_->isLoading()) {
+        size_t total = buffer_->loadTotalBytes();
+        size_t percent = total > 0 ? buffer_->loadedBytes() * 100 / total : 0;
+        message = "\"" + name + "\" loading... " + std::to_string(percent) + "%";
+    } else if (buffer_->loadFailed()) {
+        message = "Error: Could not read \"" + name + "\"";
+    } else {
+        message = "\"" + name + "\" " + std::to_string(buffer_->lineCount()) + "L loaded";
+    }
+    if (!recoveryNotice_.empty()) {
+        message += "; " + recoveryNotice_;
+    }
+    
+    if (message == statusMessage_) {
+        return false;
+    }
+    setStatusMessage(message);
+    return true;
+}
+
+bool Editor::waitForInput() {
+    while (!terminal_->hasKey()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(BACKGROUND_POLL_MS));
+        
+        bool changed = false;
+        if (buffer_->isLoading()) {
+            changed = buffer_->pollLoad();
+            changed = updateLoadStatus() || changed;
+        }
+        
+        SaveResult result;
+        while (buffer_->pollSave(result)) {
+            completeSave(result);
+            changed = true;
+        }
+        
+        if (renderer_->highlightsArrived()) {
+            changed = true;
+        }
+        
+        if (pollSearch()) {
+            changed = true;
+        }
+        
+        if (pollJournal()) {
+            changed = true;
+        }
+        
+        if (changed || !hasBackgroundWork()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Editor::hasBackgroundWork() const {
+    return buffer_->isLoading() || buffer_->isSaving() || renderer_->awaitingHighlights() ||
+           searchWorker_.busy() || journal_.isWriting();
+}
+
+bool Editor::pollJournal() {
+    bool failed = journal_.writeFailed();
+    if (failed == journalFailed_) {
         return false;
     }
+    journalFailed_ = failed;
+    setStatusMessage(failed ? "Error: journal write failed; unsaved edits would be lost in a crash"
+                            : "Journal writes resumed");
+    return true;
 }
 
 // ============================================================================
@@ -158,13 +417,93 @@ bool Editor::saveFileAs(const std::string& filename) {
 // ============================================================================
 
 void Editor::searchForward() {
-    // TODO: Implement search
-    setStatusMessage("Search forward: " + search_.getPattern());
+    jumpToMatch(search_.findNext(buffer_->getTable(), buffer_->getCursor()));
 }
 
 void Editor::searchBackward() {
-    // TODO: Implement search
-    setStatusMessage("Search backward: " + search_.getPattern());
+    jumpToMatch(search_.findPrevious(buffer_->getTable(), buffer_->getCursor()));
+}
+
+void Editor::jumpToMatch(const SearchMatch& match) {
+    if (search_.getPattern().empty()) {
+        setStatusMessage("No previous search pattern");
+    } else if (!search_.isPatternValid()) {
+        setStatusMessage("Invalid pattern: " + search_.getError());
+    } else if (!match) {
+        setStatusMessage("Pattern not found: " + search_.getPattern());
+    } else {
+        buffer_->setCursor(match.position);
+        highlightSearch_ = true;
+        setStatusMessage("/" + search_.getPattern());
+    }
+}
+
+void Editor::updateIncrementalSearch() {
+    search_.setPattern(commandBuffer_, promptSearchOptions());
+    if (commandBuffer_.empty() || !search_.isPatternValid()) {
+        searchWorker_.cancel();
+        searchProgress_ = SearchProgress();
+        buffer_->setCursor(searchOrigin_);
+        return;
+    }
+    searchWorker_.start(*buffer_, search_, searchOrigin_);
+    
+    // A match found within a moment is shown with this frame; with more
+    // keys pending this search is about to be replaced, so don't wait
+    if (!terminal_->hasBufferedKey()) {
+        searchWorker_.waitForMatch(std::chrono::milliseconds(INCREMENTAL_WAIT_MS));
+    }
+    pollSearch();
+}
+
+void Editor::cancelSearch() {
+    searchWorker_.cancel();
+    searchProgress_ = SearchProgress();
+    buffer_->setCursor(searchOrigin_);
+    
+    // n and N go on with the last pattern searched for
+    search_.setPattern(search_.getHistoryItem(0), promptSearchOptions());
+    setMode(EditorMode::Normal);
+    commandBuffer_.clear();
+}
+
+bool Editor::pollSearch() {
+    SearchProgress progress;
+    if (!searchWorker_.poll(progress)) {
+        return false;
+    }
+    
+    // While typing, the cursor follows the match of each new pattern
+    bool newMatch = progress.matchDone &&
+                    (progress.generation != searchProgress_.generation || !searchProgress_.matchDone);
+    if (mode_ == EditorMode::Search && newMatch) {
+        buffer_->setCursor(progress.match ? progress.match.position : searchOrigin_);
+    }
+    searchProgress_ = progress;
+    return true;
+}
+
+std::string Editor::describeSearch() const {
+    if (mode_ == EditorMode::Search && !commandBuffer_.empty() && !search_.isPatternValid()) {
+        return search_.getError();
+    }
+    
+    // Counts for an older version of the text are stale
+    const SearchProgress& progress = searchProgress_;
+    if (progress.generation == 0 || progress.bufferId != buffer_->id() ||
+        progress.changeCount != buffer_->changeCount()) {
+        return "";
+    }
+    if (!progress.matchDone) {
+        return "searching...";
+    }
+    if (!progress.match) {
+        return "no match";
+    }
+    if (!progress.countDone) {
+        return "counting...";
+    }
+    return std::to_string(progress.count) + (progress.count == 1 ? " match" : " matches");
 }
 
 // ============================================================================
@@ -190,15 +529,45 @@ bool Editor::executeCommand(const std::string& command) {
 void Editor::render() {
     renderer_->setStatusMessage(statusMessage_);
     renderer_->setCommandLine(commandBuffer_);
+    renderer_->setSearchInfo(describeSearch());
+    renderer_->setSearch(highlightSearch_ ? &search_ : nullptr);
     renderer_->render(*buffer_, mode_);
 }
 
+void Editor::renderPaced() {
+    // Drawing a frame that pending keys are about to change is wasted work;
+    // keep handling keys until input pauses or a frame interval has passed
+    int maxFps = config_.editor().maxFps;
+    if (maxFps > 0) {
+        auto now = std::chrono::steady_clock::now();
+        if (now < nextFrame_) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(nextFrame_ - now).count();
+            if (terminal_->waitForKey(static_cast<int>(remaining) + 1)) {
+                return;
+            }
+        }
+        nextFrame_ = std::chrono::steady_clock::now() + std::chrono::microseconds(1000000 / maxFps);
+    }
+    
+    render();
+}
+
 // ============================================================================
 // Input Processing
 // ============================================================================
 
 void Editor::processInput() {
-    KeyEvent key = terminal_->readKey();
+    // Handle every key already received before the next frame
+    do {
+        processKey(terminal_->readKey());
+    } while (!shouldQuit_ && terminal_->hasBufferedKey());
+}
+
+void Editor::processKey(const KeyEvent& key) {
+    if (key.toSpecial() == SpecialKey::Paste) {
+        processPaste(terminal_->takePaste());
+        return;
+    }
     
     switch (mode_) {
         case EditorMode::Normal:
@@ -219,6 +588,36 @@ void Editor::processInput() {
     }
 }
 
+void Editor::processPaste(std::string text) {
+    // Terminals send line breaks as \r; the buffer holds \n
+    size_t out = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '\r') {
+            text[out++] = text[i];
+        } else if (i + 1 == text.size() || text[i + 1] != '\n') {
+            text[out++] = '\n';
+        }
+    }
+    text.resize(out);
+    
+    switch (mode_) {
+        case EditorMode::Normal:
+        case EditorMode::Insert:
+            // Inserted verbatim: no auto-indent or tab expansion
+            buffer_->insertString(text);
+            break;
+        case EditorMode::Command:
+            commandBuffer_ += text.substr(0, text.find('\n'));
+            break;
+        case EditorMode::Search:
+            commandBuffer_ += text.substr(0, text.find('\n'));
+            updateIncrementalSearch();
+            break;
+        case EditorMode::Visual:
+            break;
+    }
+}
+
 void Editor::processNormalMode(const KeyEvent& key) {
     // Try keybindings first
     if (keyBindings_.process(*this, EditorMode::Normal, key)) {
@@ -330,30 +729,45 @@ void Editor::processVisualMode(const KeyEvent& key) {
 
 void Editor::processSearchMode(const KeyEvent& key) {
     if (key.isEscape()) {
-        setMode(EditorMode::Normal);
-        commandBuffer_.clear();
+        cancelSearch();
         return;
     }
     
     if (key.isEnter()) {
-        search_.setPattern(commandBuffer_);
-        searchForward();
+        // An empty pattern repeats the last search
+        if (commandBuffer_.empty()) {
+            cancelSearch();
+            searchForward();
+            return;
+        }
+        
+        // Take the worker's match if it has one; the count goes on running
+        // and shows in the status bar when done
+        pollSearch();
+        SearchMatch match = searchProgress_.matchDone
+            ? searchProgress_.match
+            : search_.findNext(buffer_->getTable(), searchOrigin_);
+        search_.addToHistory(commandBuffer_);
+        buffer_->setCursor(searchOrigin_);
         setMode(EditorMode::Normal);
         commandBuffer_.clear();
+        jumpToMatch(match);
         return;
     }
     
     if (key.isBackspace()) {
-        if (!commandBuffer_.empty()) {
-            commandBuffer_.pop_back();
-        } else {
-            setMode(EditorMode::Normal);
+        if (commandBuffer_.empty()) {
+            cancelSearch();
+            return;
         }
+        commandBuffer_.pop_back();
+        updateIncrementalSearch();
         return;
     }
     
     if (key.isPrintable()) {
         commandBuffer_ += key.toChar();
+        updateIncrementalSearch();
     }
 }
 
@@ -0,0 +1,167 @@
+#include "astrax/file_loader.h"
+#include <algorithm>
+
+namespace astrax {
+
+constexpr size_t FileLoader::SEGMENT_SIZE;
+
+// ============================================================================
+// Lifetime
+// ============================================================================
+
+FileLoader::FileLoader(size_t mapThreshold) : mapThreshold_(mapThreshold) {}
+
+FileLoader::~FileLoader() {
+    cancel_.store(true, std::memory_order_relaxed);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool FileLoader::start(const std::string& path) {
+    file_.open(path, std::ios::binary | std::ios::ate);
+    if (!file_.is_open()) {
+        return false;
+    }
+    
+    std::streamoff size = file_.tellg();
+    if (size < 0) {
+        return false;
+    }
+    totalBytes_ = static_cast<size_t>(size);
+    
+    if (totalBytes_ >= mapThreshold_) {
+        mapping_ = MappedFile::open(path);
+        if (mapping_) {
+            file_.close();
+        }
+    }
+    
+    thread_ = std::thread(&FileLoader::run, this);
+    return true;
+}
+
+// ============================================================================
+// Handoff
+// ============================================================================
+
+bool FileLoader::poll(PieceTable& table) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (publishedSerial_ == takenSerial_) {
+        return false;
+    }
+    table = published_;
+    takenSerial_ = publishedSerial_;
+    return true;
+}
+
+void FileLoader::wait() {
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void FileLoader::publish(size_t loaded, bool done) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    published_ = table_;
+    ++publishedSerial_;
+    loadedBytes_.store(loaded, std::memory_order_relaxed);
+    if (done) {
+        done_.store(true, std::memory_order_release);
+    }
+}
+
+// ============================================================================
+// Loader Thread
+// ============================================================================
+
+void FileLoader::run() {
+    bool ok = mapping_ ? loadMapped() : loadCopy();
+    
+    // A trailing newline terminates the last line rather than starting a new one
+    if (ok && table_.size() > 0 && table_.charAt(table_.size() - 1) == '\n') {
+        finalNewline_ = true;
+        table_.erase(table_.size() - 1, 1);
+    }
+    succeeded_ = ok;
+    
+    publish(loadedBytes(), true);
+}
+
+bool FileLoader::loadMapped() {
+    const char* data = mapping_->data();
+    size_t offset = 0;
+    
+    // Reference the file in place while it only uses LF
+    while (offset < totalBytes_ && !cancel_.load(std::memory_order_relaxed)) {
+        size_t end = std::min(offset + SEGMENT_SIZE, totalBytes_);
+        NewlineStats before = mapping_->stats();
+        mapping_->indexTo(end);
+        const NewlineStats& after = mapping_->stats();
+        if (after.crlf != before.crlf) {
+            // A '\r' already referenced may pair with this segment's '\n'
+            if (offset > 0 && data[offset - 1] == '\r' && data[offset] == '\n') {
+                table_.erase(table_.size() - 1, 1);
+            }
+            break;
+        }
+        
+        stats_.newlines += after.newlines - before.newlines;
+        table_.append(mapping_, offset, end - offset);
+        referencesMapping_ = true;
+        offset = end;
+        publish(offset);
+    }
+    
+    // From the first segment with CRLF on, copy and normalize
+    while (offset < totalBytes_ && !cancel_.load(std::memory_order_relaxed)) {
+        size_t end = std::min(offset + SEGMENT_SIZE, totalBytes_);
+        if (end < totalBytes_ && data[end - 1] == '\r') {
+            ++end;  // Keep "\r\n" in one segment
+        }
+        appendNormalized(std::string(data + offset, end - offset));
+        offset = end;
+        publish(offset);
+    }
+    
+    return offset == totalBytes_;
+}
+
+bool FileLoader::loadCopy() {
+    // Read the whole file with a single allocation
+    std::string content(totalBytes_, '\0');
+    file_.seekg(0);
+    
+    size_t offset = 0;
+    while (offset < totalBytes_ && !cancel_.load(std::memory_order_relaxed)) {
+        size_t length = std::min(SEGMENT_SIZE, totalBytes_ - offset);
+        file_.read(&content[offset], static_cast<std::streamsize>(length));
+        size_t got = static_cast<size_t>(file_.gcount());
+        offset += got;
+        loadedBytes_.store(offset, std::memory_order_relaxed);
+        if (got < length) {
+            break;  // Error, or the file shrank since it was opened
+        }
+    }
+    if (cancel_.load(std::memory_order_relaxed) || file_.bad()) {
+        return false;
+    }
+    
+    content.resize(offset);
+    appendNormalized(std::move(content));
+    return true;
+}
+
+void FileLoader::appendNormalized(std::string text) {
+    LineIndex index;
+    index.build(text.data(), text.size());
+    stats_.newlines += index.stats().newlines;
+    stats_.crlf += index.stats().crlf;
+    
+    if (index.stats().crlf > 0) {
+        index.stripCarriageReturns(text);
+    }
+    table_.append(std::move(text), std::move(index));
+}
+
+} // namespace astrax
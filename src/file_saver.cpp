@@ -0,0 +1,106 @@
+#include "astrax/file_saver.h"
+
+namespace astrax {
+
+// ============================================================================
+// Lifetime
+// ============================================================================
+
+FileSaver::~FileSaver() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+// ============================================================================
+// Jobs
+// ============================================================================
+
+void FileSaver::save(const std::string& path, PieceTable snapshot, const WriteOptions& options,
+                     std::shared_ptr<const MappedFile> source, uint64_t version) {
+    Job job;
+    job.path = path;
+    job.snapshot = std::move(snapshot);
+    job.options = options;
+    job.options.source = source.get();
+    job.source = std::move(source);
+    job.version = version;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // A newer snapshot for the same file makes a queued one pointless
+        bool replaced = false;
+        for (auto& queued : jobs_) {
+            if (queued.path == path) {
+                queued = std::move(job);
+                replaced = true;
+                break;
+            }
+        }
+        if (!replaced) {
+            jobs_.push_back(std::move(job));
+        }
+
+        if (!thread_.joinable()) {
+            thread_ = std::thread(&FileSaver::run, this);
+        }
+    }
+    wake_.notify_one();
+}
+
+bool FileSaver::poll(SaveResult& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (results_.empty()) {
+        return false;
+    }
+    result = std::move(results_.front());
+    results_.pop_front();
+    return true;
+}
+
+bool FileSaver::hasPending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return writing_ || !jobs_.empty() || !results_.empty();
+}
+
+void FileSaver::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this] { return !writing_ && jobs_.empty(); });
+}
+
+// ============================================================================
+// Writer Thread
+// ============================================================================
+
+void FileSaver::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+        if (jobs_.empty()) {
+            return;  // Stopping, and everything queued has been written
+        }
+
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        writing_ = true;
+        lock.unlock();
+
+        SaveResult result;
+        result.path = job.path;
+        result.version = job.version;
+        result.ok = writeFileAtomic(job.path, job.snapshot, job.options, result.stats);
+
+        lock.lock();
+        results_.push_back(std::move(result));
+        writing_ = false;
+        finished_.notify_all();
+    }
+}
+
+} // namespace astrax
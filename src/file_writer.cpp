@@ -0,0 +1,344 @@
+#include "astrax/file_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#ifdef ASTRAX_PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+namespace astrax {
+
+namespace {
+
+/// Directory part of a path ("." if there is none)
+std::string directoryOf(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    if (slash == std::string::npos) {
+        return ".";
+    }
+    return slash == 0 ? path.substr(0, 1) : path.substr(0, slash);
+}
+
+/// Name of a temporary sibling of path
+std::string tempNameFor(const std::string& path, unsigned attempt) {
+    std::string dir = directoryOf(path);
+    size_t slash = path.find_last_of("/\\");
+    std::string base = slash == std::string::npos ? path : path.substr(slash + 1);
+
+    auto ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+    return dir + "/." + base + ".axtmp" + std::to_string(static_cast<unsigned long long>(ticks) % 1000000u) +
+           "-" + std::to_string(attempt);
+}
+
+#ifndef ASTRAX_PLATFORM_WINDOWS
+
+// ============================================================================
+// POSIX Writer
+// ============================================================================
+
+/**
+ * @brief Gathers spans into iovec batches and writes them with writev
+ */
+class VectorWriter {
+public:
+    explicit VectorWriter(int fd) : fd_(fd) {
+        iov_.reserve(IOV_MAX);
+    }
+
+    /// Queue a span; its bytes must stay valid until the next flush
+    bool add(const char* data, size_t size) {
+        if (size == 0) return true;
+        iovec span;
+        span.iov_base = const_cast<char*>(data);
+        span.iov_len = size;
+        iov_.push_back(span);
+        bytes_ += size;
+        return iov_.size() < static_cast<size_t>(IOV_MAX) || flush();
+    }
+
+    /// Write everything queued
+    bool flush() {
+        size_t first = 0;
+        while (first < iov_.size()) {
+            int count = static_cast<int>(iov_.size() - first);
+            ssize_t written = writev(fd_, iov_.data() + first, count);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+
+            // Skip fully written spans, trim a partially written one
+            size_t remaining = static_cast<size_t>(written);
+            while (first < iov_.size() && remaining >= iov_[first].iov_len) {
+                remaining -= iov_[first].iov_len;
+                ++first;
+            }
+            if (remaining > 0) {
+                iov_[first].iov_base = static_cast<char*>(iov_[first].iov_base) + remaining;
+                iov_[first].iov_len -= remaining;
+            }
+        }
+        iov_.clear();
+        return true;
+    }
+
+    /// Write a span that is also [offset, offset + size) of file source
+    ///
+    /// Copies file-to-file in the kernel where supported (sharing extents
+    /// on filesystems that can), otherwise falls back to add().
+    bool copyRange(int source, size_t offset, const char* data, size_t size) {
+        size_t done = 0;
+#if defined(ASTRAX_PLATFORM_LINUX) && defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+        if (copySupported_) {
+            if (!flush()) {
+                return false;
+            }
+            loff_t in = static_cast<loff_t>(offset);
+            while (done < size) {
+                ssize_t copied = copy_file_range(source, &in, fd_, nullptr, size - done, 0);
+                if (copied < 0 && errno == EINTR) continue;
+                if (copied <= 0) {
+                    copySupported_ = false;  // EXDEV, ENOSYS, EINVAL, ...
+                    break;
+                }
+                done += static_cast<size_t>(copied);
+            }
+            bytes_ += done;
+            copied_ += done;
+        }
+#else
+        (void)source;
+        (void)offset;
+#endif
+        return add(data + done, size - done);
+    }
+
+    size_t bytes() const { return bytes_; }
+    size_t copied() const { return copied_; }
+
+private:
+    int fd_;
+    std::vector<iovec> iov_;
+    size_t bytes_ = 0;
+    size_t copied_ = 0;
+    bool copySupported_ = true;
+};
+
+bool writeContent(int fd, const PieceTable& table, const WriteOptions& options, WriteStats& stats) {
+    VectorWriter writer(fd);
+    const bool crlf = options.lineEnding == LineEnding::CRLF;
+    static const char CRLF[] = "\r\n";
+    bool ok = true;
+
+    table.forEachChunk(0, table.size(), [&](const char* data, size_t size) {
+        if (!ok) return;
+
+        // Unmodified file ranges go file-to-file when no translation is needed
+        const MappedFile* source = options.source;
+        if (!crlf && source && data >= source->data() &&
+            data + size <= source->data() + source->size()) {
+            ok = writer.copyRange(source->descriptor(),
+                                  static_cast<size_t>(data - source->data()), data, size);
+            return;
+        }
+
+        if (!crlf) {
+            ok = writer.add(data, size);
+            return;
+        }
+
+        const char* end = data + size;
+        while (ok && data < end) {
+            const char* hit = static_cast<const char*>(
+                std::memchr(data, '\n', static_cast<size_t>(end - data)));
+            const char* stop = hit ? hit : end;
+            ok = writer.add(data, static_cast<size_t>(stop - data));
+            if (!hit) break;
+            ok = ok && writer.add(CRLF, 2);
+            data = hit + 1;
+        }
+    });
+
+    if (ok && options.finalNewline) {
+        ok = crlf ? writer.add(CRLF, 2) : writer.add(CRLF + 1, 1);
+    }
+    ok = ok && writer.flush();
+
+    stats.bytes = writer.bytes();
+    stats.bytesCopied = writer.copied();
+    return ok;
+}
+
+#endif // !ASTRAX_PLATFORM_WINDOWS
+
+} // anonymous namespace
+
+// ============================================================================
+// Atomic Write
+// ============================================================================
+
+#ifdef ASTRAX_PLATFORM_WINDOWS
+
+bool writeFileAtomic(const std::string& path, const PieceTable& table,
+                     const WriteOptions& options, WriteStats& stats) {
+    auto started = std::chrono::steady_clock::now();
+    stats = WriteStats();
+
+    std::string temp;
+    HANDLE file = INVALID_HANDLE_VALUE;
+    for (unsigned attempt = 0; attempt < 16 && file == INVALID_HANDLE_VALUE; ++attempt) {
+        temp = tempNameFor(path, attempt);
+        file = CreateFileA(temp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    }
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    // WriteFile has no gather form; small pieces are batched in one buffer
+    const size_t BATCH_SIZE = 1 << 20;
+    std::string batch;
+    batch.reserve(BATCH_SIZE);
+    bool ok = true;
+
+    auto writeRaw = [&](const char* data, size_t size) {
+        while (ok && size > 0) {
+            DWORD part = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+            DWORD written = 0;
+            ok = WriteFile(file, data, part, &written, nullptr) && written == part;
+            data += part;
+            size -= part;
+        }
+    };
+    auto flushBatch = [&]() {
+        writeRaw(batch.data(), batch.size());
+        batch.clear();
+    };
+    auto put = [&](const char* data, size_t size) {
+        stats.bytes += size;
+        if (batch.size() + size > BATCH_SIZE) {
+            flushBatch();
+        }
+        if (size >= BATCH_SIZE) {
+            writeRaw(data, size);
+        } else {
+            batch.append(data, size);
+        }
+    };
+
+    const bool crlf = options.lineEnding == LineEnding::CRLF;
+    table.forEachChunk(0, table.size(), [&](const char* data, size_t size) {
+        const char* end = data + size;
+        while (crlf && data < end) {
+            const char* hit = static_cast<const char*>(
+                std::memchr(data, '\n', static_cast<size_t>(end - data)));
+            if (!hit) break;
+            put(data, static_cast<size_t>(hit - data));
+            put("\r\n", 2);
+            data = hit + 1;
+        }
+        put(data, static_cast<size_t>(end - data));
+    });
+    if (options.finalNewline) {
+        put(crlf ? "\r\n" : "\n", crlf ? 2 : 1);
+    }
+    flushBatch();
+
+    ok = ok && FlushFileBuffers(file);
+    CloseHandle(file);
+
+    // Keep attributes of the file being replaced
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    if (ok && attributes != INVALID_FILE_ATTRIBUTES) {
+        SetFileAttributesA(temp.c_str(), attributes & ~FILE_ATTRIBUTE_READONLY);
+    }
+
+    ok = ok && MoveFileExA(temp.c_str(), path.c_str(),
+                           MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    if (!ok) {
+        DeleteFileA(temp.c_str());
+        return false;
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return true;
+}
+
+#else
+
+bool writeFileAtomic(const std::string& path, const PieceTable& table,
+                     const WriteOptions& options, WriteStats& stats) {
+    auto started = std::chrono::steady_clock::now();
+    stats = WriteStats();
+
+    // Write through symlinks rather than replacing them
+    std::string target = path;
+    struct stat st;
+    bool exists = lstat(path.c_str(), &st) == 0;
+    if (exists && S_ISLNK(st.st_mode)) {
+        char* resolved = realpath(path.c_str(), nullptr);
+        if (resolved) {
+            target = resolved;
+            std::free(resolved);
+        }
+    }
+    exists = stat(target.c_str(), &st) == 0;
+
+    // O_EXCL with 0666 lets the umask decide the mode of a new file
+    std::string temp;
+    int fd = -1;
+    for (unsigned attempt = 0; attempt < 16 && fd < 0; ++attempt) {
+        temp = tempNameFor(target, attempt);
+        fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (fd < 0 && errno != EEXIST) {
+            return false;
+        }
+    }
+    if (fd < 0) {
+        return false;
+    }
+
+    bool ok = writeContent(fd, table, options, stats);
+    if (ok && exists) {
+        fchmod(fd, st.st_mode & 07777);
+        if (fchown(fd, st.st_uid, st.st_gid) != 0) {
+            // Not permitted for other owners; the file becomes ours
+        }
+    }
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && std::rename(temp.c_str(), target.c_str()) == 0;
+    if (!ok) {
+        unlink(temp.c_str());
+        return false;
+    }
+
+    // Make the rename itself durable
+    int dir = ::open(directoryOf(target).c_str(), O_RDONLY | O_CLOEXEC);
+    if (dir >= 0) {
+        fsync(dir);
+        close(dir);
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return true;
+}
+
+#endif
+
+} // namespace astrax
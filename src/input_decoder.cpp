@@ -0,0 +1,241 @@
+#include "astrax/input_decoder.h"
+#include <algorithm>
+#include <cstring>
+
+namespace astrax {
+
+constexpr size_t InputDecoder::CAPACITY;
+constexpr size_t InputDecoder::MAX_SEQUENCE;
+
+namespace {
+
+// Bracketed paste markers (CSI 200 ~ and CSI 201 ~)
+constexpr int PASTE_START = 200;
+const char PASTE_END[] = "\x1b[201~";
+constexpr size_t PASTE_END_LENGTH = sizeof(PASTE_END) - 1;
+
+} // anonymous namespace
+
+InputDecoder::InputDecoder() : data_(CAPACITY) {}
+
+// ============================================================================
+// Buffering
+// ============================================================================
+
+char* InputDecoder::writeSpace(size_t& size) {
+    if (size_ == 0) {
+        head_ = 0;  // Give the next read the whole ring
+    }
+    
+    size_t tail = (head_ + size_) % CAPACITY;
+    if (size_ == CAPACITY) {
+        size = 0;
+    } else if (tail >= head_) {
+        size = CAPACITY - tail;
+    } else {
+        size = head_ - tail;
+    }
+    return &data_[tail];
+}
+
+void InputDecoder::commit(size_t count) {
+    size_ += count;
+}
+
+size_t InputDecoder::feed(const char* data, size_t size) {
+    size_t stored = 0;
+    while (stored < size) {
+        size_t space = 0;
+        char* dest = writeSpace(space);
+        if (space == 0) {
+            break;
+        }
+        size_t count = std::min(space, size - stored);
+        std::memcpy(dest, data + stored, count);
+        commit(count);
+        stored += count;
+    }
+    return stored;
+}
+
+void InputDecoder::consume(size_t count) {
+    head_ = (head_ + count) % CAPACITY;
+    size_ -= count;
+}
+
+// ============================================================================
+// Decoding
+// ============================================================================
+
+bool InputDecoder::next(KeyEvent& event, bool final) {
+    event = KeyEvent();
+    if (pasting_) {
+        return nextPaste(event, final);
+    }
+    if (size_ == 0) {
+        return false;
+    }
+    
+    char c = at(0);
+    if (c == '\x1b') {
+        size_t length = decodeEscape(event);
+        if (length == 0) {
+            if (!final) {
+                return false;  // Rest of the sequence may still be on its way
+            }
+            event = KeyEvent();
+            event.key = static_cast<int>(SpecialKey::Escape);
+            length = 1;
+        }
+        consume(length);
+        
+        if (event.toSpecial() == SpecialKey::Paste) {
+            pasting_ = true;
+            paste_.clear();
+            return nextPaste(event, final);
+        }
+        return true;
+    }
+    
+    if (c >= 1 && c <= 26 && c != '\t' && c != '\r' && c != '\n') {
+        // Ctrl+key
+        event.key = c + 'a' - 1;
+        event.ctrl = true;
+    } else if (c == 127) {
+        event.key = static_cast<int>(SpecialKey::Backspace);
+    } else if (c == '\r' || c == '\n') {
+        event.key = static_cast<int>(SpecialKey::Enter);
+    } else if (c == '\t') {
+        event.key = static_cast<int>(SpecialKey::Tab);
+    } else {
+        event.key = c;
+    }
+    consume(1);
+    return true;
+}
+
+size_t InputDecoder::decodeEscape(KeyEvent& event) const {
+    if (size_ < 2) {
+        return 0;
+    }
+    
+    char kind = at(1);
+    if (kind == 'O') {
+        // SS3: one final byte
+        if (size_ < 3) {
+            return 0;
+        }
+        switch (at(2)) {
+            case 'H': event.key = static_cast<int>(SpecialKey::Home); break;
+            case 'F': event.key = static_cast<int>(SpecialKey::End); break;
+            case 'P': event.key = static_cast<int>(SpecialKey::F1); break;
+            case 'Q': event.key = static_cast<int>(SpecialKey::F2); break;
+            case 'R': event.key = static_cast<int>(SpecialKey::F3); break;
+            case 'S': event.key = static_cast<int>(SpecialKey::F4); break;
+        }
+        return 3;
+    }
+    
+    if (kind != '[') {
+        // Escape pressed on its own; whatever follows is the next key
+        event.key = static_cast<int>(SpecialKey::Escape);
+        return 1;
+    }
+    
+    // CSI: parameter and intermediate bytes up to a final byte in 0x40-0x7E;
+    // only the first parameter matters, modifiers are not decoded
+    int param = 0;
+    bool firstParam = true;
+    for (size_t i = 2; i < size_; ++i) {
+        unsigned char b = static_cast<unsigned char>(at(i));
+        if (b >= 0x40 && b <= 0x7E) {
+            if (b == '~') {
+                switch (param) {
+                    case 1: case 7: event.key = static_cast<int>(SpecialKey::Home); break;
+                    case 3: event.key = static_cast<int>(SpecialKey::Delete); break;
+                    case 4: case 8: event.key = static_cast<int>(SpecialKey::End); break;
+                    case 5: event.key = static_cast<int>(SpecialKey::PageUp); break;
+                    case 6: event.key = static_cast<int>(SpecialKey::PageDown); break;
+                    case PASTE_START: event.key = static_cast<int>(SpecialKey::Paste); break;
+                }
+            } else {
+                switch (b) {
+                    case 'A': event.key = static_cast<int>(SpecialKey::Up); break;
+                    case 'B': event.key = static_cast<int>(SpecialKey::Down); break;
+                    case 'C': event.key = static_cast<int>(SpecialKey::Right); break;
+                    case 'D': event.key = static_cast<int>(SpecialKey::Left); break;
+                    case 'H': event.key = static_cast<int>(SpecialKey::Home); break;
+                    case 'F': event.key = static_cast<int>(SpecialKey::End); break;
+                }
+            }
+            return i + 1;
+        }
+        
+        if (b < 0x20 || b > 0x7E) {
+            return i;  // Malformed; drop the sequence up to this byte
+        }
+        if (b == ';') {
+            firstParam = false;
+        } else if (firstParam && b >= '0' && b <= '9') {
+            param = std::min(param * 10 + (b - '0'), 9999);
+        }
+        
+        if (i + 1 >= MAX_SEQUENCE) {
+            return i + 1;  // Runaway sequence; drop it
+        }
+    }
+    return 0;
+}
+
+// ============================================================================
+// Bracketed Paste
+// ============================================================================
+
+bool InputDecoder::nextPaste(KeyEvent& event, bool final) {
+    while (size_ > 0) {
+        // Copy the contiguous run up to the next ESC
+        size_t run = std::min(size_, CAPACITY - head_);
+        const char* start = &data_[head_];
+        const char* escape = static_cast<const char*>(std::memchr(start, '\x1b', run));
+        size_t plain = escape ? static_cast<size_t>(escape - start) : run;
+        paste_.append(start, plain);
+        consume(plain);
+        if (!escape) {
+            continue;
+        }
+        
+        size_t match = 0;
+        while (match < PASTE_END_LENGTH && match < size_ && at(match) == PASTE_END[match]) {
+            ++match;
+        }
+        if (match == PASTE_END_LENGTH) {
+            consume(PASTE_END_LENGTH);
+            pasting_ = false;
+            event.key = static_cast<int>(SpecialKey::Paste);
+            return true;
+        }
+        if (match == size_ && !final) {
+            return false;  // The end marker may be split across reads
+        }
+        
+        // An ESC in the pasted text itself
+        paste_.push_back('\x1b');
+        consume(1);
+    }
+    
+    if (final) {
+        // Input ended inside the paste; keep what arrived
+        pasting_ = false;
+        event.key = static_cast<int>(SpecialKey::Paste);
+        return true;
+    }
+    return false;
+}
+
+std::string InputDecoder::takePaste() {
+    std::string text;
+    text.swap(paste_);
+    return text;
+}
+
+} // namespace astrax
@@ -0,0 +1,492 @@
+#include "astrax/journal.h"
+#include <chrono>
+#include <fstream>
+#include <sys/stat.h>
+
+#ifdef ASTRAX_PLATFORM_WINDOWS
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace astrax {
+
+constexpr int Journal::FLUSH_INTERVAL_MS;
+
+namespace {
+
+const char MAGIC[4] = {'A', 'X', 'J', '1'};
+const char RECORD_TAG = 'E';
+const size_t HEADER_SIZE = 4 + 8 + 8;
+const size_t RECORD_OVERHEAD = 1 + 8 + 8 + 4 + 4;
+
+// ============================================================================
+// Encoding (little-endian, independent of the host)
+// ============================================================================
+
+void putU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void putU64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+uint32_t getU32(const char* data) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; --i) {
+        value = (value << 8) | static_cast<unsigned char>(data[i]);
+    }
+    return value;
+}
+
+uint64_t getU64(const char* data) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | static_cast<unsigned char>(data[i]);
+    }
+    return value;
+}
+
+/// FNV-1a, enough to tell a torn record from a complete one
+uint32_t checksum(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/// Size and modification time of a file; zero for a file that does not exist
+void fileIdentity(const std::string& path, uint64_t& size, uint64_t& mtime) {
+    size = 0;
+    mtime = 0;
+#ifdef ASTRAX_PLATFORM_WINDOWS
+    struct _stat64 st;
+    if (_stat64(path.c_str(), &st) == 0) {
+        size = static_cast<uint64_t>(st.st_size);
+        mtime = static_cast<uint64_t>(st.st_mtime);
+    }
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+        size = static_cast<uint64_t>(st.st_size);
+#ifdef ASTRAX_PLATFORM_LINUX
+        mtime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000u +
+                static_cast<uint64_t>(st.st_mtim.tv_nsec);
+#else
+        mtime = static_cast<uint64_t>(st.st_mtime);
+#endif
+    }
+#endif
+}
+
+std::string encodeHeader(const std::string& filename) {
+    uint64_t size = 0;
+    uint64_t mtime = 0;
+    fileIdentity(filename, size, mtime);
+
+    std::string header(MAGIC, sizeof(MAGIC));
+    putU64(header, size);
+    putU64(header, mtime);
+    return header;
+}
+
+std::string encodeRecord(size_t offset, size_t removed, StringView inserted) {
+    std::string record;
+    record.reserve(RECORD_OVERHEAD + inserted.size());
+    record.push_back(RECORD_TAG);
+    putU64(record, offset);
+    putU64(record, removed);
+    putU32(record, static_cast<uint32_t>(inserted.size()));
+    record.append(inserted.data(), inserted.size());
+    putU32(record, checksum(record.data(), record.size()));
+    return record;
+}
+
+/// Permission bits for the journal of filename: the file's own, so the
+/// edits are no more readable than the text they apply to, or owner-only
+unsigned journalMode(const std::string& filename) {
+#ifdef ASTRAX_PLATFORM_WINDOWS
+    (void)filename;
+    return 0;
+#else
+    struct stat st;
+    if (stat(filename.c_str(), &st) == 0) {
+        return static_cast<unsigned>(st.st_mode) & 0777u;
+    }
+    return 0600u;
+#endif
+}
+
+/// Open the journal file for writing from the start or for appending
+///
+/// The path is predictable, so in a shared directory someone else may have
+/// put a link or a file of their own there. A journal started over is
+/// unlinked and created anew, never following a link; one appended to must
+/// be a regular file of ours.
+std::FILE* openJournal(const std::string& path, bool truncate, unsigned mode) {
+#ifdef ASTRAX_PLATFORM_WINDOWS
+    (void)mode;
+    return std::fopen(path.c_str(), truncate ? "wb" : "ab");
+#else
+    int fd;
+    if (truncate) {
+        ::unlink(path.c_str());
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+                    static_cast<mode_t>(mode));
+    } else {
+        fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_NOFOLLOW | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid()) {
+        ::close(fd);
+        return nullptr;
+    }
+    std::FILE* file = fdopen(fd, truncate ? "wb" : "ab");
+    if (!file) {
+        ::close(fd);
+    }
+    return file;
+#endif
+}
+
+/// Make written data durable
+bool syncFile(std::FILE* file) {
+#ifdef ASTRAX_PLATFORM_WINDOWS
+    return _commit(_fileno(file)) == 0;
+#elif defined(ASTRAX_PLATFORM_LINUX)
+    return fdatasync(fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// Journal Files
+// ============================================================================
+
+std::string Journal::pathFor(const std::string& filename) {
+    size_t slash = filename.find_last_of("/\\");
+    if (slash == std::string::npos) {
+        return "." + filename + ".axj";
+    }
+    return filename.substr(0, slash + 1) + "." + filename.substr(slash + 1) + ".axj";
+}
+
+bool Journal::exists(const std::string& filename) {
+    return std::ifstream(pathFor(filename), std::ios::binary).good();
+}
+
+bool Journal::read(const std::string& filename, std::vector<JournalRecord>& records,
+                   std::string& error) {
+    records.clear();
+    std::ifstream in(pathFor(filename), std::ios::binary);
+    if (!in) {
+        error = "no journal";
+        return false;
+    }
+    in.seekg(0, std::ios::end);
+    std::streamoff end = in.tellg();
+    if (end < 0) {
+        error = "cannot read journal";
+        return false;
+    }
+    std::string data(static_cast<size_t>(end), '\0');
+    in.seekg(0);
+    in.read(&data[0], static_cast<std::streamsize>(data.size()));
+    data.resize(static_cast<size_t>(in.gcount()));
+
+    if (data.size() < HEADER_SIZE || data.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0) {
+        error = "not a journal";
+        return false;
+    }
+
+    // Offsets are only meaningful against the exact content they were logged on
+    uint64_t size = 0;
+    uint64_t mtime = 0;
+    fileIdentity(filename, size, mtime);
+    if (getU64(data.data() + 4) != size || getU64(data.data() + 12) != mtime) {
+        error = "file changed since the journal was written";
+        return false;
+    }
+
+    size_t pos = HEADER_SIZE;
+    while (data.size() - pos >= RECORD_OVERHEAD && data[pos] == RECORD_TAG) {
+        const char* record = data.data() + pos;
+        size_t length = getU32(record + 17);
+        if (data.size() - pos - RECORD_OVERHEAD < length) {
+            break;
+        }
+        size_t body = RECORD_OVERHEAD - 4 + length;
+        if (getU32(record + body) != checksum(record, body)) {
+            break;
+        }
+
+        JournalRecord op;
+        op.offset = static_cast<size_t>(getU64(record + 1));
+        op.removed = static_cast<size_t>(getU64(record + 9));
+        op.inserted.assign(record + 21, length);
+        records.push_back(std::move(op));
+        pos += body + 4;
+    }
+    return true;
+}
+
+// ============================================================================
+// Logging
+// ============================================================================
+
+Journal::~Journal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void Journal::open(const std::string& filename) {
+    close();
+
+    filename_ = filename;
+    header_ = encodeHeader(filename);
+    headerQueued_ = false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    path_ = pathFor(filename);
+    mode_ = journalMode(filename);
+}
+
+void Journal::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!filename_.empty()) {
+        removals_.push_back(path_);
+        startWriter();
+    }
+    pending_.clear();
+    truncate_ = false;
+
+    filename_.clear();
+    headerQueued_ = false;
+    sequence_ = 0;
+    retained_.clear();
+    retainedFrom_ = 0;
+    marks_.clear();
+}
+
+void Journal::record(size_t offset, size_t removed, StringView inserted) {
+    if (filename_.empty()) {
+        return;
+    }
+
+    std::string bytes = encodeRecord(offset, removed, inserted);
+    if (!marks_.empty()) {
+        retained_.push_back(bytes);
+    }
+    ++sequence_;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue(bytes);
+}
+
+void Journal::queue(const std::string& bytes) {
+    // The first record after a (re)start replaces whatever is on disk
+    if (!headerQueued_) {
+        pending_ = header_;
+        truncate_ = true;
+        headerQueued_ = true;
+    }
+    pending_ += bytes;
+    startWriter();
+}
+
+uint64_t Journal::mark() {
+    if (retained_.empty()) {
+        retainedFrom_ = sequence_;
+    }
+    marks_.insert(sequence_);
+    return sequence_;
+}
+
+void Journal::rebase(uint64_t mark, const std::string& filename) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (filename != filename_) {
+        if (!filename_.empty()) {
+            removals_.push_back(path_);
+        }
+        filename_ = filename;
+        path_ = pathFor(filename);
+    }
+    mode_ = journalMode(filename);
+    header_ = encodeHeader(filename);
+    headerQueued_ = false;
+    pending_.clear();
+    truncate_ = false;
+
+    // Edits made while the save was running are relative to the saved content
+    bool kept = false;
+    for (size_t i = mark > retainedFrom_ ? static_cast<size_t>(mark - retainedFrom_) : 0;
+         i < retained_.size(); ++i) {
+        queue(retained_[i]);
+        kept = true;
+    }
+    if (!kept) {
+        removals_.push_back(path_);  // The file has every edit
+        startWriter();
+    }
+
+    auto it = marks_.find(mark);
+    if (it != marks_.end()) {
+        marks_.erase(it);
+    }
+    trimRetained();
+}
+
+void Journal::release(uint64_t mark) {
+    auto it = marks_.find(mark);
+    if (it != marks_.end()) {
+        marks_.erase(it);
+    }
+    trimRetained();
+}
+
+void Journal::trimRetained() {
+    uint64_t keepFrom = marks_.empty() ? sequence_ : *marks_.begin();
+    while (!retained_.empty() && retainedFrom_ < keepFrom) {
+        retained_.pop_front();
+        ++retainedFrom_;
+    }
+    if (retained_.empty()) {
+        retainedFrom_ = keepFrom;
+    }
+}
+
+void Journal::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    urgent_ = true;
+    wake_.notify_one();
+    written_.wait(lock, [this] { return !hasWork() && !writing_; });
+    urgent_ = false;
+}
+
+// ============================================================================
+// Writer Thread
+// ============================================================================
+
+void Journal::startWriter() {
+    if (!thread_.joinable()) {
+        thread_ = std::thread(&Journal::run, this);
+    }
+    wake_.notify_one();
+}
+
+bool Journal::isWriting() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hasWork() || writing_;
+}
+
+bool Journal::hasWork() const {
+    return !pending_.empty() || !removals_.empty();
+}
+
+void Journal::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stop_ || hasWork(); });
+        if (!hasWork()) {
+            break;  // Stopping with nothing left to write
+        }
+
+        // Let a burst of edits gather into one write and one sync
+        wake_.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS),
+                       [this] { return stop_ || urgent_; });
+
+        std::vector<std::string> removals;
+        removals.swap(removals_);
+        std::string bytes;
+        bytes.swap(pending_);
+        bool truncate = truncate_;
+        truncate_ = false;
+        std::string path = path_;
+        unsigned mode = mode_;
+        writing_ = true;
+        lock.unlock();
+
+        for (const auto& removal : removals) {
+            if (filePath_ == removal) {
+                if (file_) {
+                    std::fclose(file_);
+                    file_ = nullptr;
+                }
+                // Nothing is left to protect
+                contents_.clear();
+                rewrite_ = false;
+                failed_.store(false, std::memory_order_relaxed);
+            }
+            std::remove(removal.c_str());
+        }
+
+        if (!bytes.empty()) {
+            bool ok = writeBatch(path, truncate, mode, bytes);
+            failed_.store(!ok, std::memory_order_relaxed);
+        }
+
+        lock.lock();
+        writing_ = false;
+        written_.notify_all();
+    }
+
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool Journal::writeBatch(const std::string& path, bool truncate, unsigned mode,
+                         const std::string& bytes) {
+    if (truncate || filePath_ != path) {
+        contents_.clear();
+        rewrite_ = false;
+    }
+    contents_ += bytes;
+
+    // After a failure the file may end in a torn record; start it over
+    if (rewrite_) {
+        truncate = true;
+    }
+    if (file_ && (truncate || filePath_ != path)) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    if (!file_) {
+        file_ = openJournal(path, truncate, mode);
+        filePath_ = path;
+    }
+
+    const std::string& out = truncate ? contents_ : bytes;
+    bool ok = file_ && std::fwrite(out.data(), 1, out.size(), file_) == out.size() &&
+              std::fflush(file_) == 0 && syncFile(file_);
+    if (!ok && file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    rewrite_ = !ok;
+    return ok;
+}
+
+} // namespace astrax
@@ -0,0 +1,308 @@
+#include "astrax/line_index.h"
+#include "astrax/cpu_features.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#ifdef ASTRAX_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace astrax {
+
+namespace {
+
+/// Bytes handed to a kernel per call when building an index
+constexpr size_t SCAN_BLOCK = 64 * 1024;
+
+/// Scan kernel: count '\n' in [data, data + size) and, if out is set, write
+/// base + offset of each one to out. Updates stats, returns the count.
+using ScanKernel = size_t (*)(const char* data, size_t size, uint32_t base,
+                              uint32_t* out, NewlineStats& stats);
+
+// ============================================================================
+// Bit Helpers
+// ============================================================================
+
+inline size_t popcount64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<size_t>(__builtin_popcountll(x));
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return static_cast<size_t>((x * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+inline uint32_t ctz64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<uint32_t>(__builtin_ctzll(x));
+#elif defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<uint32_t>(index);
+#else
+    uint32_t n = 0;
+    while (!(x & 1)) { x >>= 1; ++n; }
+    return n;
+#endif
+}
+
+/// Consume the newline and carriage-return masks of one 64-byte block
+inline size_t consumeMasks(uint64_t newlines, uint64_t returns, uint32_t position,
+                           uint32_t* out, size_t count, NewlineStats& stats) {
+    uint64_t crlf = newlines & ((returns << 1) | (stats.pendingCr ? 1u : 0u));
+    stats.pendingCr = (returns >> 63) != 0;
+    stats.crlf += popcount64(crlf);
+
+    if (!out) {
+        return count + popcount64(newlines);
+    }
+    while (newlines) {
+        out[count++] = position + ctz64(newlines);
+        newlines &= newlines - 1;
+    }
+    return count;
+}
+
+// ============================================================================
+// Scalar Kernel
+// ============================================================================
+
+size_t scanScalar(const char* data, size_t size, uint32_t base,
+                  uint32_t* out, NewlineStats& stats) {
+    size_t count = 0;
+    const char* pos = data;
+    const char* end = data + size;
+    while (pos < end) {
+        const char* hit = static_cast<const char*>(
+            std::memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        if (!hit) break;
+        if (hit > data ? hit[-1] == '\r' : stats.pendingCr) {
+            ++stats.crlf;
+        }
+        if (out) {
+            out[count] = base + static_cast<uint32_t>(hit - data);
+        }
+        ++count;
+        pos = hit + 1;
+    }
+    if (size > 0) {
+        stats.pendingCr = data[size - 1] == '\r';
+    }
+    stats.newlines += count;
+    return count;
+}
+
+#ifdef ASTRAX_X86
+
+// ============================================================================
+// SSE2 Kernel
+// ============================================================================
+
+ASTRAX_TARGET("sse2")
+size_t scanSse2(const char* data, size_t size, uint32_t base,
+                uint32_t* out, NewlineStats& stats) {
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= size; i += 64) {
+        uint64_t newlines = 0;
+        uint64_t returns = 0;
+        for (int lane = 0; lane < 4; ++lane) {
+            __m128i bytes = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(data + i + static_cast<size_t>(lane) * 16));
+            int shift = lane * 16;
+            newlines |= static_cast<uint64_t>(static_cast<uint32_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, lf)))) << shift;
+            returns |= static_cast<uint64_t>(static_cast<uint32_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, cr)))) << shift;
+        }
+        if ((newlines | returns) == 0) {
+            stats.pendingCr = false;
+            continue;
+        }
+        count = consumeMasks(newlines, returns, base + static_cast<uint32_t>(i),
+                             out, count, stats);
+    }
+
+    stats.newlines += count;
+    return count + scanScalar(data + i, size - i, base + static_cast<uint32_t>(i),
+                              out ? out + count : nullptr, stats);
+}
+
+// ============================================================================
+// AVX2 Kernel
+// ============================================================================
+
+ASTRAX_TARGET("avx2,popcnt,bmi")
+size_t scanAvx2(const char* data, size_t size, uint32_t base,
+                uint32_t* out, NewlineStats& stats) {
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= size; i += 64) {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+        uint64_t newlines =
+            static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, lf)))) |
+            static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, lf)))) << 32;
+        uint64_t returns =
+            static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, cr)))) |
+            static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, cr)))) << 32;
+        if ((newlines | returns) == 0) {
+            stats.pendingCr = false;
+            continue;
+        }
+        count = consumeMasks(newlines, returns, base + static_cast<uint32_t>(i),
+                             out, count, stats);
+    }
+
+    stats.newlines += count;
+    return count + scanScalar(data + i, size - i, base + static_cast<uint32_t>(i),
+                              out ? out + count : nullptr, stats);
+}
+
+#endif // ASTRAX_X86
+
+struct Kernel {
+    ScanKernel scan;
+    const char* name;
+};
+
+/// Pick the widest kernel the CPU supports, once
+const Kernel& kernel() {
+    static const Kernel selected = []() -> Kernel {
+#ifdef ASTRAX_X86
+        if (cpuHasAvx2()) return {scanAvx2, "avx2"};
+        if (cpuHasSse2()) return {scanSse2, "sse2"};
+#endif
+        return {scanScalar, "scalar"};
+    }();
+    return selected;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// Counting
+// ============================================================================
+
+size_t countNewlines(const char* data, size_t size, NewlineStats& stats) {
+    return kernel().scan(data, size, 0, nullptr, stats);
+}
+
+size_t countNewlines(const char* data, size_t size) {
+    NewlineStats stats;
+    return countNewlines(data, size, stats);
+}
+
+const char* newlineKernelName() {
+    return kernel().name;
+}
+
+// ============================================================================
+// LineIndex
+// ============================================================================
+
+void LineIndex::build(const char* data, size_t size) {
+    low_.clear();
+    segments_.clear();
+    stats_ = NewlineStats();
+
+    ScanKernel scan = kernel().scan;
+    std::unique_ptr<uint32_t[]> scratch(new uint32_t[SCAN_BLOCK]);
+
+    // Blocks never straddle a 4 GB boundary, so base + offset fits 32 bits
+    for (size_t start = 0; start < size; start += SCAN_BLOCK) {
+        size_t segment = static_cast<size_t>(static_cast<uint64_t>(start) >> 32);
+        while (segments_.size() <= segment) {
+            segments_.push_back(low_.size());
+        }
+
+        size_t length = std::min(SCAN_BLOCK, size - start);
+        uint32_t base = static_cast<uint32_t>(start & 0xFFFFFFFFu);
+        size_t found = scan(data + start, length, base, scratch.get(), stats_);
+        low_.insert(low_.end(), scratch.get(), scratch.get() + found);
+    }
+}
+
+void LineIndex::append(size_t offset) {
+    size_t segment = static_cast<size_t>(static_cast<uint64_t>(offset) >> 32);
+    while (segments_.size() <= segment) {
+        segments_.push_back(low_.size());
+    }
+    low_.push_back(static_cast<uint32_t>(offset & 0xFFFFFFFFu));
+}
+
+void LineIndex::removeLast() {
+    low_.pop_back();
+}
+
+void LineIndex::stripCarriageReturns(std::string& text) {
+    LineIndex result;
+    result.low_.reserve(low_.size());
+    result.stats_ = stats_;
+
+    // Bytes in [in, next CRLF) move down to out in one block
+    size_t out = 0;
+    size_t in = 0;
+    for (size_t i = 0; i < size(); ++i) {
+        size_t newline = (*this)[i];
+        if (newline > in && text[newline - 1] == '\r') {
+            size_t length = newline - 1 - in;
+            if (out != in) {
+                std::memmove(&text[out], &text[in], length);
+            }
+            out += length;
+            in = newline;
+        }
+        result.append(out + (newline - in));
+    }
+    if (in < text.size() && out != in) {
+        std::memmove(&text[out], &text[in], text.size() - in);
+    }
+    text.resize(out + (text.size() - in));
+
+    *this = std::move(result);
+}
+
+size_t LineIndex::segmentOf(size_t index) const {
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), index);
+    return static_cast<size_t>(it - segments_.begin()) - 1;
+}
+
+size_t LineIndex::operator[](size_t i) const {
+    if (segments_.size() <= 1) {
+        return low_[i];
+    }
+    uint64_t high = static_cast<uint64_t>(segmentOf(i)) << 32;
+    return static_cast<size_t>(high | low_[i]);
+}
+
+size_t LineIndex::lowerBound(size_t offset) const {
+    size_t segment = static_cast<size_t>(static_cast<uint64_t>(offset) >> 32);
+    if (segment >= segments_.size()) {
+        return size();
+    }
+    size_t first = segments_[segment];
+    size_t last = segment + 1 < segments_.size() ? segments_[segment + 1] : size();
+    auto begin = low_.begin() + static_cast<std::ptrdiff_t>(first);
+    auto end = low_.begin() + static_cast<std::ptrdiff_t>(last);
+    auto it = std::lower_bound(begin, end, static_cast<uint32_t>(offset & 0xFFFFFFFFu));
+    return static_cast<size_t>(it - low_.begin());
+}
+
+size_t LineIndex::memoryUsage() const {
+    return low_.capacity() * sizeof(uint32_t) + segments_.capacity() * sizeof(size_t);
+}
+
+} // namespace astrax
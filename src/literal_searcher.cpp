@@ -0,0 +1,275 @@
+#include "astrax/literal_searcher.h"
+#include "astrax/cpu_features.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef ASTRAX_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace astrax {
+
+namespace {
+
+/// Search kernel: first position in [from, size - pattern size] where the
+/// searcher matches, or npos
+using FindKernel = size_t (*)(const LiteralSearcher& searcher, const char* data,
+                              size_t size, size_t from);
+
+// ============================================================================
+// Case Folding
+// ============================================================================
+
+/// ASCII lower-casing, as std::tolower does in the "C" locale
+struct FoldTable {
+    unsigned char map[256];
+    
+    constexpr FoldTable() : map() {
+        for (int c = 0; c < 256; ++c) {
+            map[c] = static_cast<unsigned char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+        }
+    }
+};
+
+constexpr FoldTable FOLD;
+
+inline uint32_t ctz32(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<uint32_t>(__builtin_ctz(x));
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return static_cast<uint32_t>(index);
+#else
+    uint32_t n = 0;
+    while (!(x & 1)) { x >>= 1; ++n; }
+    return n;
+#endif
+}
+
+inline unsigned char fold(char c) {
+    return FOLD.map[static_cast<unsigned char>(c)];
+}
+
+/// Rough frequency of a byte in source code and logs; higher is more common
+int byteFrequency(unsigned char c) {
+    static const char COMMON_LETTERS[] = "etaoinsrlcdmuhpfgybwvkxjqz";
+    if (c == ' ') {
+        return 255;
+    }
+    if (c >= 'a' && c <= 'z') {
+        const char* rank = std::strchr(COMMON_LETTERS, c);
+        return 240 - static_cast<int>(rank - COMMON_LETTERS) * 3;
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return 90;
+    }
+    if (c >= '0' && c <= '9') {
+        return 150;
+    }
+    if (c == '\t' || (c != 0 && std::strchr("()_.,;:=\"'-/*", c) != nullptr)) {
+        return 130;
+    }
+    return 50;  // Other punctuation, control and non-ASCII bytes
+}
+
+// ============================================================================
+// Scalar Kernel
+// ============================================================================
+
+size_t findScalar(const LiteralSearcher& searcher, const char* data, size_t size, size_t from) {
+    size_t length = searcher.size();
+    if (size < length || from > size - length) {
+        return LiteralSearcher::npos;
+    }
+    size_t lastStart = size - length;
+    const LiteralSearcher::Probe& probe = searcher.probe(0);
+    
+    if (probe.fold == 0) {
+        // Jump between occurrences of the rare byte
+        const char* pos = data + from + probe.offset;
+        const char* end = data + lastStart + probe.offset + 1;
+        while (pos < end) {
+            const char* hit = static_cast<const char*>(
+                std::memchr(pos, probe.byte, static_cast<size_t>(end - pos)));
+            if (!hit) {
+                break;
+            }
+            size_t start = static_cast<size_t>(hit - data) - probe.offset;
+            if (searcher.matchesAt(data + start)) {
+                return start;
+            }
+            pos = hit + 1;
+        }
+        return LiteralSearcher::npos;
+    }
+    
+    for (size_t start = from; start <= lastStart; ++start) {
+        if ((static_cast<unsigned char>(data[start + probe.offset]) | probe.fold) == probe.byte &&
+            searcher.matchesAt(data + start)) {
+            return start;
+        }
+    }
+    return LiteralSearcher::npos;
+}
+
+#ifdef ASTRAX_X86
+
+// ============================================================================
+// SSE2 Kernel
+// ============================================================================
+
+ASTRAX_TARGET("sse2")
+size_t findSse2(const LiteralSearcher& searcher, const char* data, size_t size, size_t from) {
+    size_t length = searcher.size();
+    if (size < length || from > size - length) {
+        return LiteralSearcher::npos;
+    }
+    const LiteralSearcher::Probe& first = searcher.probe(0);
+    const LiteralSearcher::Probe& second = searcher.probe(1);
+    const __m128i firstByte = _mm_set1_epi8(static_cast<char>(first.byte));
+    const __m128i firstFold = _mm_set1_epi8(static_cast<char>(first.fold));
+    const __m128i secondByte = _mm_set1_epi8(static_cast<char>(second.byte));
+    const __m128i secondFold = _mm_set1_epi8(static_cast<char>(second.fold));
+    
+    // Every start in a block is a valid one, so probe loads stay in bounds
+    size_t starts = size - length + 1;
+    size_t start = from;
+    for (; start + 16 <= starts; start += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + start + first.offset));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + start + second.offset));
+        __m128i hits = _mm_and_si128(_mm_cmpeq_epi8(_mm_or_si128(a, firstFold), firstByte),
+                                     _mm_cmpeq_epi8(_mm_or_si128(b, secondFold), secondByte));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+        while (mask) {
+            size_t candidate = start + ctz32(mask);
+            if (searcher.matchesAt(data + candidate)) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(searcher, data, size, start);
+}
+
+// ============================================================================
+// AVX2 Kernel
+// ============================================================================
+
+ASTRAX_TARGET("avx2,popcnt,bmi")
+size_t findAvx2(const LiteralSearcher& searcher, const char* data, size_t size, size_t from) {
+    size_t length = searcher.size();
+    if (size < length || from > size - length) {
+        return LiteralSearcher::npos;
+    }
+    const LiteralSearcher::Probe& first = searcher.probe(0);
+    const LiteralSearcher::Probe& second = searcher.probe(1);
+    const __m256i firstByte = _mm256_set1_epi8(static_cast<char>(first.byte));
+    const __m256i firstFold = _mm256_set1_epi8(static_cast<char>(first.fold));
+    const __m256i secondByte = _mm256_set1_epi8(static_cast<char>(second.byte));
+    const __m256i secondFold = _mm256_set1_epi8(static_cast<char>(second.fold));
+    
+    size_t starts = size - length + 1;
+    size_t start = from;
+    for (; start + 32 <= starts; start += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + start + first.offset));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + start + second.offset));
+        __m256i hits = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_or_si256(a, firstFold), firstByte),
+                                        _mm256_cmpeq_epi8(_mm256_or_si256(b, secondFold), secondByte));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+        while (mask) {
+            size_t candidate = start + ctz32(mask);
+            if (searcher.matchesAt(data + candidate)) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(searcher, data, size, start);
+}
+
+#endif // ASTRAX_X86
+
+/// Pick the widest kernel the CPU supports, once
+FindKernel kernel() {
+    static const FindKernel selected = []() -> FindKernel {
+#ifdef ASTRAX_X86
+        if (cpuHasAvx2()) return findAvx2;
+        if (cpuHasSse2()) return findSse2;
+#endif
+        return findScalar;
+    }();
+    return selected;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// Literal Search
+// ============================================================================
+
+constexpr size_t LiteralSearcher::npos;
+
+LiteralSearcher::LiteralSearcher(const std::string& pattern, bool caseSensitive)
+    : pattern_(pattern), caseSensitive_(caseSensitive) {
+    if (!caseSensitive_) {
+        for (char& c : pattern_) {
+            c = static_cast<char>(fold(c));
+        }
+    }
+    if (pattern_.empty()) {
+        return;
+    }
+    
+    // The two rarest bytes at different positions; a folded letter also
+    // matches its upper case
+    auto score = [this](size_t offset) {
+        unsigned char c = static_cast<unsigned char>(pattern_[offset]);
+        bool folded = !caseSensitive_ && c >= 'a' && c <= 'z';
+        return byteFrequency(c) + (folded ? 10 : 0);
+    };
+    size_t rarest = 0;
+    for (size_t i = 1; i < pattern_.size(); ++i) {
+        if (score(i) < score(rarest)) {
+            rarest = i;
+        }
+    }
+    size_t next = rarest == 0 ? pattern_.size() - 1 : 0;
+    for (size_t i = 0; i < pattern_.size(); ++i) {
+        if (i != rarest && score(i) < score(next)) {
+            next = i;
+        }
+    }
+    
+    size_t offsets[2] = {rarest, next};
+    for (size_t i = 0; i < 2; ++i) {
+        unsigned char c = static_cast<unsigned char>(pattern_[offsets[i]]);
+        probes_[i].offset = offsets[i];
+        probes_[i].byte = c;
+        probes_[i].fold = (!caseSensitive_ && c >= 'a' && c <= 'z') ? 0x20 : 0;
+    }
+}
+
+size_t LiteralSearcher::find(const char* data, size_t size, size_t from) const {
+    if (pattern_.empty()) {
+        return npos;
+    }
+    return kernel()(*this, data, size, from);
+}
+
+bool LiteralSearcher::matchesAt(const char* data) const {
+    if (caseSensitive_) {
+        return std::memcmp(data, pattern_.data(), pattern_.size()) == 0;
+    }
+    for (size_t i = 0; i < pattern_.size(); ++i) {
+        if (fold(data[i]) != static_cast<unsigned char>(pattern_[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace astrax
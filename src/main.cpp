@@ -7,8 +7,12 @@
  */
 
 #include "astrax/editor.h"
+#include "astrax/journal.h"
 #include <iostream>
 #include <string>
+#include <vector>
+#include <cctype>
+#include <cstdio>
 #include <cstdlib>
 
 #ifdef ASTRAX_PLATFORM_WINDOWS
@@ -86,6 +90,36 @@ void launchExternalWindow(int argc, char* argv[]) {
 #endif
 }
 
+/// Ask what to do with a journal left behind by a session that did not exit
+///
+/// Returns 'r' to recover, 'd' to delete the journal or 'q' to quit.
+char askRecovery(const std::string& filename) {
+    std::vector<astrax::JournalRecord> records;
+    std::string error;
+    bool readable = astrax::Journal::read(filename, records, error);
+    
+    std::cout << "Found recovery journal " << astrax::Journal::pathFor(filename) << "\n";
+    if (readable) {
+        std::cout << "It holds " << records.size() << " unsaved edit(s) to \"" << filename << "\".\n";
+    } else {
+        std::cout << "It cannot be replayed: " << error << ".\n";
+    }
+    std::cout << "An earlier session crashed, or the file is open in another AstraX.\n";
+    
+    for (;;) {
+        std::cout << (readable ? "[R]ecover, [D]elete journal, [Q]uit: " : "[D]elete journal, [Q]uit: ")
+                  << std::flush;
+        std::string answer;
+        if (!std::getline(std::cin, answer)) {
+            return 'q';
+        }
+        char choice = answer.empty() ? '\0' : static_cast<char>(std::tolower(static_cast<unsigned char>(answer[0])));
+        if ((choice == 'r' && readable) || choice == 'd' || choice == 'q') {
+            return choice;
+        }
+    }
+}
+
 } // anonymous namespace
 
 int main(int argc, char* argv[]) {
@@ -115,10 +149,23 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
+    // Offer to replay edits a crashed session did not save
+    bool recover = false;
+    if (!filename.empty() && astrax::Journal::exists(filename)) {
+        char choice = askRecovery(filename);
+        if (choice == 'q') {
+            return 0;
+        }
+        if (choice == 'd') {
+            std::remove(astrax::Journal::pathFor(filename).c_str());
+        }
+        recover = (choice == 'r');
+    }
+    
     // Run the editor
     try {
         astrax::Editor editor;
-        editor.run(filename);
+        editor.run(filename, recover);
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
@@ -0,0 +1,211 @@
+#include "astrax/mapped_file.h"
+#include <algorithm>
+
+#ifdef ASTRAX_PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace astrax {
+
+constexpr size_t MappedFile::CHUNK_SIZE;
+
+// ============================================================================
+// Mapping
+// ============================================================================
+
+#ifdef ASTRAX_PLATFORM_WINDOWS
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    
+    BY_HANDLE_FILE_INFORMATION info;
+    LARGE_INTEGER size;
+    if (!GetFileInformationByHandle(file, &info) || !GetFileSizeEx(file, &size) ||
+        size.QuadPart <= 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+    
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return nullptr;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return nullptr;
+    }
+    
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
+    mapped->file_ = file;
+    mapped->mapping_ = mapping;
+    mapped->data_ = static_cast<const char*>(view);
+    mapped->size_ = static_cast<size_t>(size.QuadPart);
+    mapped->device_ = info.dwVolumeSerialNumber;
+    mapped->inode_ = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    mapped->initIndex();
+    return mapped;
+}
+
+MappedFile::~MappedFile() {
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_) CloseHandle(file_);
+}
+
+bool MappedFile::isSameFile(const std::string& path) const {
+    HANDLE file = CreateFileA(path.c_str(), 0,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, 0, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    bool same = GetFileInformationByHandle(file, &info) &&
+                info.dwVolumeSerialNumber == device_ &&
+                ((static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow) == inode_;
+    CloseHandle(file);
+    return same;
+}
+
+#else
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    
+    size_t size = static_cast<size_t>(st.st_size);
+    void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    
+    // The index pass reads front to back; indexTo() resets this when done
+    madvise(view, size, MADV_SEQUENTIAL);
+    
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
+    mapped->fd_ = fd;
+    mapped->data_ = static_cast<const char*>(view);
+    mapped->size_ = size;
+    mapped->device_ = static_cast<uint64_t>(st.st_dev);
+    mapped->inode_ = static_cast<uint64_t>(st.st_ino);
+    mapped->initIndex();
+    return mapped;
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool MappedFile::isSameFile(const std::string& path) const {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    return static_cast<uint64_t>(st.st_dev) == device_ &&
+           static_cast<uint64_t>(st.st_ino) == inode_;
+}
+
+#endif
+
+// ============================================================================
+// Newline Index
+// ============================================================================
+
+void MappedFile::initIndex() {
+    // Sized up front so indexing never moves entries readers may look at
+    size_t chunks = (size_ + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunkNewlines_.assign(chunks + 1, 0);
+    indexed_ = true;
+}
+
+void MappedFile::indexTo(size_t end) {
+    end = std::min(end, size_);
+    size_t chunks = indexedChunks_.load(std::memory_order_relaxed);
+    size_t indexed = std::min(chunks * CHUNK_SIZE, size_);
+    while (indexed < end) {
+        size_t length = std::min(CHUNK_SIZE, size_ - indexed);
+        astrax::countNewlines(data_ + indexed, length, stats_);
+        indexed += length;
+        chunkNewlines_[++chunks] = stats_.newlines;
+        
+        // Readers see the entry before the count that covers it
+        indexedChunks_.store(chunks, std::memory_order_release);
+    }
+    
+#ifndef ASTRAX_PLATFORM_WINDOWS
+    if (indexed == size_) {
+        madvise(const_cast<char*>(data_), size_, MADV_NORMAL);
+    }
+#endif
+}
+
+size_t MappedFile::indexedSize() const {
+    return std::min(indexedChunks_.load(std::memory_order_acquire) * CHUNK_SIZE, size_);
+}
+
+size_t MappedFile::newlinesBefore(size_t offset) const {
+    size_t chunk = offset / CHUNK_SIZE;
+    size_t chunkStart = chunk * CHUNK_SIZE;
+    return chunkNewlines_[chunk] + TextBlock::countNewlines(chunkStart, offset - chunkStart);
+}
+
+size_t MappedFile::countNewlines(size_t start, size_t length) const {
+    if (length <= CHUNK_SIZE) {
+        return TextBlock::countNewlines(start, length);
+    }
+    return newlinesBefore(start + length) - newlinesBefore(start);
+}
+
+size_t MappedFile::nthNewline(size_t start, size_t length, size_t n) const {
+    // Entries past the indexed chunks are not written yet
+    size_t chunks = indexedChunks_.load(std::memory_order_acquire);
+    
+    // Global index of the wanted newline, then the chunk that holds it
+    size_t before = newlinesBefore(start);
+    size_t target = before + n;
+    if (target > chunkNewlines_[chunks]) {
+        return length;
+    }
+    auto indexedEnd = chunkNewlines_.begin() + static_cast<std::ptrdiff_t>(chunks + 1);
+    auto it = std::lower_bound(chunkNewlines_.begin(), indexedEnd, target);
+    size_t chunk = static_cast<size_t>(it - chunkNewlines_.begin()) - 1;
+    size_t chunkStart = chunk * CHUNK_SIZE;
+    size_t scanFrom = std::max(chunkStart, start);
+    size_t skip = target - (scanFrom == start ? before : chunkNewlines_[chunk]);
+    
+    size_t scanLength = std::min(chunkStart + CHUNK_SIZE, size_) - scanFrom;
+    size_t found = TextBlock::nthNewline(scanFrom, scanLength, skip);
+    if (found == scanLength) {
+        return length;
+    }
+    return std::min(scanFrom + found - start, length);
+}
+
+} // namespace astrax
@@ -0,0 +1,127 @@
+#include "astrax/match_cache.h"
+#include <algorithm>
+
+namespace astrax {
+
+constexpr size_t MatchCache::MARGIN_LINES;
+
+// ============================================================================
+// Window
+// ============================================================================
+
+void MatchCache::prepare(const Buffer& buffer, const Search& search, size_t firstLine, size_t endLine) {
+    if (!sameSearch(search) || buffer.id() != bufferId_ || !buffer.changesSince(changeCount_, changes_)) {
+        clear();
+        pattern_ = search.getPattern();
+        options_ = search.getOptions();
+    } else {
+        for (const auto& change : changes_) {
+            applyChange(change);
+        }
+    }
+    bufferId_ = buffer.id();
+    changeCount_ = buffer.changeCount();
+    
+    if (pattern_.empty() || !search.isPatternValid()) {
+        lines_.clear();
+        return;
+    }
+    
+    size_t lineCount = buffer.lineCount();
+    size_t end = std::min(endLine + MARGIN_LINES, lineCount);
+    size_t first = std::min(firstLine - std::min(firstLine, MARGIN_LINES), end);
+    moveWindow(first, end);
+    
+    // Search the run of lines from the first unknown one to the last,
+    // walking the text once
+    auto known = [](const Line& line) { return line.known; };
+    auto firstUnknown = std::find_if_not(lines_.begin(), lines_.end(), known);
+    if (firstUnknown == lines_.end()) {
+        return;
+    }
+    auto lastUnknown = std::find_if_not(lines_.rbegin(), lines_.rend(), known);
+    size_t searchFirst = first_ + static_cast<size_t>(firstUnknown - lines_.begin());
+    size_t searchEnd = first_ + static_cast<size_t>(lines_.rend() - lastUnknown);
+    
+    buffer.getTable().forEachLine(searchFirst, searchEnd, scratch_, [&](size_t line, StringView text) {
+        Line& entry = lines_[line - first_];
+        if (entry.known) {
+            return;
+        }
+        entry.matches.clear();
+        search.matchLine(text, entry.matches);
+        entry.known = true;
+        ++searchedLines_;
+    });
+}
+
+MatchSpan MatchCache::lineMatches(size_t line) const {
+    if (line < first_ || line - first_ >= lines_.size()) {
+        return MatchSpan();
+    }
+    const Line& entry = lines_[line - first_];
+    return MatchSpan{entry.matches.data(), entry.matches.size()};
+}
+
+void MatchCache::clear() {
+    lines_.clear();
+    first_ = 0;
+}
+
+bool MatchCache::sameSearch(const Search& search) const {
+    const SearchOptions& options = search.getOptions();
+    return search.getPattern() == pattern_ &&
+           options.caseSensitive == options_.caseSensitive &&
+           options.wholeWord == options_.wholeWord &&
+           options.useRegex == options_.useRegex;
+}
+
+void MatchCache::moveWindow(size_t first, size_t end) {
+    size_t oldEnd = first_ + lines_.size();
+    if (first == first_ && end == oldEnd) {
+        return;
+    }
+    
+    moved_.clear();
+    moved_.resize(end - first);
+    for (size_t line = std::max(first, first_); line < std::min(end, oldEnd); ++line) {
+        moved_[line - first] = std::move(lines_[line - first_]);
+    }
+    lines_.swap(moved_);
+    first_ = first;
+}
+
+// ============================================================================
+// Edits
+// ============================================================================
+
+void MatchCache::applyChange(const LineChange& change) {
+    size_t end = first_ + lines_.size();
+    size_t rewrittenEnd = change.line + change.removedLines + 1;   // Past the old lines it rewrote
+    if (change.line >= end) {
+        return;
+    }
+    if (rewrittenEnd <= first_) {
+        // Above the window: its lines only move
+        first_ = first_ - change.removedLines + change.insertedLines;
+        return;
+    }
+    
+    auto at = [this](size_t line) { return lines_.begin() + static_cast<std::ptrdiff_t>(line - first_); };
+    if (change.line < first_) {
+        // Over the top of the window: what is left starts after the new lines
+        lines_.erase(lines_.begin(), at(std::min(rewrittenEnd, end)));
+        first_ = change.line + change.insertedLines + 1;
+        return;
+    }
+    
+    lines_.erase(at(change.line), at(std::min(rewrittenEnd, end)));
+    if (rewrittenEnd >= end || change.insertedLines >= lines_.size()) {
+        // The rest of the window moved out of it; it now ends at the change
+        lines_.resize(change.line - first_);
+        return;
+    }
+    lines_.insert(at(change.line), change.insertedLines + 1, Line());
+}
+
+} // namespace astrax
@@ -0,0 +1,482 @@
+#include "astrax/piece_table.h"
+#include <algorithm>
+#include <cstring>
+
+namespace astrax {
+
+// ============================================================================
+// TextBlock
+// ============================================================================
+
+size_t TextBlock::countNewlines(size_t start, size_t length) const {
+    return astrax::countNewlines(data_ + start, length);
+}
+
+size_t TextBlock::nthNewline(size_t start, size_t length, size_t n) const {
+    const char* begin = data_ + start;
+    const char* pos = begin;
+    const char* end = begin + length;
+    while (pos < end) {
+        const char* hit = static_cast<const char*>(
+            std::memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        if (!hit) break;
+        if (--n == 0) {
+            return static_cast<size_t>(hit - begin);
+        }
+        pos = hit + 1;
+    }
+    return length;
+}
+
+namespace {
+
+/// Original block owning its bytes, with a newline index built up front
+class StringBlock : public TextBlock {
+public:
+    StringBlock(std::string text, LineIndex index)
+        : text_(std::move(text)), index_(std::move(index)) {
+        data_ = text_.data();
+        size_ = text_.size();
+        indexed_ = true;
+    }
+
+    size_t countNewlines(size_t start, size_t length) const override {
+        return index_.lowerBound(start + length) - index_.lowerBound(start);
+    }
+
+    size_t nthNewline(size_t start, size_t length, size_t n) const override {
+        size_t first = index_.lowerBound(start);
+        if (index_.size() - first < n) {
+            return length;
+        }
+        return std::min(index_[first + n - 1] - start, length);
+    }
+
+private:
+    std::string text_;
+    LineIndex index_;
+};
+
+} // anonymous namespace
+
+/// Append-only block for inserted text; bytes below size() never change
+class PieceTable::AddBlock : public TextBlock {
+public:
+    explicit AddBlock(size_t capacity)
+        : storage_(new char[capacity]), capacity_(capacity) {
+        data_ = storage_.get();
+    }
+
+    size_t remaining() const { return capacity_ - size_; }
+
+    /// Copy text to the tail of the block, returns its start offset
+    size_t append(const char* text, size_t length) {
+        size_t start = size_;
+        std::memcpy(storage_.get() + size_, text, length);
+        size_ += length;
+        return start;
+    }
+
+private:
+    std::unique_ptr<char[]> storage_;
+    size_t capacity_;
+};
+
+constexpr size_t PieceTable::MAX_ADD_PIECE;
+constexpr size_t PieceTable::ADD_BLOCK_SIZE;
+
+// ============================================================================
+// Node
+// ============================================================================
+
+PieceTable::Node::Node(const Piece& p, uint32_t prio, NodePtr l, NodePtr r)
+    : piece(p), priority(prio), left(std::move(l)), right(std::move(r)) {
+    length = piece.length;
+    newlines = piece.newlines;
+    pieces = 1;
+    if (left) {
+        length += left->length;
+        newlines += left->newlines;
+        pieces += left->pieces;
+    }
+    if (right) {
+        length += right->length;
+        newlines += right->newlines;
+        pieces += right->pieces;
+    }
+}
+
+// ============================================================================
+// Constructors
+// ============================================================================
+
+PieceTable::PieceTable() = default;
+
+PieceTable::PieceTable(std::string text) {
+    LineIndex index;
+    index.build(text.data(), text.size());
+    *this = PieceTable(std::move(text), std::move(index));
+}
+
+PieceTable::PieceTable(std::string text, LineIndex index) {
+    append(std::move(text), std::move(index));
+}
+
+PieceTable::PieceTable(const PieceTable& other)
+    : root_(other.root_), blocks_(other.blocks_), seed_(other.seed_) {
+    // addBlock_ stays empty: the source may keep appending to its block
+}
+
+PieceTable& PieceTable::operator=(const PieceTable& other) {
+    if (this != &other) {
+        root_ = other.root_;
+        blocks_ = other.blocks_;
+        seed_ = other.seed_;
+        addBlock_.reset();
+    }
+    return *this;
+}
+
+// ============================================================================
+// Queries
+// ============================================================================
+
+size_t PieceTable::size() const {
+    return root_ ? root_->length : 0;
+}
+
+size_t PieceTable::lineCount() const {
+    return (root_ ? root_->newlines : 0) + 1;
+}
+
+size_t PieceTable::pieceCount() const {
+    return root_ ? root_->pieces : 0;
+}
+
+size_t PieceTable::lineStart(size_t line) const {
+    if (line == 0) {
+        return 0;
+    }
+    if (line >= lineCount()) {
+        return size();
+    }
+    return findNewline(line) + 1;
+}
+
+size_t PieceTable::lineLength(size_t line) const {
+    if (line >= lineCount()) {
+        return 0;
+    }
+    size_t start = lineStart(line);
+    size_t end = (line + 1 < lineCount()) ? findNewline(line + 1) : size();
+    return end - start;
+}
+
+size_t PieceTable::lineOfOffset(size_t offset) const {
+    size_t line = 0;
+    const Node* node = root_.get();
+
+    while (node) {
+        size_t leftLength = node->left ? node->left->length : 0;
+        if (offset < leftLength) {
+            node = node->left.get();
+            continue;
+        }
+
+        line += node->left ? node->left->newlines : 0;
+        offset -= leftLength;
+        if (offset < node->piece.length) {
+            return line + node->piece.block->countNewlines(node->piece.start, offset);
+        }
+
+        line += node->piece.newlines;
+        offset -= node->piece.length;
+        node = node->right.get();
+    }
+
+    return line;
+}
+
+char PieceTable::charAt(size_t offset) const {
+    const Node* node = root_.get();
+
+    while (node) {
+        size_t leftLength = node->left ? node->left->length : 0;
+        if (offset < leftLength) {
+            node = node->left.get();
+        } else if (offset - leftLength < node->piece.length) {
+            return node->piece.block->data()[node->piece.start + offset - leftLength];
+        } else {
+            offset -= leftLength + node->piece.length;
+            node = node->right.get();
+        }
+    }
+
+    return '\0';
+}
+
+StringView PieceTable::lineView(size_t line, std::string& scratch) const {
+    if (line >= lineCount()) {
+        return StringView();
+    }
+
+    size_t start = lineStart(line);
+    size_t length = lineLength(line);
+    if (length == 0) {
+        return StringView();
+    }
+
+    // Fast path: the whole line lives inside one piece
+    const Node* node = root_.get();
+    size_t offset = start;
+    while (node) {
+        size_t leftLength = node->left ? node->left->length : 0;
+        if (offset < leftLength) {
+            node = node->left.get();
+        } else if (offset - leftLength < node->piece.length) {
+            size_t inPiece = offset - leftLength;
+            if (inPiece + length <= node->piece.length) {
+                return StringView(node->piece.block->data() + node->piece.start + inPiece, length);
+            }
+            break;
+        } else {
+            offset -= leftLength + node->piece.length;
+            node = node->right.get();
+        }
+    }
+
+    scratch.clear();
+    scratch.reserve(length);
+    forEachChunk(start, length, [&scratch](const char* data, size_t size) {
+        scratch.append(data, size);
+    });
+    return StringView(scratch);
+}
+
+std::string PieceTable::text(size_t offset, size_t length) const {
+    std::string result;
+    if (offset >= size()) {
+        return result;
+    }
+    length = std::min(length, size() - offset);
+    result.reserve(length);
+    forEachChunk(offset, length, [&result](const char* data, size_t size) {
+        result.append(data, size);
+    });
+    return result;
+}
+
+// ============================================================================
+// Editing
+// ============================================================================
+
+void PieceTable::insert(size_t offset, const char* text, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    offset = std::min(offset, size());
+
+    NodePtr left, right;
+    split(root_, offset, left, right);
+
+    while (length > 0) {
+        if (!addBlock_ || addBlock_->remaining() == 0) {
+            addBlock_ = std::make_shared<AddBlock>(std::max(ADD_BLOCK_SIZE, length));
+            blocks_.push_back(addBlock_);
+        }
+
+        size_t chunk = std::min(length, std::min(addBlock_->remaining(), MAX_ADD_PIECE));
+        size_t start = addBlock_->append(text, chunk);
+        size_t newlines = addBlock_->countNewlines(start, chunk);
+
+        // Typing at the tail of the add block just grows the previous piece
+        const Node* last = lastNode(left.get());
+        if (last && last->piece.block == addBlock_.get() &&
+            last->piece.start + last->piece.length == start &&
+            last->piece.length + chunk <= MAX_ADD_PIECE) {
+            left = appendToLast(left, chunk, newlines);
+        } else {
+            Piece piece;
+            piece.block = addBlock_.get();
+            piece.start = start;
+            piece.length = chunk;
+            piece.newlines = newlines;
+            left = merge(left, makeNode(piece, nextPriority(), nullptr, nullptr));
+        }
+
+        text += chunk;
+        length -= chunk;
+    }
+
+    root_ = merge(left, right);
+}
+
+void PieceTable::append(std::shared_ptr<const TextBlock> block, size_t start, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    size_t newlines = block->countNewlines(start, length);
+
+    // Consecutive ranges of one block (a file streaming in) stay one piece
+    const Node* last = lastNode(root_.get());
+    if (last && last->piece.block == block.get() &&
+        last->piece.start + last->piece.length == start) {
+        root_ = appendToLast(root_, length, newlines);
+        return;
+    }
+
+    Piece piece;
+    piece.block = block.get();
+    piece.start = start;
+    piece.length = length;
+    piece.newlines = newlines;
+
+    if (blocks_.empty() || blocks_.back() != block) {
+        blocks_.push_back(std::move(block));
+    }
+    root_ = merge(root_, makeNode(piece, nextPriority(), nullptr, nullptr));
+}
+
+void PieceTable::append(std::string text, LineIndex index) {
+    if (text.empty()) {
+        return;
+    }
+    auto block = std::make_shared<StringBlock>(std::move(text), std::move(index));
+    size_t length = block->size();
+    append(std::move(block), 0, length);
+}
+
+void PieceTable::erase(size_t offset, size_t length) {
+    if (offset >= size()) {
+        return;
+    }
+    length = std::min(length, size() - offset);
+    if (length == 0) {
+        return;
+    }
+
+    NodePtr left, rest, middle, right;
+    split(root_, offset, left, rest);
+    split(rest, length, middle, right);
+    root_ = merge(left, right);
+}
+
+// ============================================================================
+// Tree Helpers
+// ============================================================================
+
+uint32_t PieceTable::nextPriority() {
+    // xorshift32: deterministic, cheap, good enough for treap balance
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    return seed_;
+}
+
+PieceTable::NodePtr PieceTable::makeNode(const Piece& piece, uint32_t priority,
+                                         NodePtr left, NodePtr right) const {
+    return std::make_shared<Node>(piece, priority, std::move(left), std::move(right));
+}
+
+PieceTable::Piece PieceTable::slice(const Piece& piece, size_t from, size_t length) const {
+    Piece result;
+    result.block = piece.block;
+    result.start = piece.start + from;
+    result.length = length;
+
+    // Count whichever side of the cut is shorter
+    if (piece.block->isIndexed() || length <= piece.length / 2) {
+        result.newlines = piece.block->countNewlines(result.start, length);
+    } else {
+        result.newlines = piece.newlines
+            - piece.block->countNewlines(piece.start, from)
+            - piece.block->countNewlines(result.start + length, piece.length - from - length);
+    }
+    return result;
+}
+
+size_t PieceTable::nthNewline(const Piece& piece, size_t n) const {
+    return piece.block->nthNewline(piece.start, piece.length, n);
+}
+
+size_t PieceTable::findNewline(size_t n) const {
+    const Node* node = root_.get();
+    size_t base = 0;
+
+    while (node) {
+        size_t leftNewlines = node->left ? node->left->newlines : 0;
+        if (n <= leftNewlines) {
+            node = node->left.get();
+            continue;
+        }
+
+        n -= leftNewlines;
+        base += node->left ? node->left->length : 0;
+        if (n <= node->piece.newlines) {
+            return base + nthNewline(node->piece, n);
+        }
+
+        n -= node->piece.newlines;
+        base += node->piece.length;
+        node = node->right.get();
+    }
+
+    return size();
+}
+
+void PieceTable::split(const NodePtr& node, size_t offset, NodePtr& left, NodePtr& right) const {
+    if (!node) {
+        left.reset();
+        right.reset();
+        return;
+    }
+
+    size_t leftLength = node->left ? node->left->length : 0;
+    if (offset <= leftLength) {
+        NodePtr a, b;
+        split(node->left, offset, a, b);
+        left = a;
+        right = makeNode(node->piece, node->priority, b, node->right);
+    } else if (offset >= leftLength + node->piece.length) {
+        NodePtr a, b;
+        split(node->right, offset - leftLength - node->piece.length, a, b);
+        left = makeNode(node->piece, node->priority, node->left, a);
+        right = b;
+    } else {
+        size_t cut = offset - leftLength;
+        Piece head = slice(node->piece, 0, cut);
+        Piece tail = slice(node->piece, cut, node->piece.length - cut);
+        left = makeNode(head, node->priority, node->left, nullptr);
+        right = makeNode(tail, node->priority, nullptr, node->right);
+    }
+}
+
+PieceTable::NodePtr PieceTable::merge(const NodePtr& left, const NodePtr& right) const {
+    if (!left) return right;
+    if (!right) return left;
+
+    if (left->priority > right->priority) {
+        return makeNode(left->piece, left->priority, left->left, merge(left->right, right));
+    }
+    return makeNode(right->piece, right->priority, merge(left, right->left), right->right);
+}
+
+PieceTable::NodePtr PieceTable::appendToLast(const NodePtr& node, size_t extra, size_t newlines) const {
+    if (node->right) {
+        return makeNode(node->piece, node->priority, node->left,
+                        appendToLast(node->right, extra, newlines));
+    }
+    Piece piece = node->piece;
+    piece.length += extra;
+    piece.newlines += newlines;
+    return makeNode(piece, node->priority, node->left, nullptr);
+}
+
+const PieceTable::Node* PieceTable::lastNode(const Node* node) const {
+    while (node && node->right) {
+        node = node->right.get();
+    }
+    return node;
+}
+
+} // namespace astrax
@@ -0,0 +1,942 @@
+#include "astrax/regex.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace astrax {
+
+constexpr size_t Regex::MAX_PROGRAM;
+constexpr size_t Regex::MAX_REPEAT;
+constexpr size_t Regex::MAX_DFA_STATES;
+
+namespace {
+
+/// Upper bound of a {n,} quantifier
+constexpr size_t UNBOUNDED = static_cast<size_t>(-1);
+
+bool isWordByte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+bool isWordAt(const char* data, size_t size, size_t pos) {
+    return pos < size && isWordByte(static_cast<unsigned char>(data[pos]));
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// Compiler
+// ============================================================================
+
+/**
+ * @brief Parses a pattern and emits its Thompson NFA into a Regex
+ */
+class RegexCompiler {
+public:
+    RegexCompiler(const std::string& pattern, bool caseSensitive, Regex& regex)
+        : pattern_(pattern), caseSensitive_(caseSensitive), regex_(regex) {}
+    
+    bool compile(std::string& error);
+    
+private:
+    using ByteSet = Regex::ByteSet;
+    using Op = Regex::Op;
+    
+    enum class Kind { Empty, Set, Concat, Alternate, Repeat, Assert };
+    
+    struct Node {
+        Kind kind = Kind::Empty;
+        ByteSet set;                    // Set
+        int literal = -1;               // Set of one byte typed as such
+        uint32_t setIndex = UINT32_MAX; // Set, once emitted
+        Op assertion = Op::Match;       // Assert
+        std::vector<size_t> children;   // Concat, Alternate; Repeat has one
+        size_t min = 0;                 // Repeat
+        size_t max = 0;
+        bool greedy = true;
+    };
+    
+    const std::string& pattern_;
+    bool caseSensitive_;
+    Regex& regex_;
+    size_t pos_ = 0;
+    std::vector<Node> nodes_;
+    std::string error_;
+    
+    bool fail(const char* message) {
+        error_ = message;
+        return false;
+    }
+    
+    bool atEnd() const { return pos_ >= pattern_.size(); }
+    char peek() const { return pattern_[pos_]; }
+    
+    size_t addNode(Node node) {
+        nodes_.push_back(std::move(node));
+        return nodes_.size() - 1;
+    }
+    
+    size_t addLiteral(unsigned char c);
+    size_t addSet(ByteSet set);
+    void foldCase(ByteSet& set) const;
+    
+    bool parseAlternation(size_t& node);
+    bool parseConcat(size_t& node);
+    bool parseRepeat(size_t& node);
+    bool parseAtom(size_t& node);
+    bool parseQuantifier(size_t& min, size_t& max);
+    bool parseClass(size_t& node);
+    bool parseEscape(bool inClass, ByteSet& set, int& literal, Op& assertion);
+    
+    bool emit(size_t node);
+    uint32_t push(Op op, uint32_t x = 0, uint32_t y = 0);
+    uint32_t here() const { return static_cast<uint32_t>(regex_.program_.size()); }
+    std::string literalPrefix(size_t root) const;
+};
+
+bool RegexCompiler::compile(std::string& error) {
+    size_t root;
+    bool ok = parseAlternation(root);
+    if (ok && !atEnd()) {
+        ok = fail("unmatched )");
+    }
+    if (ok) {
+        ok = emit(root);
+    }
+    if (!ok) {
+        error = error_;
+        return false;
+    }
+    push(Op::Match);
+    regex_.finish(caseSensitive_, literalPrefix(root));
+    return true;
+}
+
+// ============================================================================
+// Parsing
+// ============================================================================
+
+size_t RegexCompiler::addLiteral(unsigned char c) {
+    Node node;
+    node.kind = Kind::Set;
+    node.set.add(c);
+    node.literal = c;
+    foldCase(node.set);
+    return addNode(std::move(node));
+}
+
+size_t RegexCompiler::addSet(ByteSet set) {
+    Node node;
+    node.kind = Kind::Set;
+    node.set = set;
+    return addNode(std::move(node));
+}
+
+void RegexCompiler::foldCase(ByteSet& set) const {
+    if (caseSensitive_) {
+        return;
+    }
+    for (int c = 'a'; c <= 'z'; ++c) {
+        unsigned char lower = static_cast<unsigned char>(c);
+        unsigned char upper = static_cast<unsigned char>(c - ('a' - 'A'));
+        if (set.has(lower) || set.has(upper)) {
+            set.add(lower);
+            set.add(upper);
+        }
+    }
+}
+
+bool RegexCompiler::parseAlternation(size_t& node) {
+    Node alternate;
+    alternate.kind = Kind::Alternate;
+    for (;;) {
+        size_t branch;
+        if (!parseConcat(branch)) {
+            return false;
+        }
+        alternate.children.push_back(branch);
+        if (atEnd() || peek() != '|') {
+            break;
+        }
+        ++pos_;
+    }
+    node = alternate.children.size() == 1 ? alternate.children[0] : addNode(std::move(alternate));
+    return true;
+}
+
+bool RegexCompiler::parseConcat(size_t& node) {
+    Node concat;
+    concat.kind = Kind::Concat;
+    while (!atEnd() && peek() != '|' && peek() != ')') {
+        size_t item;
+        if (!parseRepeat(item)) {
+            return false;
+        }
+        concat.children.push_back(item);
+    }
+    node = concat.children.size() == 1 ? concat.children[0] : addNode(std::move(concat));
+    return true;
+}
+
+bool RegexCompiler::parseRepeat(size_t& node) {
+    if (!parseAtom(node)) {
+        return false;
+    }
+    
+    size_t min, max;
+    if (!parseQuantifier(min, max)) {
+        return error_.empty();
+    }
+    if (nodes_[node].kind == Kind::Assert) {
+        return fail("nothing to repeat");
+    }
+    
+    Node repeat;
+    repeat.kind = Kind::Repeat;
+    repeat.children.push_back(node);
+    repeat.min = min;
+    repeat.max = max;
+    if (!atEnd() && peek() == '?') {
+        repeat.greedy = false;
+        ++pos_;
+    }
+    node = addNode(std::move(repeat));
+    return true;
+}
+
+bool RegexCompiler::parseQuantifier(size_t& min, size_t& max) {
+    if (atEnd()) {
+        return false;
+    }
+    switch (peek()) {
+        case '*': min = 0; max = UNBOUNDED; ++pos_; return true;
+        case '+': min = 1; max = UNBOUNDED; ++pos_; return true;
+        case '?': min = 0; max = 1; ++pos_; return true;
+        case '{': break;
+        default: return false;
+    }
+    
+    // {n}, {n,} or {n,m}; anything else leaves "{" a literal
+    size_t pos = pos_ + 1;
+    auto number = [&](size_t& value) {
+        size_t begin = pos;
+        value = 0;
+        while (pos < pattern_.size() && pattern_[pos] >= '0' && pattern_[pos] <= '9') {
+            value = std::min(value * 10 + static_cast<size_t>(pattern_[pos] - '0'), Regex::MAX_REPEAT + 1);
+            ++pos;
+        }
+        return pos > begin;
+    };
+    if (!number(min)) {
+        return false;
+    }
+    max = min;
+    if (pos < pattern_.size() && pattern_[pos] == ',') {
+        ++pos;
+        if (!number(max)) {
+            max = UNBOUNDED;
+        }
+    }
+    if (pos >= pattern_.size() || pattern_[pos] != '}') {
+        return false;
+    }
+    pos_ = pos + 1;
+    
+    if (min > Regex::MAX_REPEAT || (max != UNBOUNDED && max > Regex::MAX_REPEAT)) {
+        return fail("repeat count too large");
+    }
+    if (max < min) {
+        return fail("numbers out of order in {} quantifier");
+    }
+    return true;
+}
+
+bool RegexCompiler::parseAtom(size_t& node) {
+    char c = pattern_[pos_++];
+    switch (c) {
+        case '(': {
+            if (!atEnd() && peek() == '?') {
+                if (pos_ + 1 < pattern_.size() && pattern_[pos_ + 1] == ':') {
+                    pos_ += 2;
+                } else if (pos_ + 1 < pattern_.size() && std::strchr("=!<", pattern_[pos_ + 1])) {
+                    return fail("lookaround is not supported");
+                } else {
+                    return fail("invalid group");
+                }
+            }
+            if (!parseAlternation(node)) {
+                return false;
+            }
+            if (atEnd()) {
+                return fail("missing )");
+            }
+            ++pos_;
+            return true;
+        }
+        case '[':
+            return parseClass(node);
+        case '.': {
+            ByteSet any;
+            for (int b = 0; b < 256; ++b) {
+                if (b != '\n' && b != '\r') {
+                    any.add(static_cast<unsigned char>(b));
+                }
+            }
+            node = addSet(any);
+            return true;
+        }
+        case '^':
+        case '$': {
+            Node assertNode;
+            assertNode.kind = Kind::Assert;
+            assertNode.assertion = c == '^' ? Op::LineStart : Op::LineEnd;
+            node = addNode(std::move(assertNode));
+            return true;
+        }
+        case '\\': {
+            ByteSet set;
+            int literal = -1;
+            Op assertion = Op::Match;
+            if (!parseEscape(false, set, literal, assertion)) {
+                return false;
+            }
+            if (assertion != Op::Match) {
+                Node assertNode;
+                assertNode.kind = Kind::Assert;
+                assertNode.assertion = assertion;
+                node = addNode(std::move(assertNode));
+            } else if (literal >= 0) {
+                node = addLiteral(static_cast<unsigned char>(literal));
+            } else {
+                node = addSet(set);
+            }
+            return true;
+        }
+        case '*':
+        case '+':
+        case '?':
+            return fail("nothing to repeat");
+        case '{': {
+            size_t min, max;
+            --pos_;
+            if (parseQuantifier(min, max)) {
+                return fail("nothing to repeat");
+            }
+            if (!error_.empty()) {
+                return false;
+            }
+            ++pos_;
+            node = addLiteral('{');
+            return true;
+        }
+        default:
+            node = addLiteral(static_cast<unsigned char>(c));
+            return true;
+    }
+}
+
+bool RegexCompiler::parseClass(size_t& node) {
+    ByteSet set;
+    bool negate = !atEnd() && peek() == '^';
+    if (negate) {
+        ++pos_;
+    }
+    
+    // One member: a byte, or a set from an escape such as \d
+    auto member = [this](ByteSet& members, int& byte) {
+        char c = pattern_[pos_++];
+        if (c != '\\') {
+            byte = static_cast<unsigned char>(c);
+            return true;
+        }
+        Op assertion;
+        byte = -1;
+        return parseEscape(true, members, byte, assertion);
+    };
+    
+    for (;;) {
+        if (atEnd()) {
+            return fail("missing ]");
+        }
+        if (peek() == ']') {
+            ++pos_;
+            break;
+        }
+        
+        ByteSet members;
+        int low;
+        if (!member(members, low)) {
+            return false;
+        }
+        if (low < 0) {
+            for (int i = 0; i < 4; ++i) {
+                set.bits[i] |= members.bits[i];
+            }
+            continue;
+        }
+        
+        // A range, unless the '-' is last in the class
+        int high = low;
+        if (pos_ + 1 < pattern_.size() && peek() == '-' && pattern_[pos_ + 1] != ']') {
+            ++pos_;
+            if (!member(members, high)) {
+                return false;
+            }
+            if (high < 0) {
+                return fail("invalid range in character class");
+            }
+            if (high < low) {
+                return fail("range out of order in character class");
+            }
+        }
+        for (int b = low; b <= high; ++b) {
+            set.add(static_cast<unsigned char>(b));
+        }
+    }
+    
+    foldCase(set);
+    if (negate) {
+        for (uint64_t& bits : set.bits) {
+            bits = ~bits;
+        }
+    }
+    node = addSet(set);
+    return true;
+}
+
+bool RegexCompiler::parseEscape(bool inClass, ByteSet& set, int& literal, Op& assertion) {
+    if (atEnd()) {
+        return fail("trailing backslash");
+    }
+    char c = pattern_[pos_++];
+    
+    // Classes
+    ByteSet members;
+    switch (c) {
+        case 'd': case 'D':
+            for (int b = '0'; b <= '9'; ++b) members.add(static_cast<unsigned char>(b));
+            break;
+        case 'w': case 'W':
+            for (int b = 0; b < 256; ++b) {
+                if (isWordByte(static_cast<unsigned char>(b))) members.add(static_cast<unsigned char>(b));
+            }
+            break;
+        case 's': case 'S':
+            for (char b : {' ', '\t', '\n', '\r', '\f', '\v'}) members.add(static_cast<unsigned char>(b));
+            break;
+        default:
+            break;
+    }
+    if (std::strchr("dDwWsS", c) != nullptr) {
+        if (c >= 'A' && c <= 'Z') {
+            for (uint64_t& bits : members.bits) {
+                bits = ~bits;
+            }
+        }
+        set = members;
+        return true;
+    }
+    
+    // Assertions; \b in a class is a backspace
+    if ((c == 'b' || c == 'B') && !inClass) {
+        assertion = c == 'b' ? Op::WordBoundary : Op::NotWordBoundary;
+        return true;
+    }
+    
+    switch (c) {
+        case 'b': literal = '\b'; return true;
+        case 't': literal = '\t'; return true;
+        case 'n': literal = '\n'; return true;
+        case 'r': literal = '\r'; return true;
+        case 'f': literal = '\f'; return true;
+        case 'v': literal = '\v'; return true;
+        case '0':
+            if (!atEnd() && peek() >= '0' && peek() <= '9') {
+                return fail("invalid escape");
+            }
+            literal = 0;
+            return true;
+        case 'c':
+            if (atEnd() || !std::isalpha(static_cast<unsigned char>(peek()))) {
+                return fail("invalid escape");
+            }
+            literal = pattern_[pos_++] % 32;
+            return true;
+        case 'x':
+        case 'u': {
+            size_t digits = c == 'x' ? 2 : 4;
+            if (pattern_.size() - pos_ < digits) {
+                return fail("invalid escape");
+            }
+            int value = 0;
+            for (size_t i = 0; i < digits; ++i) {
+                int digit = hexValue(pattern_[pos_ + i]);
+                if (digit < 0) {
+                    return fail("invalid escape");
+                }
+                value = value * 16 + digit;
+            }
+            if (c == 'u' && value >= 0x80) {
+                return fail("only ASCII \\u escapes are supported");
+            }
+            pos_ += digits;
+            literal = value;
+            return true;
+        }
+        default:
+            break;
+    }
+    
+    if (c >= '1' && c <= '9') {
+        return fail("backreferences are not supported");
+    }
+    if (std::isalnum(static_cast<unsigned char>(c))) {
+        return fail("invalid escape");
+    }
+    literal = static_cast<unsigned char>(c);
+    return true;
+}
+
+// ============================================================================
+// Code Generation
+// ============================================================================
+
+uint32_t RegexCompiler::push(Op op, uint32_t x, uint32_t y) {
+    regex_.program_.push_back(Regex::Inst{op, x, y});
+    return here() - 1;
+}
+
+bool RegexCompiler::emit(size_t index) {
+    if (regex_.program_.size() > Regex::MAX_PROGRAM) {
+        return fail("pattern too large");
+    }
+    Node& node = nodes_[index];
+    std::vector<Regex::Inst>& program = regex_.program_;
+    
+    switch (node.kind) {
+        case Kind::Empty:
+            return true;
+        
+        case Kind::Set:
+            if (node.setIndex == UINT32_MAX) {
+                node.setIndex = static_cast<uint32_t>(regex_.sets_.size());
+                regex_.sets_.push_back(node.set);
+            }
+            push(Op::Byte, node.setIndex);
+            return true;
+        
+        case Kind::Assert:
+            push(node.assertion);
+            return true;
+        
+        case Kind::Concat:
+            for (size_t child : node.children) {
+                if (!emit(child)) {
+                    return false;
+                }
+            }
+            return true;
+        
+        case Kind::Alternate: {
+            // split L1, next; L1: a; jump end; next: split L2, ...
+            std::vector<uint32_t> jumps;
+            for (size_t i = 0; i < node.children.size(); ++i) {
+                uint32_t split = 0;
+                bool last = i + 1 == node.children.size();
+                if (!last) {
+                    split = push(Op::Split, here() + 1);
+                }
+                if (!emit(node.children[i])) {
+                    return false;
+                }
+                if (!last) {
+                    jumps.push_back(push(Op::Jump));
+                    program[split].y = here();
+                }
+            }
+            for (uint32_t jump : jumps) {
+                program[jump].x = here();
+            }
+            return true;
+        }
+        
+        case Kind::Repeat: {
+            size_t child = node.children[0];
+            size_t min = node.min;
+            size_t max = node.max;
+            bool greedy = node.greedy;
+            for (size_t i = 0; i < min; ++i) {
+                if (!emit(child)) {
+                    return false;
+                }
+            }
+            
+            // The split picks between another pass and leaving
+            auto order = [&program, greedy](uint32_t split, uint32_t body, uint32_t exit) {
+                program[split].x = greedy ? body : exit;
+                program[split].y = greedy ? exit : body;
+            };
+            
+            if (max == UNBOUNDED) {
+                uint32_t split = push(Op::Split);
+                if (!emit(child)) {
+                    return false;
+                }
+                push(Op::Jump, split);
+                order(split, split + 1, here());
+                return true;
+            }
+            
+            // Each optional pass may end the repeat: x{1,3} is x(x(x)?)?
+            std::vector<uint32_t> splits;
+            for (size_t i = min; i < max; ++i) {
+                splits.push_back(push(Op::Split));
+                if (!emit(child)) {
+                    return false;
+                }
+            }
+            for (uint32_t split : splits) {
+                order(split, split + 1, here());
+            }
+            return true;
+        }
+    }
+    return true;
+}
+
+std::string RegexCompiler::literalPrefix(size_t root) const {
+    const Node& node = nodes_[root];
+    std::string prefix;
+    if (node.kind == Kind::Set && node.literal >= 0) {
+        prefix += static_cast<char>(node.literal);
+    } else if (node.kind == Kind::Concat) {
+        for (size_t child : node.children) {
+            if (nodes_[child].kind != Kind::Set || nodes_[child].literal < 0) {
+                break;
+            }
+            prefix += static_cast<char>(nodes_[child].literal);
+        }
+    }
+    return prefix;
+}
+
+// ============================================================================
+// Compilation
+// ============================================================================
+
+bool Regex::compile(const std::string& pattern, bool caseSensitive, std::string& error) {
+    *this = Regex();
+    RegexCompiler compiler(pattern, caseSensitive, *this);
+    if (!compiler.compile(error)) {
+        *this = Regex();
+        return false;
+    }
+    return true;
+}
+
+void Regex::finish(bool caseSensitive, const std::string& prefix) {
+    prefix_ = LiteralSearcher(prefix, caseSensitive);
+    dfaUsable_ = std::none_of(program_.begin(), program_.end(), [](const Inst& inst) {
+        return inst.op == Op::WordBoundary || inst.op == Op::NotWordBoundary;
+    });
+    
+    // Split the byte classes by each set in turn
+    size_t classCount = 1;
+    for (const ByteSet& set : sets_) {
+        int renumbered[256][2];
+        std::fill(&renumbered[0][0], &renumbered[0][0] + 512, -1);
+        size_t count = 0;
+        for (int b = 0; b < 256; ++b) {
+            int& id = renumbered[classOf_[b]][set.has(static_cast<unsigned char>(b)) ? 1 : 0];
+            if (id < 0) {
+                id = static_cast<int>(count++);
+            }
+            classOf_[b] = static_cast<unsigned char>(id);
+        }
+        classCount = count;
+    }
+    classByte_.assign(classCount, 0);
+    for (int b = 255; b >= 0; --b) {
+        classByte_[classOf_[b]] = static_cast<unsigned char>(b);
+    }
+    
+    marks_.assign(program_.size() * 2, 0);
+}
+
+void Regex::nextGeneration() const {
+    if (++generation_ == 0) {
+        std::fill(marks_.begin(), marks_.end(), 0);
+        generation_ = 1;
+    }
+}
+
+// ============================================================================
+// Searching
+// ============================================================================
+
+bool Regex::search(const char* data, size_t size, size_t from, size_t& start, size_t& length) const {
+    if (program_.empty() || from > size) {
+        return false;
+    }
+    
+    // Every match starts with the prefix, so none starts before it does
+    if (!prefix_.empty()) {
+        from = prefix_.find(data, size, from);
+        if (from == LiteralSearcher::npos) {
+            return false;
+        }
+    }
+    
+    if (dfaUsable_ && dfaSearch(data, size, from) == DfaResult::NoMatch) {
+        return false;
+    }
+    return nfaSearch(data, size, from, start, length);
+}
+
+// ============================================================================
+// DFA
+// ============================================================================
+
+Regex::DfaResult Regex::dfaSearch(const char* data, size_t size, size_t from) const {
+    int32_t& start = dfaStart_[from == 0 ? 1 : 0];
+    if (start < 0) {
+        seeds_.assign(1, 0);
+        start = dfaState(from == 0);
+        if (start < 0) {
+            dfaReset();
+            return DfaResult::GaveUp;
+        }
+    }
+    
+    int32_t state = start;
+    const size_t classCount = classByte_.size();
+    for (size_t pos = from; pos < size; ++pos) {
+        if (dfaStates_[static_cast<size_t>(state)].matched) {
+            return DfaResult::Match;
+        }
+        unsigned char byteClass = classOf_[static_cast<unsigned char>(data[pos])];
+        int32_t& next = dfaNext_[static_cast<size_t>(state) * classCount + byteClass];
+        if (next >= 0) {
+            state = next;
+            continue;
+        }
+        int32_t built = dfaStep(state, byteClass);
+        if (built < 0) {
+            dfaReset();
+            return DfaResult::GaveUp;
+        }
+        dfaNext_[static_cast<size_t>(state) * classCount + byteClass] = built;
+        state = built;
+    }
+    
+    const DfaState& last = dfaStates_[static_cast<size_t>(state)];
+    return last.matched || last.matchedAtEnd ? DfaResult::Match : DfaResult::NoMatch;
+}
+
+int32_t Regex::dfaStep(int32_t state, unsigned char byteClass) const {
+    unsigned char byte = classByte_[byteClass];
+    seeds_.clear();
+    for (uint32_t pc : dfaStates_[static_cast<size_t>(state)].pcs) {
+        if (sets_[program_[pc].x].has(byte)) {
+            seeds_.push_back(pc + 1);
+        }
+    }
+    
+    // A match may also start after this byte
+    seeds_.push_back(0);
+    return dfaState(false);
+}
+
+int32_t Regex::dfaState(bool atTextStart) const {
+    // Follow every path from the seeds; a path through $ only counts if
+    // the text ends here, so it is tracked separately (pc * 2 + 1)
+    nextGeneration();
+    key_.clear();
+    bool matched = false;
+    bool matchedAtEnd = false;
+    stack_.clear();
+    for (uint32_t pc : seeds_) {
+        stack_.push_back(pc * 2);
+    }
+    
+    while (!stack_.empty()) {
+        uint32_t entry = stack_.back();
+        stack_.pop_back();
+        if (marks_[entry] == generation_) {
+            continue;
+        }
+        marks_[entry] = generation_;
+        uint32_t pc = entry / 2;
+        uint32_t pastEnd = entry & 1;
+        const Inst& inst = program_[pc];
+        
+        switch (inst.op) {
+            case Op::Byte:
+                if (!pastEnd) {
+                    key_.push_back(pc);
+                }
+                break;
+            case Op::Match:
+                (pastEnd ? matchedAtEnd : matched) = true;
+                break;
+            case Op::Jump:
+                stack_.push_back(inst.x * 2 + pastEnd);
+                break;
+            case Op::Split:
+                stack_.push_back(inst.x * 2 + pastEnd);
+                stack_.push_back(inst.y * 2 + pastEnd);
+                break;
+            case Op::LineStart:
+                if (atTextStart) {
+                    stack_.push_back((pc + 1) * 2 + pastEnd);
+                }
+                break;
+            case Op::LineEnd:
+                stack_.push_back((pc + 1) * 2 + 1);
+                break;
+            case Op::WordBoundary:
+            case Op::NotWordBoundary:
+                break;  // Never in a DFA-searched program
+        }
+    }
+    
+    // The flags are part of the key, past any pc
+    std::sort(key_.begin(), key_.end());
+    uint32_t end = static_cast<uint32_t>(program_.size());
+    if (matched) key_.push_back(end);
+    if (matchedAtEnd) key_.push_back(end + 1);
+    
+    auto found = dfaIndex_.find(key_);
+    if (found != dfaIndex_.end()) {
+        return found->second;
+    }
+    if (dfaStates_.size() >= MAX_DFA_STATES) {
+        return -1;
+    }
+    
+    int32_t index = static_cast<int32_t>(dfaStates_.size());
+    DfaState state;
+    state.matched = matched;
+    state.matchedAtEnd = matchedAtEnd;
+    state.pcs.assign(key_.begin(), key_.end() - (matched ? 1 : 0) - (matchedAtEnd ? 1 : 0));
+    dfaStates_.push_back(std::move(state));
+    dfaNext_.resize(dfaNext_.size() + classByte_.size(), -1);
+    dfaIndex_.emplace(key_, index);
+    return index;
+}
+
+void Regex::dfaReset() const {
+    dfaStates_.clear();
+    dfaNext_.clear();
+    dfaIndex_.clear();
+    dfaStart_[0] = dfaStart_[1] = -1;
+}
+
+// ============================================================================
+// NFA Simulation
+// ============================================================================
+
+void Regex::addThread(std::vector<Thread>& list, uint32_t pc, size_t start,
+                      const char* data, size_t size, size_t pos) const {
+    // Depth first, preferred branch first, so the list stays in priority
+    // order; a pc reached before is taken by a preferred thread already
+    stack_.clear();
+    stack_.push_back(pc);
+    while (!stack_.empty()) {
+        uint32_t current = stack_.back();
+        stack_.pop_back();
+        if (marks_[current] == generation_) {
+            continue;
+        }
+        marks_[current] = generation_;
+        const Inst& inst = program_[current];
+        
+        switch (inst.op) {
+            case Op::Byte:
+            case Op::Match:
+                list.push_back(Thread{current, start});
+                break;
+            case Op::Jump:
+                stack_.push_back(inst.x);
+                break;
+            case Op::Split:
+                stack_.push_back(inst.y);
+                stack_.push_back(inst.x);
+                break;
+            case Op::LineStart:
+                if (pos == 0) stack_.push_back(current + 1);
+                break;
+            case Op::LineEnd:
+                if (pos == size) stack_.push_back(current + 1);
+                break;
+            case Op::WordBoundary:
+            case Op::NotWordBoundary: {
+                bool boundary = (pos > 0 && isWordAt(data, size, pos - 1)) != isWordAt(data, size, pos);
+                if (boundary == (inst.op == Op::WordBoundary)) {
+                    stack_.push_back(current + 1);
+                }
+                break;
+            }
+        }
+    }
+}
+
+bool Regex::nfaSearch(const char* data, size_t size, size_t from, size_t& start, size_t& length) const {
+    bool matched = false;
+    threads_.clear();
+    nextGeneration();
+    
+    for (size_t pos = from;; ++pos) {
+        // A thread starting here ranks below every earlier one
+        if (!matched) {
+            if (threads_.empty() && !prefix_.empty()) {
+                size_t next = prefix_.find(data, size, pos);
+                if (next == LiteralSearcher::npos) {
+                    break;
+                }
+                if (next != pos) {
+                    pos = next;
+                    nextGeneration();
+                }
+            }
+            addThread(threads_, 0, pos, data, size, pos);
+        }
+        if (threads_.empty()) {
+            if (matched || pos >= size) {
+                break;
+            }
+            nextGeneration();
+            continue;
+        }
+        
+        nextGeneration();
+        nextThreads_.clear();
+        for (const Thread& thread : threads_) {
+            const Inst& inst = program_[thread.pc];
+            if (inst.op == Op::Match) {
+                // Threads after this one would only give less preferred matches
+                matched = true;
+                start = thread.start;
+                length = pos - thread.start;
+                break;
+            }
+            if (pos < size && sets_[inst.x].has(static_cast<unsigned char>(data[pos]))) {
+                addThread(nextThreads_, thread.pc + 1, thread.start, data, size, pos + 1);
+            }
+        }
+        threads_.swap(nextThreads_);
+        if (pos >= size) {
+            break;
+        }
+    }
+    return matched;
+}
+
+} // namespace astrax
@@ -1,10 +1,20 @@
 #include "astrax/renderer.h"
 #include <algorithm>
-#include <sstream>
-#include <iomanip>
+#include <utility>
 
 namespace astrax {
 
+namespace {
+
+/// Check if a row holds part of a multi-byte UTF-8 character
+bool hasMultiByte(const Cell* cells, int width) {
+    return std::any_of(cells, cells + width, [](const Cell& cell) {
+        return static_cast<unsigned char>(cell.ch) >= 0x80;
+    });
+}
+
+} // anonymous namespace
+
 // ============================================================================
 // Viewport
 // ============================================================================
@@ -31,6 +41,7 @@ void Viewport::ensureVisible(const Position& pos) {
 
 Renderer::Renderer(ITerminal& terminal) : terminal_(terminal) {
     updateViewportSize();
+    setTheme(Theme());
 }
 
 void Renderer::updateViewportSize() {
@@ -50,6 +61,46 @@ int Renderer::getLineNumberWidth(size_t totalLines) const {
 
 void Renderer::setHighlighter(std::unique_ptr<ISyntaxHighlighter> highlighter) {
     highlighter_ = std::move(highlighter);
+    highlights_.setHighlighter(highlighter_.get());
+    
+    // The worker lexes concurrently, so it needs a highlighter of its own
+    worker_.reset();
+    workerResult_.reset();
+    awaitingHighlights_ = false;
+    if (highlighter_) {
+        auto copy = HighlighterFactory::createForLanguage(highlighter_->getLanguage());
+        if (copy) {
+            worker_ = std::make_unique<HighlightWorker>(std::move(copy));
+        }
+    }
+}
+
+void Renderer::setTheme(const Theme& theme) {
+    auto pen = [](const ColorPair& color) { return Pen(color.foreground, color.background); };
+    
+    tokenPens_[static_cast<size_t>(TokenType::Default)] = pen(theme.normal);
+    tokenPens_[static_cast<size_t>(TokenType::Keyword)] = pen(theme.keyword);
+    tokenPens_[static_cast<size_t>(TokenType::Type)] = pen(theme.type);
+    tokenPens_[static_cast<size_t>(TokenType::String)] = pen(theme.string);
+    tokenPens_[static_cast<size_t>(TokenType::Number)] = pen(theme.number);
+    tokenPens_[static_cast<size_t>(TokenType::Comment)] = pen(theme.comment);
+    tokenPens_[static_cast<size_t>(TokenType::Preprocessor)] = pen(theme.preprocessor);
+    tokenPens_[static_cast<size_t>(TokenType::Function)] = pen(theme.function);
+    tokenPens_[static_cast<size_t>(TokenType::Operator)] = pen(theme.operator_);
+    tokenPens_[static_cast<size_t>(TokenType::Bracket)] = pen(getTokenColor(TokenType::Bracket));  // Not themed
+    
+    lineNumberPen_ = pen(theme.lineNumber);
+    statusBarPen_ = pen(theme.statusBar);
+    searchMatchPen_ = pen(theme.searchMatch);
+    searchCurrentPen_ = pen(theme.searchCurrent);
+    
+    // Mode indicators keep their fixed colors
+    const Color modeColors[5] = {Color::Blue, Color::Green, Color::Red, Color::Magenta, Color::Cyan};
+    for (size_t i = 0; i < 5; ++i) {
+        modePens_[i] = Pen(modeColors[i], Color::Default, Pen::BOLD);
+    }
+    
+    needsFullRedraw_ = true;
 }
 
 void Renderer::scrollToCursor(const Position& cursor) {
@@ -75,47 +126,77 @@ void Renderer::render(const Buffer& buffer, EditorMode mode) {
     // Ensure cursor is visible
     viewport_.ensureVisible(buffer.getCursor());
     
-    terminal_.hideCursor();
-    
-    // Clear screen on first render or when invalidated
-    if (needsFullRedraw_) {
-        terminal_.clearScreen();
+    if (back_.width() != viewport_.width || back_.height() != viewport_.height) {
+        back_.resize(viewport_.width, viewport_.height);
+        front_.resize(viewport_.width, viewport_.height);
+        needsFullRedraw_ = true;
     }
     
-    terminal_.setCursor(0, 0);
-    
+    // Compose the frame off-screen
+    highlights_.sync(buffer);
+    takeHighlights(buffer);
+    back_.clear();
     int editorHeight = viewport_.height - (showStatusBar_ ? 2 : 0);
+    size_t lexBudget = SYNC_LEX_LINES;
+    bool awaiting = false;
+    
+    cursor_ = buffer.getCursor();
+    bool showMatches = search_ && !search_->getPattern().empty() && search_->isPatternValid();
+    if (showMatches) {
+        matches_.prepare(buffer, *search_, viewport_.topLine,
+                         viewport_.topLine + static_cast<size_t>(std::max(editorHeight, 0)));
+    }
     
-    // Render each visible line
     for (int screenY = 0; screenY < editorHeight; ++screenY) {
         size_t lineIndex = viewport_.topLine + static_cast<size_t>(screenY);
         
         if (lineIndex < buffer.lineCount()) {
-            renderLine(lineIndex, buffer.getLine(lineIndex), screenY);
+            // Lines not lexed yet are drawn plain until the worker catches up
+            TokenSpan tokens;
+            if (!lineTokens(buffer, lineIndex, lexBudget, tokens)) {
+                awaiting = true;
+            }
+            MatchSpan matches = showMatches ? matches_.lineMatches(lineIndex) : MatchSpan();
+            renderLine(lineIndex, buffer.getLineView(lineIndex), tokens, matches, screenY);
         } else {
             // Empty line (tilde like vim)
-            terminal_.setCursor(0, screenY);
-            terminal_.setColor(Color::Blue, Color::Default);
-            terminal_.write("~");
-            terminal_.resetColor();
-            terminal_.clearToEndOfLine();
+            back_.put(0, screenY, "~", tildePen_);
         }
     }
     
-    // Render status bar
+    if (awaiting) {
+        worker_->request(buffer, viewport_.topLine, viewport_.topLine + static_cast<size_t>(editorHeight));
+    }
+    awaitingHighlights_ = awaiting;
+    
     if (showStatusBar_) {
         renderStatusBar(buffer, mode, editorHeight);
         
-        // Render command line
         if (mode == EditorMode::Command || mode == EditorMode::Search) {
-            renderCommandLine(editorHeight + 1);
+            renderCommandLine(mode, editorHeight + 1);
         } else {
-            terminal_.setCursor(0, editorHeight + 1);
-            terminal_.write(statusMessage_);
-            terminal_.clearToEndOfLine();
+            back_.put(0, editorHeight + 1, statusMessage_, Pen());
         }
     }
     
+    // Clear screen on first render or when invalidated; every cell then differs
+    painting_ = false;
+    if (needsFullRedraw_) {
+        beginPaint();
+        terminal_.resetColor();
+        terminal_.clearScreen();
+        front_.clear();
+    } else if (viewport_.topLine != frontTopLine_ && viewport_.leftColumn == frontLeftColumn_) {
+        scrollEditorArea(editorHeight);
+    }
+    
+    for (int screenY = 0; screenY < back_.height(); ++screenY) {
+        paintRow(screenY);
+    }
+    std::swap(front_, back_);
+    frontTopLine_ = viewport_.topLine;
+    frontLeftColumn_ = viewport_.leftColumn;
+    
     // Position cursor
     Position cursor = buffer.getCursor();
     int cursorScreenX = static_cast<int>(cursor.column - viewport_.leftColumn);
@@ -126,138 +207,270 @@ void Renderer::render(const Buffer& buffer, EditorMode mode) {
     }
     
     terminal_.setCursor(cursorScreenX, cursorScreenY);
-    terminal_.showCursor();
+    if (painting_) {
+        terminal_.showCursor();
+        terminal_.endSynchronizedUpdate();
+    }
+    
+    // The whole frame goes out in one write
+    terminal_.flush();
     
     needsFullRedraw_ = false;
 }
 
 void Renderer::refresh(const Buffer& buffer, EditorMode mode) {
-    // For now, just do a full render
-    // TODO: Implement incremental updates
+    // render() already sends only the cells that changed
     render(buffer, mode);
 }
 
-void Renderer::renderLine(size_t lineIndex, const std::string& content, int screenY) {
-    terminal_.setCursor(0, screenY);
+// ============================================================================
+// Frame Composition
+// ============================================================================
+
+void Renderer::renderLine(size_t lineIndex, StringView content, TokenSpan tokens, MatchSpan matches,
+                          int screenY) {
+    int x = 0;
     
     // Render line number
     if (showLineNumbers_) {
-        terminal_.setColor(lineNumberColor_.foreground, lineNumberColor_.background);
-        
-        std::ostringstream oss;
-        oss << std::setw(lineNumberWidth_) << (lineIndex + 1);
-        terminal_.write(oss.str());
-        
-        terminal_.setColor(Color::BrightBlack, Color::Default);
-        terminal_.write(" ");
-        terminal_.resetColor();
+        std::string number = std::to_string(lineIndex + 1);
+        if (static_cast<int>(number.size()) < lineNumberWidth_) {
+            number.insert(0, static_cast<size_t>(lineNumberWidth_) - number.size(), ' ');
+        }
+        x = back_.put(0, screenY, number, lineNumberPen_);
+        x += 1;  // Separator
     }
     
     // Calculate visible portion of line
     size_t startCol = viewport_.leftColumn;
-    size_t visibleWidth = static_cast<size_t>(viewport_.width - lineNumberWidth_ - 1);
+    size_t visibleWidth = static_cast<size_t>(std::max(viewport_.width - x, 0));
     
     if (startCol >= content.size()) {
-        terminal_.clearToEndOfLine();
         return;
     }
     
-    std::string visibleContent = content.substr(startCol, visibleWidth);
+    back_.put(x, screenY, content.substr(startCol, visibleWidth), Pen());
     
-    // Apply syntax highlighting if available
-    if (highlighter_) {
-        std::vector<Token> tokens = highlighter_->highlightLine(content, lineIndex);
-        
-        size_t pos = 0;
-        for (const auto& token : tokens) {
-            // Check if token is in visible range
-            if (token.start + token.length <= startCol) continue;
-            if (token.start >= startCol + visibleWidth) break;
-            
-            // Output any text before this token
-            while (pos < token.start && pos - startCol < visibleWidth) {
-                if (pos >= startCol) {
-                    terminal_.writeChar(content[pos]);
-                }
-                pos++;
-            }
-            
-            // Set token color
-            ColorPair color = getTokenColor(token.type);
-            terminal_.setColor(color.foreground, color.background);
-            
-            // Output token text
-            size_t tokenEnd = token.start + token.length;
-            while (pos < tokenEnd && pos - startCol < visibleWidth) {
-                if (pos >= startCol) {
-                    terminal_.writeChar(content[pos]);
-                }
-                pos++;
-            }
-            
-            terminal_.resetColor();
+    // Set the pen of [first, last) of the line, clipped to the visible part
+    size_t visibleEnd = startCol + visibleWidth;
+    auto paint = [&](size_t first, size_t last, const Pen& pen) {
+        first = std::max(first, startCol);
+        last = std::min(last, visibleEnd);
+        if (first < last) {
+            back_.paint(x + static_cast<int>(first - startCol), screenY, static_cast<int>(last - first), pen);
+        }
+    };
+    
+    // Matches may overlap; each overlay starts where the one before ended.
+    // The first match under the cursor is the current one.
+    overlays_.clear();
+    bool currentFound = false;
+    for (const LineMatch& match : matches) {
+        size_t start = overlays_.empty() ? match.column : std::max(match.column, overlays_.back().end);
+        size_t end = match.column + match.length;
+        if (start >= visibleEnd) {
+            break;
+        }
+        if (end <= start) {
+            continue;
         }
+        bool current = !currentFound && lineIndex == cursor_.line &&
+                       cursor_.column >= match.column && cursor_.column < end;
+        currentFound = currentFound || current;
+        overlays_.push_back(MatchOverlay{start, end, current ? &searchCurrentPen_ : &searchMatchPen_});
+    }
+    
+    // Color each visible cell once: tokens around the overlays, then the
+    // overlays themselves
+    size_t next = 0;
+    for (const auto& token : tokens) {
+        if (token.start >= visibleEnd) break;
         
-        // Output remaining text
-        while (pos < content.size() && pos - startCol < visibleWidth) {
-            if (pos >= startCol) {
-                terminal_.writeChar(content[pos]);
+        const Pen& pen = tokenPens_[static_cast<size_t>(token.type)];
+        size_t pos = std::max(token.start, startCol);
+        size_t tokenEnd = std::min(token.start + token.length, visibleEnd);
+        while (pos < tokenEnd) {
+            while (next < overlays_.size() && overlays_[next].end <= pos) {
+                ++next;
+            }
+            if (next == overlays_.size() || overlays_[next].start >= tokenEnd) {
+                paint(pos, tokenEnd, pen);
+                break;
             }
-            pos++;
+            paint(pos, overlays_[next].start, pen);
+            pos = overlays_[next].end;
         }
-    } else {
-        // No syntax highlighting, just output text
-        terminal_.write(visibleContent);
     }
-    
-    terminal_.clearToEndOfLine();
+    for (const MatchOverlay& overlay : overlays_) {
+        paint(overlay.start, overlay.end, *overlay.pen);
+    }
 }
 
-void Renderer::renderStatusBar(const Buffer& buffer, EditorMode mode, int screenY) {
-    terminal_.setCursor(0, screenY);
+void Renderer::takeHighlights(const Buffer& buffer) {
+    if (!worker_) {
+        return;
+    }
     
-    // Set status bar colors
-    ColorPair modeColor = getModeColor(mode);
-    terminal_.setColor(modeColor.foreground, Color::Default);
-    terminal_.setBold(true);
+    auto current = [&buffer](const HighlightResult& result) {
+        return result.bufferId == buffer.id() && result.changeCount == buffer.changeCount();
+    };
     
+    std::unique_ptr<HighlightResult> result = worker_->take();
+    if (result && current(*result)) {
+        // Same text as highlights_ follows, so its states carry over
+        highlights_.adopt(result->states);
+        workerResult_ = std::move(result);
+    } else if (workerResult_ && !current(*workerResult_)) {
+        workerResult_.reset();
+    }
+}
+
+bool Renderer::lineTokens(const Buffer& buffer, size_t line, size_t& budget, TokenSpan& tokens) {
+    if (!highlighter_) {
+        return true;
+    }
+    if (workerResult_ && workerResult_->covers(line)) {
+        tokens = workerResult_->lineTokens(line);
+        return true;
+    }
+    if (worker_ && !highlights_.advance(buffer.getTable(), line, budget)) {
+        return false;
+    }
+    tokens = highlights_.highlightLine(buffer, line);
+    return true;
+}
+
+void Renderer::renderStatusBar(const Buffer& buffer, EditorMode mode, int screenY) {
     // Mode indicator
     std::string modeStr = " " + std::string(modeToString(mode)) + " ";
-    terminal_.write(modeStr);
-    terminal_.setBold(false);
+    int x = back_.put(0, screenY, modeStr, getModePen(mode));
     
-    terminal_.setColor(statusBarColor_.foreground, statusBarColor_.background);
+    const Pen& barPen = statusBarPen_;
     
     // Filename
     std::string filename = buffer.getFilename().empty() ? "[No Name]" : buffer.getFilename();
     if (buffer.isModified()) {
         filename += " [+]";
     }
-    terminal_.write(" " + filename + " ");
+    x = back_.put(x, screenY, " " + filename + " ", barPen);
     
     // Position info
     Position cursor = buffer.getCursor();
-    std::ostringstream posInfo;
-    posInfo << "Ln " << (cursor.line + 1) << ", Col " << (cursor.column + 1);
-    posInfo << " (" << buffer.lineCount() << " lines)";
+    std::string posInfo = "Ln " + std::to_string(cursor.line + 1) + ", Col " + std::to_string(cursor.column + 1) +
+                          " (" + std::to_string(buffer.lineCount()) + " lines)";
+    if (!searchInfo_.empty()) {
+        posInfo = "[" + searchInfo_ + "]  " + posInfo;
+    }
     
     // Calculate padding
-    int usedWidth = static_cast<int>(modeStr.size() + filename.size() + 2 + posInfo.str().size());
+    int usedWidth = static_cast<int>(modeStr.size() + filename.size() + 2 + posInfo.size());
     int padding = viewport_.width - usedWidth;
     if (padding > 0) {
-        terminal_.write(std::string(static_cast<size_t>(padding), ' '));
+        x = back_.put(x, screenY, std::string(static_cast<size_t>(padding), ' '), barPen);
     }
     
-    terminal_.write(posInfo.str());
-    terminal_.resetColor();
+    back_.put(x, screenY, posInfo, barPen);
+}
+
+void Renderer::renderCommandLine(EditorMode mode, int screenY) {
+    const char* prompt = mode == EditorMode::Search ? "/" : ":";
+    back_.put(0, screenY, prompt + commandLine_, commandLinePen_);
+}
+
+// ============================================================================
+// Screen Updates
+// ============================================================================
+
+void Renderer::beginPaint() {
+    if (!painting_) {
+        terminal_.beginSynchronizedUpdate();
+        terminal_.hideCursor();
+        painting_ = true;
+    }
 }
 
-void Renderer::renderCommandLine(int screenY) {
-    terminal_.setCursor(0, screenY);
-    terminal_.setColor(Color::White, Color::Default);
-    terminal_.write(":" + commandLine_);
-    terminal_.clearToEndOfLine();
-    terminal_.resetColor();
+void Renderer::scrollEditorArea(int editorHeight) {
+    bool forward = viewport_.topLine > frontTopLine_;
+    size_t distance = forward ? viewport_.topLine - frontTopLine_ : frontTopLine_ - viewport_.topLine;
+    if (distance >= static_cast<size_t>(editorHeight)) {
+        return;  // Nothing on screen survives the jump
+    }
+    
+    // Lines scrolled in take the current background, so draw them blank first
+    int lines = forward ? static_cast<int>(distance) : -static_cast<int>(distance);
+    beginPaint();
+    terminal_.setPen(Pen());
+    if (terminal_.scrollRows(0, editorHeight - 1, lines)) {
+        front_.scroll(0, editorHeight - 1, lines);
+    }
+}
+
+void Renderer::paintRow(int screenY) {
+    const Cell* want = back_.row(screenY);
+    const Cell* have = front_.row(screenY);
+    const int width = back_.width();
+    const Cell blank;
+    
+    // Trailing blanks are left to a single clear-to-end-of-line
+    int end = width;
+    while (end > 0 && want[end - 1] == blank) {
+        --end;
+    }
+    
+    // Cells hold bytes, but a multi-byte UTF-8 character takes one terminal
+    // column, so past one the cells are no longer at their own column. Such
+    // rows, on screen or to be drawn, are rewritten whole from the left.
+    if (hasMultiByte(want, width) || hasMultiByte(have, width)) {
+        if (std::equal(want, want + width, have)) {
+            return;
+        }
+        beginPaint();
+        terminal_.setCursor(0, screenY);
+        for (int i = 0; i < end; ++i) {
+            terminal_.setPen(want[i].pen);
+            terminal_.writeChar(want[i].ch);
+        }
+        terminal_.setPen(blank.pen);
+        terminal_.clearToEndOfLine();
+        return;
+    }
+    
+    int x = 0;
+    while (x < end) {
+        if (want[x] == have[x]) {
+            ++x;
+            continue;
+        }
+        
+        // Rewriting a short unchanged gap is cheaper than moving past it
+        int runEnd = x + 1;
+        int gap = 0;
+        for (int i = x + 1; i < end; ++i) {
+            if (want[i] != have[i]) {
+                runEnd = i + 1;
+                gap = 0;
+            } else if (++gap > MAX_RUN_GAP) {
+                break;
+            }
+        }
+        
+        beginPaint();
+        terminal_.setCursor(x, screenY);
+        for (; x < runEnd; ++x) {
+            terminal_.setPen(want[x].pen);
+            terminal_.writeChar(want[x].ch);
+        }
+    }
+    
+    for (int i = end; i < width; ++i) {
+        if (have[i] != blank) {
+            beginPaint();
+            terminal_.setCursor(end, screenY);
+            terminal_.setPen(blank.pen);
+            terminal_.clearToEndOfLine();
+            break;
+        }
+    }
 }
 
 } // namespace astrax
@@ -0,0 +1,70 @@
+#include "astrax/screen_grid.h"
+#include <algorithm>
+
+namespace astrax {
+
+void ScreenGrid::resize(int width, int height) {
+    width_ = std::max(width, 0);
+    height_ = std::max(height, 0);
+    cells_.assign(static_cast<size_t>(width_) * static_cast<size_t>(height_), Cell());
+}
+
+void ScreenGrid::clear() {
+    std::fill(cells_.begin(), cells_.end(), Cell());
+}
+
+int ScreenGrid::put(int x, int y, StringView text, const Pen& pen) {
+    if (y < 0 || y >= height_) {
+        return x;
+    }
+    
+    Cell* cells = row(y);
+    for (char c : text) {
+        if (x >= width_) {
+            break;
+        }
+        if (x >= 0) {
+            // A cell holds one column; tabs and other controls would move the cursor
+            unsigned char uc = static_cast<unsigned char>(c);
+            cells[x].ch = uc == '\t' ? ' ' : (uc < 0x20 || uc == 0x7F ? '?' : c);
+            cells[x].pen = pen;
+        }
+        ++x;
+    }
+    return x;
+}
+
+void ScreenGrid::paint(int x, int y, int count, const Pen& pen) {
+    if (y < 0 || y >= height_) {
+        return;
+    }
+    
+    Cell* cells = row(y);
+    int end = std::min(x + count, width_);
+    for (x = std::max(x, 0); x < end; ++x) {
+        cells[x].pen = pen;
+    }
+}
+
+void ScreenGrid::scroll(int top, int bottom, int lines) {
+    top = std::max(top, 0);
+    bottom = std::min(bottom, height_ - 1);
+    if (top > bottom || lines == 0) {
+        return;
+    }
+    
+    const size_t rowSize = static_cast<size_t>(width_);
+    auto rowBegin = [&](int y) { return cells_.begin() + static_cast<std::ptrdiff_t>(static_cast<size_t>(y) * rowSize); };
+    int count = bottom - top + 1;
+    int shift = std::min(lines > 0 ? lines : -lines, count);
+    
+    if (lines > 0) {
+        std::copy(rowBegin(top + shift), rowBegin(bottom + 1), rowBegin(top));
+        std::fill(rowBegin(bottom + 1 - shift), rowBegin(bottom + 1), Cell());
+    } else {
+        std::copy_backward(rowBegin(top), rowBegin(bottom + 1 - shift), rowBegin(bottom + 1));
+        std::fill(rowBegin(top), rowBegin(top + shift), Cell());
+    }
+}
+
+} // namespace astrax
@@ -1,9 +1,116 @@
 #include "astrax/search.h"
+#include "astrax/thread_pool.h"
 #include <algorithm>
-#include <cctype>
+#include <atomic>
+#include <iterator>
 
 namespace astrax {
 
+constexpr size_t Search::PARALLEL_MIN_LINES;
+constexpr size_t Search::BLOCK_LINES;
+
+namespace {
+
+// ============================================================================
+// Scanning
+// ============================================================================
+
+/// Call fn(column, length) for each match in a line, in findAll order;
+/// regex is null for a literal search
+template <typename Fn>
+void forEachMatch(const LiteralSearcher& literal, const Regex* regex, StringView line, Fn&& fn) {
+    const char* data = line.data();
+    size_t size = line.size();
+    if (regex) {
+        // Resume after each match, or one past an empty one
+        size_t col, length;
+        for (size_t from = 0; regex->search(data, size, from, col, length);
+             from = length > 0 ? col + length : col + 1) {
+            fn(col, length);
+        }
+        return;
+    }
+    
+    // Overlapping matches count, so resume one past each
+    for (size_t col = literal.find(data, size); col != LiteralSearcher::npos;
+         col = literal.find(data, size, col + 1)) {
+        fn(col, literal.size());
+    }
+}
+
+/// Lines of a vector, viewed in place
+struct VectorLines {
+    const std::vector<std::string>& lines;
+    
+    size_t count() const { return lines.size(); }
+    
+    template <typename Fn>
+    void forEach(size_t first, size_t end, std::string&, Fn&& fn) const {
+        for (size_t line = first; line < end; ++line) {
+            fn(line, StringView(lines[line].data(), lines[line].size()));
+        }
+    }
+};
+
+/// Lines of a piece table, walked chunk by chunk
+struct TableLines {
+    const PieceTable& table;
+    
+    size_t count() const { return table.lineCount(); }
+    
+    template <typename Fn>
+    void forEach(size_t first, size_t end, std::string& scratch, Fn&& fn) const {
+        table.forEachLine(first, end, scratch, fn);
+    }
+};
+
+/// Check if a scan has been asked to stop
+bool cancelled(const CancelFlag* cancel) {
+    return cancel && cancel->load(std::memory_order_relaxed);
+}
+
+size_t blockCount(size_t lines) {
+    return (lines + Search::BLOCK_LINES - 1) / Search::BLOCK_LINES;
+}
+
+/// Call scan(block, regex, firstLine, endLine, scratch) for every block of
+/// lines. Enough lines are scanned in parallel, blocks going to whichever
+/// thread is free; each thread searches with its own copy of the regex, as
+/// a Regex caches state while searching. Once cancel is set, no further
+/// blocks are started.
+template <typename Scan>
+void scanBlocks(size_t lines, const Regex* regex, const CancelFlag* cancel, Scan&& scan) {
+    size_t blocks = blockCount(lines);
+    auto scanBlock = [&](size_t block, const Regex* own, std::string& scratch) {
+        size_t first = block * Search::BLOCK_LINES;
+        scan(block, own, first, std::min(first + Search::BLOCK_LINES, lines), scratch);
+    };
+    
+    if (lines < Search::PARALLEL_MIN_LINES) {
+        std::string scratch;
+        for (size_t block = 0; block < blocks && !cancelled(cancel); ++block) {
+            scanBlock(block, regex, scratch);
+        }
+        return;
+    }
+    
+    ThreadPool& pool = ThreadPool::shared();
+    std::atomic<size_t> next{0};
+    pool.run(pool.concurrency(), [&](size_t) {
+        Regex copy;
+        if (regex) {
+            copy = *regex;
+        }
+        std::string scratch;
+        for (size_t block = next.fetch_add(1); block < blocks && !cancelled(cancel);
+             block = next.fetch_add(1)) {
+            scanBlock(block, regex ? &copy : nullptr, scratch);
+        }
+    });
+}
+
+} // anonymous namespace
+
 // ============================================================================
 // Pattern Setting
 // ============================================================================
@@ -13,18 +120,10 @@ void Search::setPattern(const std::string& pattern, const SearchOptions& options
     options_ = options;
     patternValid_ = true;
     errorMessage_.clear();
+    literal_ = LiteralSearcher(pattern_, options_.caseSensitive);
     
     if (options_.useRegex) {
-        try {
-            std::regex_constants::syntax_option_type flags = std::regex::ECMAScript;
-            if (!options_.caseSensitive) {
-                flags |= std::regex::icase;
-            }
-            compiledRegex_ = std::regex(pattern_, flags);
-        } catch (const std::regex_error& e) {
-            patternValid_ = false;
-            errorMessage_ = e.what();
-        }
+        patternValid_ = regex_.compile(pattern_, options_.caseSensitive, errorMessage_);
     }
 }
 
@@ -36,193 +135,228 @@ size_t Search::patternLength() const {
     return pattern_.size();
 }
 
-bool Search::matchesAt(const std::string& line, size_t pos) const {
-    if (pos + pattern_.size() > line.size()) {
-        return false;
+bool Search::matchFrom(StringView line, size_t from, size_t& col, size_t& length) const {
+    if (options_.useRegex) {
+        return regex_.search(line.data(), line.size(), from, col, length);
     }
-    
-    if (options_.caseSensitive) {
-        return line.compare(pos, pattern_.size(), pattern_) == 0;
-    } else {
-        for (size_t i = 0; i < pattern_.size(); ++i) {
-            if (std::tolower(static_cast<unsigned char>(line[pos + i])) !=
-                std::tolower(static_cast<unsigned char>(pattern_[i]))) {
-                return false;
-            }
-        }
-        return true;
+    col = literal_.find(line.data(), line.size(), from);
+    length = pattern_.size();
+    return col != LiteralSearcher::npos;
+}
+
+size_t Search::findLastLiteral(StringView line, size_t maxColumn) const {
+    size_t last = LiteralSearcher::npos;
+    for (size_t col = literal_.find(line.data(), line.size());
+         col != LiteralSearcher::npos && col <= maxColumn;
+         col = literal_.find(line.data(), line.size(), col + 1)) {
+        last = col;
     }
+    return last;
 }
 
-SearchMatch Search::findNext(
-    const std::vector<std::string>& lines,
-    Position from
-) const {
-    if (pattern_.empty() || !patternValid_) {
+size_t Search::findLastRegex(StringView line, size_t maxColumn, size_t& length) const {
+    size_t last = LiteralSearcher::npos;
+    size_t col, matchLength;
+    for (size_t from = 0;
+         regex_.search(line.data(), line.size(), from, col, matchLength) && col <= maxColumn;
+         from = matchLength > 0 ? col + matchLength : col + 1) {
+        last = col;
+        length = matchLength;
+    }
+    return last;
+}
+
+template <typename Lines>
+SearchMatch Search::findNextIn(const Lines& lines, Position from, const CancelFlag* cancel) const {
+    size_t count = lines.count();
+    if (pattern_.empty() || !patternValid_ || count == 0) {
         return SearchMatch();
     }
     
-    // Start from current position
-    size_t startLine = from.line;
-    size_t startCol = from.column + 1;  // Start after current position
+    // Start after the current position; past the last line is its end
+    size_t startLine = std::min(from.line, count - 1);
+    size_t startCol = from.line < count ? from.column + 1 : LiteralSearcher::npos;
     
-    for (size_t lineIdx = startLine; lineIdx < lines.size(); ++lineIdx) {
-        const std::string& line = lines[lineIdx];
-        size_t searchStart = (lineIdx == startLine) ? startCol : 0;
-        
-        if (options_.useRegex) {
-            std::smatch match;
-            std::string searchStr = line.substr(searchStart);
-            if (std::regex_search(searchStr, match, compiledRegex_)) {
-                return SearchMatch(
-                    {lineIdx, searchStart + static_cast<size_t>(match.position())},
-                    static_cast<size_t>(match.length()),
-                    match.str()
-                );
+    // First match in [first, end), a block at a time so a cancel is seen
+    SearchMatch match;
+    std::string scratch;
+    auto scan = [&](size_t first, size_t end, bool wrapped) {
+        for (size_t block = first; block < end && !match; block += BLOCK_LINES) {
+            if (cancelled(cancel)) {
+                return;
             }
-        } else {
-            for (size_t col = searchStart; col + pattern_.size() <= line.size(); ++col) {
-                if (matchesAt(line, col)) {
-                    return SearchMatch(
-                        {lineIdx, col},
-                        pattern_.size(),
-                        line.substr(col, pattern_.size())
-                    );
+            size_t blockEnd = std::min(block + BLOCK_LINES, end);
+            lines.forEach(block, blockEnd, scratch, [&](size_t lineIdx, StringView line) {
+                if (match) {
+                    return;
                 }
-            }
-        }
-    }
-    
-    // Wrap around if enabled
-    if (options_.wrapAround) {
-        for (size_t lineIdx = 0; lineIdx <= startLine; ++lineIdx) {
-            const std::string& line = lines[lineIdx];
-            size_t maxCol = (lineIdx == startLine) ? startCol : line.size();
-            
-            if (options_.useRegex) {
-                std::smatch match;
-                if (std::regex_search(line, match, compiledRegex_)) {
-                    if (lineIdx < startLine || static_cast<size_t>(match.position()) < startCol) {
-                        return SearchMatch(
-                            {lineIdx, static_cast<size_t>(match.position())},
-                            static_cast<size_t>(match.length()),
-                            match.str()
-                        );
-                    }
+                size_t col, length;
+                bool found;
+                if (lineIdx != startLine) {
+                    found = matchFrom(line, 0, col, length);
+                } else if (!wrapped) {
+                    found = matchFrom(line, startCol, col, length);
+                } else {
+                    // Back on the start line, only matches before it count;
+                    // a literal match must also end by startCol
+                    found = matchFrom(line, 0, col, length) && col < startCol &&
+                            (options_.useRegex || col + length <= startCol);
                 }
-            } else {
-                for (size_t col = 0; col + pattern_.size() <= maxCol; ++col) {
-                    if (matchesAt(line, col)) {
-                        return SearchMatch(
-                            {lineIdx, col},
-                            pattern_.size(),
-                            line.substr(col, pattern_.size())
-                        );
-                    }
+                if (found) {
+                    match = SearchMatch({lineIdx, col}, length, std::string(line.data() + col, length));
                 }
-            }
+            });
         }
-    }
+    };
     
-    return SearchMatch();
+    scan(startLine, count, false);
+    if (!match && options_.wrapAround) {
+        scan(0, startLine + 1, true);
+    }
+    return cancelled(cancel) ? SearchMatch() : match;
 }
 
-SearchMatch Search::findPrevious(
-    const std::vector<std::string>& lines,
-    Position from
-) const {
-    if (pattern_.empty() || !patternValid_) {
+template <typename Lines>
+SearchMatch Search::findPreviousIn(const Lines& lines, Position from, const CancelFlag* cancel) const {
+    size_t count = lines.count();
+    if (pattern_.empty() || !patternValid_ || count == 0) {
         return SearchMatch();
     }
+    size_t startLine = std::min(from.line, count - 1);
     
-    // Search backwards
-    for (size_t lineOffset = 0; lineOffset <= from.line; ++lineOffset) {
-        size_t lineIdx = from.line - lineOffset;
-        const std::string& line = lines[lineIdx];
-        
-        size_t maxCol = (lineOffset == 0 && from.column > 0) ? from.column - 1 : line.size();
-        if (maxCol > line.size()) {
-            if (line.empty()) continue;
-            maxCol = line.size() - 1;
-        }
-        
-        // Search from end to start
-        for (size_t colOffset = 0; colOffset <= maxCol; ++colOffset) {
-            size_t col = maxCol - colOffset;
-            if (col + pattern_.size() <= line.size() && matchesAt(line, col)) {
-                return SearchMatch(
-                    {lineIdx, col},
-                    pattern_.size(),
-                    line.substr(col, pattern_.size())
-                );
+    // Last match in [first, end), a block at a time from the end
+    SearchMatch match;
+    std::string scratch;
+    auto scan = [&](size_t first, size_t end, bool wrapped) {
+        for (size_t blockEnd = end; blockEnd > first && !match;) {
+            if (cancelled(cancel)) {
+                return;
             }
-        }
-    }
-    
-    // Wrap around if enabled
-    if (options_.wrapAround) {
-        for (size_t lineOffset = 0; lineOffset < lines.size() - from.line; ++lineOffset) {
-            size_t lineIdx = lines.size() - 1 - lineOffset;
-            if (lineIdx <= from.line) break;
-            
-            const std::string& line = lines[lineIdx];
-            
-            for (size_t colOffset = 0; colOffset < line.size(); ++colOffset) {
-                size_t col = line.size() - 1 - colOffset;
-                if (col + pattern_.size() <= line.size() && matchesAt(line, col)) {
-                    return SearchMatch(
-                        {lineIdx, col},
-                        pattern_.size(),
-                        line.substr(col, pattern_.size())
-                    );
+            size_t block = blockEnd - std::min(BLOCK_LINES, blockEnd - first);
+            lines.forEach(block, blockEnd, scratch, [&](size_t lineIdx, StringView line) {
+                // Before the start column on the start line, unless at column 0
+                size_t maxCol = line.size();
+                if (lineIdx == startLine) {
+                    if (wrapped) {
+                        return;
+                    }
+                    if (from.line == startLine && from.column > 0) {
+                        maxCol = from.column - 1;
+                    }
                 }
-            }
+                size_t length = pattern_.size();
+                size_t col = options_.useRegex ? findLastRegex(line, maxCol, length)
+                                               : findLastLiteral(line, maxCol);
+                if (col != LiteralSearcher::npos) {
+                    match = SearchMatch({lineIdx, col}, length, std::string(line.data() + col, length));
+                }
+            });
+            blockEnd = block;
         }
-    }
+    };
     
-    return SearchMatch();
+    scan(0, startLine + 1, false);
+    if (!match && options_.wrapAround) {
+        scan(startLine, count, true);
+    }
+    return cancelled(cancel) ? SearchMatch() : match;
 }
 
-std::vector<SearchMatch> Search::findAll(const std::vector<std::string>& lines) const {
+template <typename Lines>
+std::vector<SearchMatch> Search::findAllIn(const Lines& lines) const {
     std::vector<SearchMatch> matches;
-    
     if (pattern_.empty() || !patternValid_) {
         return matches;
     }
     
-    for (size_t lineIdx = 0; lineIdx < lines.size(); ++lineIdx) {
-        const std::string& line = lines[lineIdx];
-        
-        if (options_.useRegex) {
-            std::sregex_iterator it(line.begin(), line.end(), compiledRegex_);
-            std::sregex_iterator end;
-            
-            while (it != end) {
-                matches.push_back(SearchMatch(
-                    {lineIdx, static_cast<size_t>(it->position())},
-                    static_cast<size_t>(it->length()),
-                    it->str()
-                ));
-                ++it;
-            }
-        } else {
-            for (size_t col = 0; col + pattern_.size() <= line.size(); ++col) {
-                if (matchesAt(line, col)) {
-                    matches.push_back(SearchMatch(
-                        {lineIdx, col},
-                        pattern_.size(),
-                        line.substr(col, pattern_.size())
-                    ));
-                }
-            }
-        }
-    }
+    // Each block fills its own list; they are joined in order
+    std::vector<std::vector<SearchMatch>> found(blockCount(lines.count()));
+    scanBlocks(lines.count(), activeRegex(), nullptr,
+               [&](size_t block, const Regex* regex, size_t first, size_t end, std::string& scratch) {
+        std::vector<SearchMatch>& blockMatches = found[block];
+        lines.forEach(first, end, scratch, [&](size_t lineIdx, StringView line) {
+            forEachMatch(literal_, regex, line, [&](size_t col, size_t length) {
+                blockMatches.push_back(SearchMatch(
+                    {lineIdx, col}, length, std::string(line.data() + col, length)));
+            });
+        });
+    });
     
+    size_t total = 0;
+    for (const auto& blockMatches : found) {
+        total += blockMatches.size();
+    }
+    matches.reserve(total);
+    for (auto& blockMatches : found) {
+        std::move(blockMatches.begin(), blockMatches.end(), std::back_inserter(matches));
+    }
     return matches;
 }
 
+template <typename Lines>
+size_t Search::countIn(const Lines& lines, const CancelFlag* cancel) const {
+    if (pattern_.empty() || !patternValid_) {
+        return 0;
+    }
+    
+    // Counted per block, so threads never write to shared counters
+    std::vector<size_t> counts(blockCount(lines.count()));
+    scanBlocks(lines.count(), activeRegex(), cancel,
+               [&](size_t block, const Regex* regex, size_t first, size_t end, std::string& scratch) {
+        size_t count = 0;
+        lines.forEach(first, end, scratch, [&](size_t, StringView line) {
+            forEachMatch(literal_, regex, line, [&count](size_t, size_t) { ++count; });
+        });
+        counts[block] = count;
+    });
+    
+    size_t total = 0;
+    for (size_t count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+SearchMatch Search::findNext(const std::vector<std::string>& lines, Position from) const {
+    return findNextIn(VectorLines{lines}, from, nullptr);
+}
+
+SearchMatch Search::findNext(const PieceTable& text, Position from, const CancelFlag* cancel) const {
+    return findNextIn(TableLines{text}, from, cancel);
+}
+
+SearchMatch Search::findPrevious(const std::vector<std::string>& lines, Position from) const {
+    return findPreviousIn(VectorLines{lines}, from, nullptr);
+}
+
+SearchMatch Search::findPrevious(const PieceTable& text, Position from,
+                                 const CancelFlag* cancel) const {
+    return findPreviousIn(TableLines{text}, from, cancel);
+}
+
+std::vector<SearchMatch> Search::findAll(const std::vector<std::string>& lines) const {
+    return findAllIn(VectorLines{lines});
+}
+
+std::vector<SearchMatch> Search::findAll(const PieceTable& text) const {
+    return findAllIn(TableLines{text});
+}
+
+void Search::matchLine(StringView line, std::vector<LineMatch>& matches) const {
+    if (pattern_.empty() || !patternValid_) {
+        return;
+    }
+    forEachMatch(literal_, activeRegex(), line, [&matches](size_t col, size_t length) {
+        matches.push_back(LineMatch{col, length});
+    });
+}
+
 size_t Search::countMatches(const std::vector<std::string>& lines) const {
-    return findAll(lines).size();
+    return countIn(VectorLines{lines}, nullptr);
+}
+
+size_t Search::countMatches(const PieceTable& text, const CancelFlag* cancel) const {
+    return countIn(TableLines{text}, cancel);
 }
 
 // ============================================================================
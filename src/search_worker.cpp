@@ -0,0 +1,150 @@
+#include "astrax/search_worker.h"
+
+namespace astrax {
+
+// ============================================================================
+// Lifetime
+// ============================================================================
+
+SearchWorker::~SearchWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        cancel_.store(true, std::memory_order_relaxed);
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+// ============================================================================
+// Handoff
+// ============================================================================
+
+uint64_t SearchWorker::start(const Buffer& buffer, const Search& search, Position from) {
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation = ++generation_;
+        
+        // Copying the table is O(1); the worker reads the snapshot only
+        job_.snapshot = buffer.getTable();
+        job_.search = search;
+        job_.from = from;
+        job_.generation = generation;
+        job_.bufferId = buffer.id();
+        job_.changeCount = buffer.changeCount();
+        hasJob_ = true;
+        cancel_.store(true, std::memory_order_relaxed);
+        
+        progress_ = SearchProgress();
+        progress_.generation = generation;
+        progress_.bufferId = job_.bufferId;
+        progress_.changeCount = job_.changeCount;
+        changed_ = true;
+        
+        if (!thread_.joinable()) {
+            thread_ = std::thread(&SearchWorker::run, this);
+        }
+    }
+    wake_.notify_one();
+    return generation;
+}
+
+void SearchWorker::cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    hasJob_ = false;
+    cancel_.store(true, std::memory_order_relaxed);
+    progress_ = SearchProgress();
+    changed_ = false;
+}
+
+bool SearchWorker::poll(SearchProgress& progress) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!changed_) {
+        return false;
+    }
+    progress = progress_;
+    changed_ = false;
+    return true;
+}
+
+bool SearchWorker::waitForMatch(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t generation = generation_;
+    if (progress_.generation != generation) {
+        return false;
+    }
+    return progressed_.wait_for(lock, timeout, [this, generation] {
+        return generation_ != generation || progress_.matchDone;
+    }) && generation_ == generation && progress_.generation == generation;
+}
+
+bool SearchWorker::busy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hasJob_ || working_ || changed_;
+}
+
+// ============================================================================
+// Worker Thread
+// ============================================================================
+
+void SearchWorker::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stop_ || hasJob_; });
+        if (stop_) {
+            return;
+        }
+        
+        Job job = std::move(job_);
+        hasJob_ = false;
+        working_ = true;
+        cancel_.store(false, std::memory_order_relaxed);
+        lock.unlock();
+        
+        work(job);
+        
+        lock.lock();
+        working_ = false;
+    }
+}
+
+template <typename Update>
+void SearchWorker::publish(uint64_t generation, Update&& update) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != generation_) {
+            return;
+        }
+        update(progress_);
+        changed_ = true;
+    }
+    progressed_.notify_all();
+}
+
+void SearchWorker::work(const Job& job) {
+    // The match first, as the cursor waits for it
+    SearchMatch match = job.search.findNext(job.snapshot, job.from, &cancel_);
+    if (cancel_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    publish(job.generation, [&](SearchProgress& progress) {
+        progress.matchDone = true;
+        progress.match = match;
+    });
+    
+    // Without a match there is nothing to count
+    size_t count = match ? job.search.countMatches(job.snapshot, &cancel_) : 0;
+    if (cancel_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    publish(job.generation, [&](SearchProgress& progress) {
+        progress.countDone = true;
+        progress.count = count;
+    });
+}
+
+} // namespace astrax
@@ -1,55 +1,63 @@
 #include "astrax/syntax/cpp_highlighter.h"
+#include "astrax/syntax/keyword_table.h"
 #include <cctype>
 
 namespace astrax {
 
 // ============================================================================
-// Constructor
+// Word Tables
 // ============================================================================
 
-CppHighlighter::CppHighlighter() {
-    initializeKeywords();
-}
+namespace {
 
-void CppHighlighter::initializeKeywords() {
-    // C++ keywords
-    keywords_ = {
-        "alignas", "alignof", "and", "and_eq", "asm", "auto",
-        "bitand", "bitor", "break", "case", "catch", "class",
-        "compl", "concept", "const", "consteval", "constexpr", "constinit",
-        "const_cast", "continue", "co_await", "co_return", "co_yield",
-        "decltype", "default", "delete", "do", "dynamic_cast",
-        "else", "enum", "explicit", "export", "extern",
-        "false", "for", "friend", "goto", "if", "inline",
-        "mutable", "namespace", "new", "noexcept", "not", "not_eq",
-        "nullptr", "operator", "or", "or_eq", "private", "protected",
-        "public", "register", "reinterpret_cast", "requires", "return",
-        "sizeof", "static", "static_assert", "static_cast", "struct",
-        "switch", "template", "this", "thread_local", "throw",
-        "true", "try", "typedef", "typeid", "typename",
-        "union", "using", "virtual", "volatile", "while",
-        "xor", "xor_eq", "override", "final"
-    };
-    
-    // Types
-    types_ = {
-        "void", "bool", "char", "wchar_t", "char8_t", "char16_t", "char32_t",
-        "short", "int", "long", "signed", "unsigned", "float", "double",
-        "size_t", "int8_t", "int16_t", "int32_t", "int64_t",
-        "uint8_t", "uint16_t", "uint32_t", "uint64_t",
-        "ptrdiff_t", "intptr_t", "uintptr_t",
-        "string", "vector", "map", "unordered_map", "set", "unordered_set",
-        "array", "list", "deque", "queue", "stack", "pair", "tuple",
-        "unique_ptr", "shared_ptr", "weak_ptr", "optional", "variant",
-        "string_view", "span", "any", "function"
-    };
-    
-    // Preprocessor directives
-    preprocessor_ = {
-        "#include", "#define", "#undef", "#if", "#ifdef", "#ifndef",
-        "#else", "#elif", "#endif", "#pragma", "#error", "#warning", "#line"
-    };
-}
+// C++ keywords
+constexpr const char* KEYWORD_LIST[] = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto",
+    "bitand", "bitor", "break", "case", "catch", "class",
+    "compl", "concept", "const", "consteval", "constexpr", "constinit",
+    "const_cast", "continue", "co_await", "co_return", "co_yield",
+    "decltype", "default", "delete", "do", "dynamic_cast",
+    "else", "enum", "explicit", "export", "extern",
+    "false", "for", "friend", "goto", "if", "inline",
+    "mutable", "namespace", "new", "noexcept", "not", "not_eq",
+    "nullptr", "operator", "or", "or_eq", "private", "protected",
+    "public", "register", "reinterpret_cast", "requires", "return",
+    "sizeof", "static", "static_assert", "static_cast", "struct",
+    "switch", "template", "this", "thread_local", "throw",
+    "true", "try", "typedef", "typeid", "typename",
+    "union", "using", "virtual", "volatile", "while",
+    "xor", "xor_eq", "override", "final"
+};
+
+// Types
+constexpr const char* TYPE_LIST[] = {
+    "void", "bool", "char", "wchar_t", "char8_t", "char16_t", "char32_t",
+    "short", "int", "long", "signed", "unsigned", "float", "double",
+    "size_t", "int8_t", "int16_t", "int32_t", "int64_t",
+    "uint8_t", "uint16_t", "uint32_t", "uint64_t",
+    "ptrdiff_t", "intptr_t", "uintptr_t",
+    "string", "vector", "map", "unordered_map", "set", "unordered_set",
+    "array", "list", "deque", "queue", "stack", "pair", "tuple",
+    "unique_ptr", "shared_ptr", "weak_ptr", "optional", "variant",
+    "string_view", "span", "any", "function"
+};
+
+// Preprocessor directives, without the '#'
+constexpr const char* DIRECTIVE_LIST[] = {
+    "include", "define", "undef", "if", "ifdef", "ifndef",
+    "else", "elif", "endif", "pragma", "error", "warning", "line"
+};
+
+// Seeds found by trying until every word had a slot of its own
+constexpr KeywordTable<512> KEYWORDS(KEYWORD_LIST, 324);
+constexpr KeywordTable<256> TYPES(TYPE_LIST, 85);
+constexpr KeywordTable<32> DIRECTIVES(DIRECTIVE_LIST, 9);
+
+static_assert(KEYWORDS.perfect(), "keyword collision: change the seed");
+static_assert(TYPES.perfect(), "type collision: change the seed");
+static_assert(DIRECTIVES.perfect(), "directive collision: change the seed");
+
+} // anonymous namespace
 
 // ============================================================================
 // State Management
@@ -240,11 +248,16 @@ size_t CppHighlighter::skipPreprocessor(const std::string& line, size_t start, s
     }
     
     // Read directive name
-    size_t wordStart = pos;
+    size_t nameStart = pos;
     while (pos < line.size() && (std::isalnum(static_cast<unsigned char>(line[pos])) || line[pos] == '_')) {
         pos++;
     }
     
+    // Anything else is # or ## inside a macro, not a directive
+    if (!isDirective(StringView(line.data() + nameStart, pos - nameStart))) {
+        return start + 1;
+    }
+    
     tokens.push_back({start, pos - start, TokenType::Preprocessor});
     return pos;
 }
@@ -256,7 +269,7 @@ size_t CppHighlighter::skipWord(const std::string& line, size_t start, std::vect
         pos++;
     }
     
-    std::string word = line.substr(start, pos - start);
+    StringView word(line.data() + start, pos - start);
     
     TokenType type = TokenType::Default;
     if (isKeyword(word)) {
@@ -332,12 +345,16 @@ size_t CppHighlighter::skipNumber(const std::string& line, size_t start, std::ve
     return pos;
 }
 
-bool CppHighlighter::isKeyword(const std::string& word) const {
-    return keywords_.find(word) != keywords_.end();
+bool CppHighlighter::isKeyword(StringView word) {
+    return KEYWORDS.contains(word);
+}
+
+bool CppHighlighter::isType(StringView word) {
+    return TYPES.contains(word);
 }
 
-bool CppHighlighter::isType(const std::string& word) const {
-    return types_.find(word) != types_.end();
+bool CppHighlighter::isDirective(StringView name) {
+    return DIRECTIVES.contains(name);
 }
 
 bool CppHighlighter::isNumber(const std::string& word) const {
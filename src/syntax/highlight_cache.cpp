@@ -0,0 +1,166 @@
+#include "astrax/syntax/highlight_cache.h"
+#include <algorithm>
+
+namespace astrax {
+
+HighlightCache::HighlightCache() {
+    clear();
+}
+
+void HighlightCache::setHighlighter(ISyntaxHighlighter* highlighter) {
+    highlighter_ = highlighter;
+    tokens_.clear();
+    clear();
+}
+
+void HighlightCache::clear() {
+    // Every file starts in the initial state
+    states_.assign(1, 0);
+    valid_ = 1;
+    dirtyEnd_ = 0;
+}
+
+// ============================================================================
+// Invalidation
+// ============================================================================
+
+void HighlightCache::sync(const Buffer& buffer) {
+    if (buffer.id() != bufferId_ || !buffer.changesSince(changeCount_, changes_)) {
+        clear();
+    } else {
+        apply(changes_);
+    }
+    bufferId_ = buffer.id();
+    changeCount_ = buffer.changeCount();
+}
+
+void HighlightCache::apply(const std::vector<LineChange>& changes) {
+    for (const auto& change : changes) {
+        applyChange(change);
+    }
+}
+
+void HighlightCache::applyChange(const LineChange& change) {
+    // The start of the line after the first edited one is the first state
+    // the edit can change
+    size_t first = change.line + 1;
+    size_t known = states_.size();
+    if (first >= known) {
+        return;
+    }
+    
+    if (first + change.removedLines > known) {
+        // Removed lines reach past the cached states; keep what comes before
+        states_.resize(first);
+        valid_ = std::min(valid_, first);
+        return;
+    }
+    
+    // Shift the states below the edit to their new lines
+    auto at = states_.begin() + static_cast<std::ptrdiff_t>(first);
+    states_.erase(at, at + static_cast<std::ptrdiff_t>(change.removedLines));
+    states_.insert(states_.begin() + static_cast<std::ptrdiff_t>(first), change.insertedLines, 0);
+    
+    // Line starts before the line after the last inserted one need lexing
+    size_t dirtyEnd = first + change.insertedLines;
+    if (valid_ < known) {
+        // Earlier edits still pending: keep their region too, shifted
+        size_t previous = dirtyEnd_;
+        if (previous >= first + change.removedLines) {
+            previous = previous - change.removedLines + change.insertedLines;
+        }
+        dirtyEnd = std::max(dirtyEnd, previous);
+    }
+    dirtyEnd_ = dirtyEnd;
+    valid_ = std::min(valid_, first);
+}
+
+// ============================================================================
+// Lexing
+// ============================================================================
+
+HighlightState HighlightCache::stateAt(const PieceTable& text, size_t line) {
+    if (!highlighter_) {
+        return 0;
+    }
+    line = std::min(line, text.lineCount() - 1);
+    size_t budget = static_cast<size_t>(-1);
+    advance(text, line, budget);
+    return states_[line];
+}
+
+bool HighlightCache::advance(const PieceTable& text, size_t line, size_t& budget) {
+    if (!highlighter_) {
+        return true;
+    }
+    line = std::min(line, text.lineCount() - 1);
+    
+    while (valid_ <= line) {
+        if (budget == 0) {
+            return false;
+        }
+        --budget;
+        
+        size_t previous = valid_ - 1;
+        highlighter_->setState(states_[previous]);
+        highlighter_->updateState(lineText(text, previous), previous);
+        HighlightState state = highlighter_->getState();
+        
+        if (valid_ < states_.size()) {
+            if (valid_ >= dirtyEnd_ && states_[valid_] == state) {
+                // Lexing converged with the old states; the rest still hold
+                valid_ = states_.size();
+                continue;
+            }
+            states_[valid_] = state;
+        } else {
+            states_.push_back(state);
+        }
+        ++valid_;
+    }
+    return true;
+}
+
+TokenSpan HighlightCache::highlightLine(const PieceTable& text, size_t line) {
+    if (!highlighter_) {
+        return TokenSpan();
+    }
+    
+    HighlightState state = stateAt(text, line);
+    StringView view = text.lineView(line, lineScratch_);
+    uint64_t hash = TokenCache::hashLine(view);
+    
+    TokenSpan cached;
+    if (tokens_.find(state, hash, view.size(), cached)) {
+        return cached;
+    }
+    
+    highlighter_->setState(state);
+    lexed_ = highlighter_->highlightLine(lineText(text, line), line);
+    return tokens_.insert(state, hash, view.size(), lexed_);
+}
+
+const std::string& HighlightCache::lineText(const PieceTable& text, size_t line) {
+    StringView view = text.lineView(line, lineScratch_);
+    line_.assign(view.data(), view.size());
+    return line_;
+}
+
+// ============================================================================
+// Sharing
+// ============================================================================
+
+void HighlightCache::copyStates(std::vector<HighlightState>& states) const {
+    states.assign(states_.begin(), states_.begin() + static_cast<std::ptrdiff_t>(valid_));
+}
+
+void HighlightCache::adopt(std::vector<HighlightState>& states) {
+    if (states.size() <= valid_) {
+        return;
+    }
+    states_.swap(states);
+    valid_ = states_.size();
+    dirtyEnd_ = 0;
+}
+
+} // namespace astrax
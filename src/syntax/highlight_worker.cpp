@@ -0,0 +1,146 @@
+#include "astrax/syntax/highlight_worker.h"
+#include <algorithm>
+
+namespace astrax {
+
+constexpr size_t HighlightWorker::AHEAD_LINES;
+constexpr size_t HighlightWorker::CHUNK_LINES;
+
+// ============================================================================
+// Lifetime
+// ============================================================================
+
+HighlightWorker::HighlightWorker(std::unique_ptr<ISyntaxHighlighter> highlighter)
+    : highlighter_(std::move(highlighter)) {
+    cache_.setHighlighter(highlighter_.get());
+}
+
+HighlightWorker::~HighlightWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        interrupt_.store(true, std::memory_order_relaxed);
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    delete published_.load(std::memory_order_acquire);
+}
+
+// ============================================================================
+// Handoff
+// ============================================================================
+
+void HighlightWorker::request(const Buffer& buffer, size_t firstLine, size_t lastLine) {
+    uint64_t id = buffer.id();
+    uint64_t count = buffer.changeCount();
+    if (id == requestedId_ && count == requestedCount_ &&
+        firstLine == requestedFirst_ && lastLine == requestedLast_) {
+        return;
+    }
+    bool restart = id != requestedId_ || !buffer.changesSince(requestedCount_, changes_);
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!hasJob_) {
+            job_.restart = false;
+            job_.changes.clear();
+        }
+        
+        // Changes accumulate until the worker takes the job
+        if (restart) {
+            job_.restart = true;
+            job_.changes.clear();
+        } else if (!job_.restart) {
+            job_.changes.insert(job_.changes.end(), changes_.begin(), changes_.end());
+        }
+        
+        // Copying the table is O(1); the worker reads the snapshot only
+        job_.snapshot = buffer.getTable();
+        job_.bufferId = id;
+        job_.changeCount = count;
+        job_.firstLine = firstLine;
+        job_.lastLine = lastLine;
+        hasJob_ = true;
+        interrupt_.store(true, std::memory_order_relaxed);
+        
+        if (!thread_.joinable()) {
+            thread_ = std::thread(&HighlightWorker::run, this);
+        }
+    }
+    wake_.notify_one();
+    
+    requestedId_ = id;
+    requestedCount_ = count;
+    requestedFirst_ = firstLine;
+    requestedLast_ = lastLine;
+}
+
+std::unique_ptr<HighlightResult> HighlightWorker::take() {
+    return std::unique_ptr<HighlightResult>(published_.exchange(nullptr, std::memory_order_acquire));
+}
+
+// ============================================================================
+// Worker Thread
+// ============================================================================
+
+void HighlightWorker::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stop_ || hasJob_; });
+        if (stop_) {
+            return;
+        }
+        
+        Job job = std::move(job_);
+        hasJob_ = false;
+        interrupt_.store(false, std::memory_order_relaxed);
+        lock.unlock();
+        
+        work(job);
+        
+        lock.lock();
+    }
+}
+
+void HighlightWorker::work(Job& job) {
+    if (job.restart) {
+        cache_.clear();
+    } else {
+        cache_.apply(job.changes);
+    }
+    
+    // States first, checking now and then for a newer job; what was lexed
+    // so far stays valid for it, since its changes follow this snapshot
+    size_t end = std::min(job.lastLine + AHEAD_LINES, job.snapshot.lineCount());
+    size_t first = std::min(job.firstLine, end);
+    for (;;) {
+        size_t budget = CHUNK_LINES;
+        if (end == 0 || cache_.advance(job.snapshot, end - 1, budget)) {
+            break;
+        }
+        if (interrupt_.load(std::memory_order_relaxed)) {
+            return;
+        }
+    }
+    
+    auto result = std::make_unique<HighlightResult>();
+    result->bufferId = job.bufferId;
+    result->changeCount = job.changeCount;
+    cache_.copyStates(result->states);
+    result->firstLine = first;
+    
+    result->tokenStarts.reserve(end - first + 1);
+    for (size_t line = first; line < end; ++line) {
+        TokenSpan tokens = cache_.highlightLine(job.snapshot, line);
+        result->tokenStarts.push_back(result->tokens.size());
+        result->tokens.insert(result->tokens.end(), tokens.begin(), tokens.end());
+    }
+    result->tokenStarts.push_back(result->tokens.size());
+    
+    // An untaken older result is superseded
+    delete published_.exchange(result.release(), std::memory_order_acq_rel);
+}
+
+} // namespace astrax
@@ -0,0 +1,88 @@
+#include "astrax/syntax/token_cache.h"
+#include <algorithm>
+#include <cstring>
+
+namespace astrax {
+
+constexpr size_t TokenCache::MAX_LINES;
+constexpr size_t TokenCache::MAX_TOKENS;
+constexpr size_t TokenCache::SLOTS;
+
+TokenCache::TokenCache() : slots_(SLOTS) {
+    arena_.reserve(MAX_TOKENS);  // Never reallocates, so spans stay put
+}
+
+uint64_t TokenCache::hashLine(StringView text) {
+    // Eight bytes per step; the last partial word is zero-padded
+    const uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = text.size() * MULTIPLIER;
+    const char* data = text.data();
+    size_t remaining = text.size();
+    
+    while (remaining > 0) {
+        uint64_t word = 0;
+        size_t count = remaining < sizeof(word) ? remaining : sizeof(word);
+        std::memcpy(&word, data, count);
+        hash = (hash ^ word) * MULTIPLIER;
+        hash ^= hash >> 29;
+        data += count;
+        remaining -= count;
+    }
+    return hash;
+}
+
+size_t TokenCache::slotFor(HighlightState state, uint64_t hash) const {
+    uint64_t mixed = hash ^ (static_cast<uint64_t>(state) * 0xC2B2AE3D27D4EB4Full);
+    return static_cast<size_t>(mixed >> 32) & (SLOTS - 1);
+}
+
+bool TokenCache::find(HighlightState state, uint64_t hash, size_t length, TokenSpan& tokens) const {
+    for (size_t slot = slotFor(state, hash);; slot = (slot + 1) & (SLOTS - 1)) {
+        const Entry& entry = slots_[slot];
+        if (!entry.used) {
+            return false;
+        }
+        if (entry.hash == hash && entry.length == length && entry.state == state) {
+            tokens.tokens = arena_.data() + entry.first;
+            tokens.count = entry.count;
+            return true;
+        }
+    }
+}
+
+TokenSpan TokenCache::insert(HighlightState state, uint64_t hash, size_t length, const std::vector<Token>& tokens) {
+    if (tokens.size() > MAX_TOKENS) {
+        overflow_ = tokens;
+        return TokenSpan{overflow_.data(), overflow_.size()};
+    }
+    if (size_ >= MAX_LINES || arena_.size() + tokens.size() > MAX_TOKENS) {
+        clear();  // Lines on screen are simply lexed again
+    }
+    
+    size_t slot = slotFor(state, hash);
+    while (slots_[slot].used) {
+        slot = (slot + 1) & (SLOTS - 1);
+    }
+    
+    Entry& entry = slots_[slot];
+    entry.hash = hash;
+    entry.length = length;
+    entry.state = state;
+    entry.first = static_cast<uint32_t>(arena_.size());
+    entry.count = static_cast<uint32_t>(tokens.size());
+    entry.used = true;
+    arena_.insert(arena_.end(), tokens.begin(), tokens.end());
+    ++size_;
+    
+    return TokenSpan{arena_.data() + entry.first, entry.count};
+}
+
+void TokenCache::clear() {
+    if (size_ > 0) {
+        std::fill(slots_.begin(), slots_.end(), Entry());
+    }
+    arena_.clear();
+    size_ = 0;
+}
+
+} // namespace astrax
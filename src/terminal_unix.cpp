@@ -1,9 +1,13 @@
 #if defined(ASTRAX_PLATFORM_LINUX) || defined(ASTRAX_PLATFORM_MACOS)
 
 #include "astrax/terminal.h"
+#include "astrax/input_decoder.h"
 #include <termios.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -11,6 +15,20 @@
 
 namespace astrax {
 
+namespace {
+
+// SGR parameters indexed by Color, so pen changes never format numbers
+const char* const FOREGROUND_SGR[] = {
+    "39", "30", "31", "32", "33", "34", "35", "36", "37",
+    "90", "91", "92", "93", "94", "95", "96", "97"
+};
+const char* const BACKGROUND_SGR[] = {
+    "49", "40", "41", "42", "43", "44", "45", "46", "47",
+    "100", "101", "102", "103", "104", "105", "106", "107"
+};
+
+} // anonymous namespace
+
 /**
  * @brief Unix/Linux/macOS implementation of ITerminal using termios and ANSI escape codes
  */
@@ -18,9 +36,16 @@ class UnixTerminal : public ITerminal {
 public:
     UnixTerminal() {
         tcgetattr(STDIN_FILENO, &originalTermios_);
+        output_.reserve(OUTPUT_RESERVE);
+        
+        // Terminals ignore private modes they do not know, but the Linux
+        // console and dumb terminals never implement this one
+        const char* term = getenv("TERM");
+        synchronizedOutput_ = term && std::strcmp(term, "dumb") != 0 && std::strcmp(term, "linux") != 0;
     }
     
     ~UnixTerminal() override {
+        flush();
         disableRawMode();
     }
     
@@ -34,16 +59,16 @@ public:
         struct termios raw = originalTermios_;
         
         // Input flags: disable break, CR to NL, parity, strip, flow control
-        raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+        raw.c_iflag &= ~static_cast<tcflag_t>(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
         
         // Output flags: disable post-processing
-        raw.c_oflag &= ~(OPOST);
+        raw.c_oflag &= ~static_cast<tcflag_t>(OPOST);
         
         // Control flags: set 8-bit chars
         raw.c_cflag |= (CS8);
         
         // Local flags: disable echo, canonical mode, signals, extended input
-        raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+        raw.c_lflag &= ~static_cast<tcflag_t>(ECHO | ICANON | IEXTEN | ISIG);
         
         // Control chars: read timeout
         raw.c_cc[VMIN] = 1;   // min chars to read
@@ -51,11 +76,21 @@ public:
         
         tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
         rawModeEnabled_ = true;
+        forgetCursor();  // Other programs may have written meanwhile
+        
+        // Pastes arrive bracketed, as one event, rather than as typed keys
+        emit("\x1b[?2004h");
+        flush();
+        penKnown_ = false;
     }
     
     void disableRawMode() override {
         if (!rawModeEnabled_) return;
         
+        setPen(Pen());
+        emit("\x1b[?2004l");
+        flush();  // Queued output was meant for the raw-mode screen
+        
         tcsetattr(STDIN_FILENO, TCSAFLUSH, &originalTermios_);
         rawModeEnabled_ = false;
     }
@@ -65,36 +100,88 @@ public:
     // ========================================================================
     
     void clearScreen() override {
-        write("\x1b[2J\x1b[H");  // Clear screen and move cursor home
+        emit("\x1b[2J\x1b[H");  // Clear screen and move cursor home
+        cursorX_ = 0;
+        cursorY_ = 0;
     }
     
     void clearToEndOfScreen() override {
-        write("\x1b[J");
+        emit("\x1b[J");
     }
     
     void clearToEndOfLine() override {
-        write("\x1b[K");
+        emit("\x1b[K");
     }
     
     void setCursor(int x, int y) override {
-        char buf[32];
-        snprintf(buf, sizeof(buf), "\x1b[%d;%dH", y + 1, x + 1);
-        write(buf);
+        if (x == cursorX_ && y == cursorY_) {
+            return;
+        }
+        
+        // Absolute position, always valid
+        char best[32];
+        int bestLength = snprintf(best, sizeof(best), "\x1b[%d;%dH", y + 1, x + 1);
+        
+        // Relative moves from a known position are often shorter
+        if (cursorX_ >= 0) {
+            char move[32];
+            int length = -1;
+            if (y == cursorY_ && x == 0) {
+                length = snprintf(move, sizeof(move), "\r");
+            } else if (y == cursorY_ + 1 && x == 0) {
+                length = snprintf(move, sizeof(move), "\r\n");  // OPOST is off: \n only moves down
+            } else if (y == cursorY_ && x == cursorX_ - 1) {
+                length = snprintf(move, sizeof(move), "\b");
+            } else if (y == cursorY_) {
+                int dx = x - cursorX_;
+                length = dx > 0 ? snprintf(move, sizeof(move), "\x1b[%dC", dx)
+                                : snprintf(move, sizeof(move), "\x1b[%dD", -dx);
+            } else if (x == cursorX_) {
+                int dy = y - cursorY_;
+                length = dy > 0 ? snprintf(move, sizeof(move), "\x1b[%dB", dy)
+                                : snprintf(move, sizeof(move), "\x1b[%dA", -dy);
+            }
+            if (length > 0 && length < bestLength) {
+                std::memcpy(best, move, static_cast<size_t>(length));
+                bestLength = length;
+            }
+        }
+        
+        output_.append(best, static_cast<size_t>(bestLength));
+        cursorX_ = x;
+        cursorY_ = y;
     }
     
     void hideCursor() override {
-        write("\x1b[?25l");
+        emit("\x1b[?25l");
     }
     
     void showCursor() override {
-        write("\x1b[?25h");
+        emit("\x1b[?25h");
+    }
+    
+    bool scrollRows(int top, int bottom, int lines) override {
+        if (lines == 0 || top < 0 || bottom <= top) {
+            return false;
+        }
+        
+        // Limit scrolling to the rows with DECSTBM, shift them with SU/SD, then
+        // restore the full-screen region
+        char buf[48];
+        int length = snprintf(buf, sizeof(buf), "\x1b[%d;%dr\x1b[%d%c\x1b[r",
+                              top + 1, bottom + 1, lines > 0 ? lines : -lines, lines > 0 ? 'S' : 'T');
+        output_.append(buf, static_cast<size_t>(length));
+        forgetCursor();  // DECSTBM homes the cursor
+        return true;
     }
     
     Size getSize() override {
         struct winsize ws;
         if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0) {
+            columns_ = 80;
             return {80, 24};  // Default fallback
         }
+        columns_ = ws.ws_col;
         return {ws.ws_col, ws.ws_row};
     }
     
@@ -102,49 +189,115 @@ public:
     // Output
     // ========================================================================
     
+    // Everything is queued in output_ and sent by flush() in one write, so a
+    // frame costs one syscall instead of one per character or escape.
+    
     void write(const std::string& text) override {
-        ::write(STDOUT_FILENO, text.c_str(), text.size());
+        output_.append(text);
+        for (char c : text) {
+            advance(c);
+        }
     }
     
     void writeChar(char c) override {
-        ::write(STDOUT_FILENO, &c, 1);
+        output_.push_back(c);
+        advance(c);
     }
     
     void flush() override {
-        fflush(stdout);
+        const char* data = output_.data();
+        size_t remaining = output_.size();
+        
+        while (remaining > 0) {
+            ssize_t written = ::write(STDOUT_FILENO, data, remaining);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    // Non-blocking tty with a full buffer: wait until it drains
+                    struct pollfd pfd = {STDOUT_FILENO, POLLOUT, 0};
+                    poll(&pfd, 1, -1);
+                    continue;
+                }
+                break;  // Terminal gone; drop the frame
+            }
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+        output_.clear();  // Keeps its capacity for the next frame
+    }
+    
+    void beginSynchronizedUpdate() override {
+        if (synchronizedOutput_) emit("\x1b[?2026h");
+    }
+    
+    void endSynchronizedUpdate() override {
+        if (synchronizedOutput_) emit("\x1b[?2026l");
     }
     
     // ========================================================================
     // Colors (ANSI escape codes)
     // ========================================================================
     
-    void setColor(Color fg, Color bg) override {
-        char buf[32];
-        int fgCode = colorToAnsi(fg, false);
-        int bgCode = colorToAnsi(bg, true);
-        
-        if (fgCode >= 0 && bgCode >= 0) {
-            snprintf(buf, sizeof(buf), "\x1b[%d;%dm", fgCode, bgCode);
-        } else if (fgCode >= 0) {
-            snprintf(buf, sizeof(buf), "\x1b[%dm", fgCode);
-        } else if (bgCode >= 0) {
-            snprintf(buf, sizeof(buf), "\x1b[%dm", bgCode);
-        } else {
+    void setPen(const Pen& pen) override {
+        if (penKnown_ && pen == pen_) {
             return;
         }
-        write(buf);
+        
+        // One SGR sequence carries every change; unknown state starts from a reset
+        output_.append("\x1b[");
+        bool first = true;
+        auto param = [&](const char* code) {
+            if (!first) output_.push_back(';');
+            output_.append(code);
+            first = false;
+        };
+        
+        if (!penKnown_) {
+            param("0");
+            pen_ = Pen();
+        }
+        uint8_t changed = static_cast<uint8_t>(pen.attributes ^ pen_.attributes);
+        if (changed & Pen::BOLD) {
+            param(pen.attributes & Pen::BOLD ? "1" : "22");
+        }
+        if (changed & Pen::UNDERLINE) {
+            param(pen.attributes & Pen::UNDERLINE ? "4" : "24");
+        }
+        if (pen.foreground != pen_.foreground) {
+            param(FOREGROUND_SGR[static_cast<size_t>(pen.foreground)]);
+        }
+        if (pen.background != pen_.background) {
+            param(BACKGROUND_SGR[static_cast<size_t>(pen.background)]);
+        }
+        output_.push_back('m');
+        
+        pen_ = pen;
+        penKnown_ = true;
+    }
+    
+    void setColor(Color fg, Color bg) override {
+        // Default leaves a channel as it is
+        Pen pen = currentPen();
+        if (fg != Color::Default) pen.foreground = fg;
+        if (bg != Color::Default) pen.background = bg;
+        setPen(pen);
     }
     
     void resetColor() override {
-        write("\x1b[0m");
+        setPen(Pen());
     }
     
     void setBold(bool enabled) override {
-        write(enabled ? "\x1b[1m" : "\x1b[22m");
+        Pen pen = currentPen();
+        pen.attributes = static_cast<uint8_t>(enabled ? pen.attributes | Pen::BOLD : pen.attributes & ~Pen::BOLD);
+        setPen(pen);
     }
     
     void setUnderline(bool enabled) override {
-        write(enabled ? "\x1b[4m" : "\x1b[24m");
+        Pen pen = currentPen();
+        pen.attributes = static_cast<uint8_t>(enabled ? pen.attributes | Pen::UNDERLINE
+                                                      : pen.attributes & ~Pen::UNDERLINE);
+        setPen(pen);
     }
     
     // ========================================================================
@@ -153,87 +306,32 @@ public:
     
     KeyEvent readKey() override {
         KeyEvent event;
-        char c;
-        
-        if (read(STDIN_FILENO, &c, 1) != 1) {
-            return event;
-        }
-        
-        // Check for escape sequence
-        if (c == '\x1b') {
-            char seq[4];
-            if (read(STDIN_FILENO, &seq[0], 1) != 1) {
-                event.key = static_cast<int>(SpecialKey::Escape);
-                return event;
-            }
-            
-            if (seq[0] == '[') {
-                if (read(STDIN_FILENO, &seq[1], 1) != 1) {
-                    return event;
-                }
-                
-                if (seq[1] >= '0' && seq[1] <= '9') {
-                    if (read(STDIN_FILENO, &seq[2], 1) != 1) {
-                        return event;
-                    }
-                    if (seq[2] == '~') {
-                        switch (seq[1]) {
-                            case '1': event.key = static_cast<int>(SpecialKey::Home); break;
-                            case '3': event.key = static_cast<int>(SpecialKey::Delete); break;
-                            case '4': event.key = static_cast<int>(SpecialKey::End); break;
-                            case '5': event.key = static_cast<int>(SpecialKey::PageUp); break;
-                            case '6': event.key = static_cast<int>(SpecialKey::PageDown); break;
-                        }
-                    }
-                } else {
-                    switch (seq[1]) {
-                        case 'A': event.key = static_cast<int>(SpecialKey::Up); break;
-                        case 'B': event.key = static_cast<int>(SpecialKey::Down); break;
-                        case 'C': event.key = static_cast<int>(SpecialKey::Right); break;
-                        case 'D': event.key = static_cast<int>(SpecialKey::Left); break;
-                        case 'H': event.key = static_cast<int>(SpecialKey::Home); break;
-                        case 'F': event.key = static_cast<int>(SpecialKey::End); break;
-                    }
-                }
-            } else if (seq[0] == 'O') {
-                if (read(STDIN_FILENO, &seq[1], 1) != 1) {
-                    return event;
-                }
-                switch (seq[1]) {
-                    case 'H': event.key = static_cast<int>(SpecialKey::Home); break;
-                    case 'F': event.key = static_cast<int>(SpecialKey::End); break;
-                    case 'P': event.key = static_cast<int>(SpecialKey::F1); break;
-                    case 'Q': event.key = static_cast<int>(SpecialKey::F2); break;
-                    case 'R': event.key = static_cast<int>(SpecialKey::F3); break;
-                    case 'S': event.key = static_cast<int>(SpecialKey::F4); break;
-                }
-            } else {
-                event.key = static_cast<int>(SpecialKey::Escape);
-                event.alt = true;
+        while (!input_.next(event)) {
+            // A partial escape sequence completes within moments; if nothing
+            // follows, it was the Escape key itself. A paste may take longer.
+            bool partial = !input_.empty() && !input_.pasting();
+            if (!readInput(partial ? ESCAPE_TIMEOUT_MS : -1)) {
+                input_.next(event, true);
+                break;
             }
-        } else if (c >= 1 && c <= 26 && c != '\t' && c != '\r' && c != '\n') {
-            // Ctrl+key
-            event.key = c + 'a' - 1;
-            event.ctrl = true;
-        } else if (c == 127) {
-            event.key = static_cast<int>(SpecialKey::Backspace);
-        } else if (c == '\r' || c == '\n') {
-            event.key = static_cast<int>(SpecialKey::Enter);
-        } else if (c == '\t') {
-            event.key = static_cast<int>(SpecialKey::Tab);
-        } else {
-            event.key = c;
         }
-        
         return event;
     }
     
     bool hasKey() override {
-        struct timeval tv = {0, 0};
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(STDIN_FILENO, &fds);
-        return select(STDIN_FILENO + 1, &fds, nullptr, nullptr, &tv) > 0;
+        return waitForKey(0);
+    }
+    
+    bool hasBufferedKey() override {
+        return !input_.empty();
+    }
+    
+    std::string takePaste() override {
+        return input_.takePaste();
+    }
+    
+    bool waitForKey(int timeoutMs) override {
+        return !input_.empty() || waitReadable(std::max(timeoutMs, 0));
     }
     
     // ========================================================================
@@ -241,7 +339,9 @@ public:
     // ========================================================================
     
     void setTitle(const std::string& title) override {
-        write("\x1b]0;" + title + "\x07");
+        emit("\x1b]0;");
+        emit(title.c_str());
+        emit("\x07");
     }
     
     void openExternalWindow(const std::string& command) override {
@@ -281,33 +381,81 @@ public:
     }
     
 private:
+    /// Initial output capacity, enough for a full frame of a large terminal
+    static constexpr size_t OUTPUT_RESERVE = 64 * 1024;
+    
     struct termios originalTermios_;
     bool rawModeEnabled_ = false;
+    std::string output_;  // Output queued until the next flush()
+    
+    // Where output will leave the cursor, so moves can be relative; -1 if unknown
+    int cursorX_ = -1;
+    int cursorY_ = -1;
+    int columns_ = 0;
+    
+    // Frames are bracketed with DEC mode 2026
+    bool synchronizedOutput_ = false;
+    
+    // Pen the terminal is drawing with, once known
+    Pen pen_;
+    bool penKnown_ = false;
+    
+    Pen currentPen() const { return penKnown_ ? pen_ : Pen(); }
+    
+    // Keys read but not yet returned
+    InputDecoder input_;
+    
+    // How long the rest of an escape sequence may take to arrive
+    static constexpr int ESCAPE_TIMEOUT_MS = 50;
+    
+    /// Wait until stdin is readable; timeoutMs < 0 waits indefinitely
+    bool waitReadable(int timeoutMs) {
+        struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+        int ready;
+        do {
+            ready = poll(&pfd, 1, timeoutMs);
+        } while (ready < 0 && errno == EINTR);
+        return ready > 0;
+    }
     
-    int colorToAnsi(Color color, bool background) const {
-        int base = background ? 40 : 30;
-        int brightBase = background ? 100 : 90;
+    /// Append everything available on stdin to input_ with a single read()
+    bool readInput(int timeoutMs) {
+        size_t space = 0;
+        char* dest = input_.writeSpace(space);
+        if (space == 0 || !waitReadable(timeoutMs)) {
+            return false;
+        }
         
-        switch (color) {
-            case Color::Default:       return -1;
-            case Color::Black:         return base + 0;
-            case Color::Red:           return base + 1;
-            case Color::Green:         return base + 2;
-            case Color::Yellow:        return base + 3;
-            case Color::Blue:          return base + 4;
-            case Color::Magenta:       return base + 5;
-            case Color::Cyan:          return base + 6;
-            case Color::White:         return base + 7;
-            case Color::BrightBlack:   return brightBase + 0;
-            case Color::BrightRed:     return brightBase + 1;
-            case Color::BrightGreen:   return brightBase + 2;
-            case Color::BrightYellow:  return brightBase + 3;
-            case Color::BrightBlue:    return brightBase + 4;
-            case Color::BrightMagenta: return brightBase + 5;
-            case Color::BrightCyan:    return brightBase + 6;
-            case Color::BrightWhite:   return brightBase + 7;
-            default:                   return -1;
+        ssize_t count;
+        do {
+            count = ::read(STDIN_FILENO, dest, space);
+        } while (count < 0 && errno == EINTR);
+        if (count <= 0) {
+            return false;
         }
+        input_.commit(static_cast<size_t>(count));
+        return true;
+    }
+    
+    /// Queue a control sequence (does not move the cursor)
+    void emit(const char* sequence) {
+        output_.append(sequence);
+    }
+    
+    /// Track the cursor over one byte of text
+    void advance(char c) {
+        unsigned char uc = static_cast<unsigned char>(c);
+        if (cursorX_ < 0 || (uc & 0xC0) == 0x80) {
+            return;  // Unknown, or a UTF-8 continuation byte
+        }
+        if (uc < 0x20 || uc == 0x7F || ++cursorX_ >= columns_) {
+            forgetCursor();  // Controls, or the pending wrap at the right margin
+        }
+    }
+    
+    void forgetCursor() {
+        cursorX_ = -1;
+        cursorY_ = -1;
     }
 };
 
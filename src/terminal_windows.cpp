@@ -125,6 +125,29 @@ public:
         SetConsoleCursorPosition(hConsole_, coord);
     }
     
+    bool scrollRows(int top, int bottom, int lines) override {
+        if (lines == 0 || top < 0 || bottom <= top) {
+            return false;
+        }
+        
+        CONSOLE_SCREEN_BUFFER_INFO csbi;
+        GetConsoleScreenBufferInfo(hConsole_, &csbi);
+        
+        // Move the region's contents and fill what is uncovered with blanks
+        SMALL_RECT region;
+        region.Left = csbi.srWindow.Left;
+        region.Right = csbi.srWindow.Right;
+        region.Top = static_cast<SHORT>(csbi.srWindow.Top + top);
+        region.Bottom = static_cast<SHORT>(csbi.srWindow.Top + bottom);
+        
+        COORD destination = {region.Left, static_cast<SHORT>(region.Top - lines)};
+        CHAR_INFO fill;
+        fill.Char.AsciiChar = ' ';
+        fill.Attributes = originalBufferInfo_.wAttributes;
+        
+        return ScrollConsoleScreenBuffer(hConsole_, &region, &region, destination, &fill) != 0;
+    }
+    
     void hideCursor() override {
         CONSOLE_CURSOR_INFO info;
         GetConsoleCursorInfo(hConsole_, &info);
@@ -166,11 +189,34 @@ public:
         // Windows console is synchronous, no need to flush
     }
     
+    void beginSynchronizedUpdate() override {
+        // Console API writes take effect immediately; there is no frame to hold
+    }
+    
+    void endSynchronizedUpdate() override {}
+    
     // ========================================================================
     // Colors
     // ========================================================================
     
+    void setPen(const Pen& pen) override {
+        if (penKnown_ && pen == pen_) {
+            return;
+        }
+        
+        resetColor();
+        if (pen.foreground != Color::Default || pen.background != Color::Default) {
+            setColor(pen.foreground, pen.background);
+        }
+        if (pen.attributes & Pen::BOLD) {
+            setBold(true);
+        }
+        pen_ = pen;
+        penKnown_ = true;
+    }
+    
     void setColor(Color fg, Color bg) override {
+        penKnown_ = false;
         WORD attr = 0;
         
         // Foreground
@@ -211,10 +257,13 @@ public:
     }
     
     void resetColor() override {
+        penKnown_ = false;
         SetConsoleTextAttribute(hConsole_, originalBufferInfo_.wAttributes);
     }
     
     void setBold(bool enabled) override {
+        penKnown_ = false;
+        
         // Windows console bold is achieved via intensity
         if (enabled) {
             CONSOLE_SCREEN_BUFFER_INFO csbi;
@@ -279,6 +328,26 @@ public:
         return _kbhit() != 0;
     }
     
+    std::string takePaste() override {
+        return std::string();  // Console pastes arrive as typed keys
+    }
+    
+    bool hasBufferedKey() override {
+        return hasKey();  // The console queues input itself
+    }
+    
+    bool waitForKey(int timeoutMs) override {
+        // The input handle also signals for mouse and focus events, so poll
+        ULONGLONG deadline = GetTickCount64() + static_cast<ULONGLONG>(timeoutMs > 0 ? timeoutMs : 0);
+        while (!hasKey()) {
+            if (GetTickCount64() >= deadline) {
+                return false;
+            }
+            Sleep(1);
+        }
+        return true;
+    }
+    
     // ========================================================================
     // Window Management
     // ========================================================================
@@ -316,6 +385,10 @@ private:
     DWORD originalMode_ = 0;
     CONSOLE_SCREEN_BUFFER_INFO originalBufferInfo_;
     bool rawModeEnabled_ = false;
+    
+    // Pen set by the last setPen(), unless colors were changed directly since
+    Pen pen_;
+    bool penKnown_ = false;
 };
 
 // Factory function
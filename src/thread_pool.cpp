@@ -0,0 +1,103 @@
+#include "astrax/thread_pool.h"
+
+namespace astrax {
+
+// ============================================================================
+// Lifetime
+// ============================================================================
+
+ThreadPool::ThreadPool(size_t threads) : threadCount_(threads) {
+    if (threadCount_ == 0) {
+        unsigned hardware = std::thread::hardware_concurrency();
+        threadCount_ = hardware > 1 ? hardware - 1 : 0;
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// ============================================================================
+// Batches
+// ============================================================================
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)>& task) {
+    bool idle = false;
+    if (threadCount_ == 0 || count < 2 || !running_.compare_exchange_strong(idle, true)) {
+        for (size_t i = 0; i < count; ++i) {
+            task(i);
+        }
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (threads_.empty()) {
+            for (size_t i = 0; i < threadCount_; ++i) {
+                threads_.emplace_back(&ThreadPool::work, this);
+            }
+        }
+        task_ = &task;
+        count_ = count;
+        next_.store(0, std::memory_order_relaxed);
+        busy_ = threadCount_;
+        ++batch_;
+    }
+    wake_.notify_all();
+    
+    drain(task, count);
+    
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        finished_.wait(lock, [this] { return busy_ == 0; });
+        task_ = nullptr;
+    }
+    running_.store(false, std::memory_order_release);
+}
+
+void ThreadPool::drain(const std::function<void(size_t)>& task, size_t count) {
+    for (size_t i = next_.fetch_add(1, std::memory_order_relaxed); i < count;
+         i = next_.fetch_add(1, std::memory_order_relaxed)) {
+        task(i);
+    }
+}
+
+// ============================================================================
+// Worker Threads
+// ============================================================================
+
+void ThreadPool::work() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this, seen] { return stop_ || batch_ != seen; });
+        if (stop_) {
+            return;
+        }
+        seen = batch_;
+        const std::function<void(size_t)>& task = *task_;
+        size_t count = count_;
+        lock.unlock();
+        
+        drain(task, count);
+        
+        lock.lock();
+        if (--busy_ == 0) {
+            finished_.notify_one();
+        }
+    }
+}
+
+} // namespace astrax
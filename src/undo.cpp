@@ -0,0 +1,134 @@
+#include "astrax/undo.h"
+#include <algorithm>
+
+namespace astrax {
+
+constexpr size_t UndoHistory::DEFAULT_MEMORY_LIMIT;
+
+// ============================================================================
+// UndoEntry
+// ============================================================================
+
+size_t UndoEntry::memoryUsage() const {
+    size_t bytes = sizeof(UndoEntry);
+    for (const auto& op : ops) {
+        bytes += sizeof(EditOp) + op.removed.capacity() + op.inserted.capacity();
+    }
+    return bytes;
+}
+
+void UndoEntry::addOp(EditOp op) {
+    if (!ops.empty()) {
+        EditOp& last = ops.back();
+
+        // Repeated backspace: erase just before the previous erase
+        if (op.inserted.empty() && last.inserted.empty() &&
+            op.offset + op.removed.size() == last.offset) {
+            if (!lastRemovedReversed_) {
+                std::reverse(last.removed.begin(), last.removed.end());
+                lastRemovedReversed_ = true;
+            }
+            last.removed.append(op.removed.rbegin(), op.removed.rend());
+            last.offset = op.offset;
+            return;
+        }
+        restoreLastRemoved();
+
+        // Typing: insertion right after the previous insertion
+        if (op.removed.empty() && last.offset + last.inserted.size() == op.offset) {
+            last.inserted += op.inserted;
+            return;
+        }
+
+        // Backspace over text inserted by this entry
+        if (op.inserted.empty() && !op.removed.empty() &&
+            op.removed.size() <= last.inserted.size() &&
+            op.offset + op.removed.size() == last.offset + last.inserted.size()) {
+            last.inserted.resize(last.inserted.size() - op.removed.size());
+            if (last.inserted.empty() && last.removed.empty()) {
+                ops.pop_back();
+            }
+            return;
+        }
+
+        // Repeated delete: erase at the same offset
+        if (op.inserted.empty() && last.inserted.empty() && op.offset == last.offset) {
+            last.removed += op.removed;
+            return;
+        }
+    }
+
+    ops.push_back(std::move(op));
+}
+
+void UndoEntry::close() {
+    restoreLastRemoved();
+}
+
+void UndoEntry::restoreLastRemoved() {
+    if (lastRemovedReversed_) {
+        std::reverse(ops.back().removed.begin(), ops.back().removed.end());
+        lastRemovedReversed_ = false;
+    }
+}
+
+// ============================================================================
+// UndoHistory
+// ============================================================================
+
+void UndoHistory::push(UndoEntry entry) {
+    clearRedo();
+    memoryUsage_ += entry.memoryUsage();
+    undoStack_.push_back(std::move(entry));
+    trim();
+}
+
+const UndoEntry* UndoHistory::undo() {
+    if (undoStack_.empty()) {
+        return nullptr;
+    }
+    redoStack_.push_back(std::move(undoStack_.back()));
+    undoStack_.pop_back();
+    return &redoStack_.back();
+}
+
+const UndoEntry* UndoHistory::redo() {
+    if (redoStack_.empty()) {
+        return nullptr;
+    }
+    undoStack_.push_back(std::move(redoStack_.back()));
+    redoStack_.pop_back();
+    return &undoStack_.back();
+}
+
+void UndoHistory::clear() {
+    undoStack_.clear();
+    redoStack_.clear();
+    memoryUsage_ = 0;
+}
+
+void UndoHistory::setMemoryLimit(size_t bytes) {
+    memoryLimit_ = bytes;
+    trim();
+}
+
+void UndoHistory::clearRedo() {
+    for (const auto& entry : redoStack_) {
+        memoryUsage_ -= entry.memoryUsage();
+    }
+    redoStack_.clear();
+}
+
+void UndoHistory::trim() {
+    // Oldest history goes first: undo bottom, then the far end of redo
+    while (memoryUsage_ > memoryLimit_ && !undoStack_.empty()) {
+        memoryUsage_ -= undoStack_.front().memoryUsage();
+        undoStack_.pop_front();
+    }
+    while (memoryUsage_ > memoryLimit_ && !redoStack_.empty()) {
+        memoryUsage_ -= redoStack_.front().memoryUsage();
+        redoStack_.pop_front();
+    }
+}
+
+} // namespace astrax
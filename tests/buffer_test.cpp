@@ -1,5 +1,20 @@
 #include <gtest/gtest.h>
 #include "astrax/buffer.h"
+#include "astrax/piece_table.h"
+#include "astrax/mapped_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef ASTRAX_PLATFORM_WINDOWS
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <iterator>
 
 using namespace astrax;
 
@@ -210,6 +225,93 @@ TEST(BufferTest, MultipleUndo) {
     EXPECT_EQ(buffer.getLine(0), "");
 }
 
+TEST(BufferTest, UndoRedoJoinAndDelete) {
+    Buffer buffer("Hello\nWorld\nTest");
+    
+    buffer.joinLines();
+    buffer.setCursor({1, 0});
+    buffer.deleteLine();
+    EXPECT_EQ(buffer.getContent(), "Hello World");
+    
+    buffer.undo();
+    EXPECT_EQ(buffer.getContent(), "Hello World\nTest");
+    buffer.undo();
+    EXPECT_EQ(buffer.getContent(), "Hello\nWorld\nTest");
+    EXPECT_FALSE(buffer.isModified());
+    
+    buffer.redo();
+    buffer.redo();
+    EXPECT_EQ(buffer.getContent(), "Hello World");
+    EXPECT_TRUE(buffer.isModified());
+}
+
+TEST(BufferTest, EditGroupUndoesAsOneStep) {
+    Buffer buffer("Hello");
+    buffer.moveToLineEnd();
+    
+    buffer.beginEditGroup();
+    for (char c : std::string(", World")) {
+        buffer.insertChar(c);
+    }
+    buffer.insertNewline();
+    buffer.insertString("next\nline");
+    buffer.deleteCharBefore();
+    buffer.commitEditGroup();
+    
+    EXPECT_EQ(buffer.getContent(), "Hello, World\nnext\nlin");
+    
+    buffer.undo();
+    EXPECT_EQ(buffer.getContent(), "Hello");
+    EXPECT_FALSE(buffer.canUndo());
+    EXPECT_EQ(buffer.getCursor().column, 5u);
+    
+    buffer.redo();
+    EXPECT_EQ(buffer.getContent(), "Hello, World\nnext\nlin");
+}
+
+TEST(BufferTest, BackspaceRunUndoesInOrder) {
+    std::string text;
+    for (int i = 0; i < 3000; ++i) {
+        text += static_cast<char>('a' + i % 26);
+    }
+    Buffer buffer(text + "\nnext");
+    buffer.setCursor({0, 2500});
+    
+    // One insert session: a long backspace run, then deletes after the cursor
+    buffer.beginEditGroup();
+    for (int i = 0; i < 2000; ++i) {
+        buffer.deleteCharBefore();
+    }
+    buffer.deleteCharAt();
+    buffer.deleteCharAt();
+    buffer.commitEditGroup();
+    EXPECT_EQ(buffer.getLine(0), text.substr(0, 500) + text.substr(2502));
+    
+    buffer.undo();
+    EXPECT_EQ(buffer.getContent(), text + "\nnext");
+    buffer.redo();
+    EXPECT_EQ(buffer.getLine(0), text.substr(0, 500) + text.substr(2502));
+}
+
+TEST(BufferTest, UndoMemoryLimit) {
+    Buffer buffer;
+    buffer.setUndoMemoryLimit(4096);
+    
+    for (int i = 0; i < 1000; ++i) {
+        buffer.insertChar('x');
+    }
+    
+    EXPECT_LE(buffer.undoMemoryUsage(), 4096u);
+    EXPECT_TRUE(buffer.canUndo());
+    
+    // Only the newest edits survive the budget
+    while (buffer.canUndo()) {
+        buffer.undo();
+    }
+    EXPECT_GT(buffer.lineLength(0), 0u);
+    EXPECT_LT(buffer.lineLength(0), 1000u);
+}
+
 // ============================================================================
 // Clipboard Tests
 // ============================================================================
@@ -247,4 +349,337 @@ TEST(BufferTest, ModifiedFlag) {
     
     buffer.markSaved();
     EXPECT_FALSE(buffer.isModified());
+    
+    // Typing in an open group (insert mode) shows as modified right away
+    buffer.beginEditGroup();
+    buffer.insertChar('B');
+    EXPECT_TRUE(buffer.isModified());
+    buffer.deleteCharBefore();
+    EXPECT_TRUE(buffer.isModified());
+    buffer.commitEditGroup();
+}
+
+TEST(BufferTest, CrlfAndTrailingNewline) {
+    Buffer buffer("Hello\r\nWorld\r\n");
+    EXPECT_EQ(buffer.lineCount(), 2);
+    EXPECT_EQ(buffer.getLine(0), "Hello");
+    EXPECT_EQ(buffer.getLine(1), "World");
+}
+
+TEST(BufferTest, LineViewAcrossEdits) {
+    Buffer buffer("Hello\nWorld");
+    buffer.setCursor({0, 5});
+    buffer.insertString(", big");
+    buffer.moveCursor(0, 1);
+    buffer.moveToLineStart();
+    buffer.insertString("wide ");
+    
+    EXPECT_EQ(buffer.getLineView(0), "Hello, big");
+    EXPECT_EQ(buffer.getLineView(1), "wide World");
+}
+
+TEST(BufferTest, MappedLoadAndSave) {
+    // Lines of varying length spanning several index chunks
+    std::string expected;
+    for (int i = 0; i < 20000; ++i) {
+        expected += "line " + std::to_string(i) + std::string(static_cast<size_t>(i % 13), '.') + "\n";
+    }
+    const std::string path = "astrax_mapped_test.txt";
+    std::ofstream(path, std::ios::binary) << expected;
+    
+    Buffer buffer;
+    buffer.setMapThreshold(0);
+    ASSERT_TRUE(buffer.loadFromFile(path));
+    EXPECT_TRUE(buffer.isMapped());
+    EXPECT_EQ(buffer.lineCount(), 20000);
+    EXPECT_EQ(buffer.getLine(0), "line 0");
+    EXPECT_EQ(buffer.getLine(12345), "line 12345" + std::string(12345 % 13, '.'));
+    EXPECT_EQ(buffer.getLine(19999), "line 19999" + std::string(19999 % 13, '.'));
+    
+    buffer.setCursor({10000, 0});
+    buffer.insertString("edited ");
+    EXPECT_EQ(buffer.getLine(10000), "edited line 10000" + std::string(10000 % 13, '.'));
+    
+    // Saving over the mapped file must not corrupt the text being written
+    ASSERT_TRUE(buffer.saveToFile(path));
+    EXPECT_EQ(buffer.getLine(19999), "line 19999" + std::string(19999 % 13, '.'));
+    
+    Buffer reloaded;
+    ASSERT_TRUE(reloaded.loadFromFile(path));
+    EXPECT_EQ(reloaded.getContent(), buffer.getContent());
+    EXPECT_EQ(reloaded.getLine(10000), buffer.getLine(10000));
+    
+    std::remove(path.c_str());
+}
+
+TEST(BufferTest, PartiallyIndexedMappingReadsLines) {
+    // A snapshot taken mid-load references only the indexed prefix
+    std::vector<std::string> lines;
+    std::string text;
+    for (int i = 0; text.size() < 8 * MappedFile::CHUNK_SIZE; ++i) {
+        lines.push_back("row " + std::to_string(i) + std::string(static_cast<size_t>(i % 29), '-'));
+        text += lines.back() + "\n";
+    }
+    const std::string path = "astrax_partial_index_test.txt";
+    std::ofstream(path, std::ios::binary) << text;
+    
+    auto mapping = MappedFile::open(path);
+    ASSERT_TRUE(mapping);
+    size_t prefix = 3 * MappedFile::CHUNK_SIZE + 100;
+    mapping->indexTo(prefix);
+    ASSERT_LT(mapping->indexedSize(), text.size());
+    ASSERT_GE(mapping->indexedSize(), prefix);
+    
+    PieceTable table;
+    table.append(mapping, 0, prefix);
+    size_t complete = static_cast<size_t>(std::count(text.begin(), text.begin() + static_cast<std::ptrdiff_t>(prefix), '\n'));
+    ASSERT_EQ(table.lineCount(), complete + 1);
+    
+    std::string scratch;
+    for (size_t line = 0; line < complete; ++line) {
+        ASSERT_EQ(table.lineLength(line), lines[line].size()) << "line " << line;
+        ASSERT_EQ(table.lineView(line, scratch), lines[line]) << "line " << line;
+    }
+    size_t lastStart = text.rfind('\n', prefix - 1) + 1;
+    EXPECT_EQ(table.lineView(complete, scratch), text.substr(lastStart, prefix - lastStart));
+    
+    mapping.reset();
+    std::remove(path.c_str());
+}
+
+TEST(BufferTest, MappedLoadNormalizesCrlf) {
+    const std::string path = "astrax_mapped_crlf_test.txt";
+    std::ofstream(path, std::ios::binary) << "Hello\r\nWorld\r\n";
+    
+    Buffer buffer;
+    buffer.setMapThreshold(0);
+    ASSERT_TRUE(buffer.loadFromFile(path));
+    EXPECT_FALSE(buffer.isMapped());
+    EXPECT_EQ(buffer.getContent(), "Hello\nWorld");
+    
+    std::remove(path.c_str());
+}
+
+TEST(BufferTest, SavePreservesCrlf) {
+    const std::string path = "astrax_crlf_save_test.txt";
+    std::ofstream(path, std::ios::binary) << "one\r\ntwo\r\n";
+    
+    Buffer buffer;
+    ASSERT_TRUE(buffer.loadFromFile(path));
+    EXPECT_EQ(buffer.getLineEnding(), LineEnding::CRLF);
+    buffer.setCursor({1, 3});
+    buffer.insertString("\nthree");
+    ASSERT_TRUE(buffer.saveToFile(path));
+    
+    std::ifstream file(path, std::ios::binary);
+    std::string saved((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(saved, "one\r\ntwo\r\nthree\r\n");
+    
+    file.close();
+    std::remove(path.c_str());
+}
+
+TEST(BufferTest, AsyncLoadIsReadOnlyUntilDone) {
+    const std::string path = "astrax_async_test.txt";
+    std::ofstream(path, std::ios::binary) << "first\nsecond\n";
+    
+    Buffer buffer;
+    ASSERT_TRUE(buffer.loadFromFileAsync(path));
+    EXPECT_TRUE(buffer.isLoading());
+    buffer.insertChar('x');
+    EXPECT_FALSE(buffer.saveToFile(path));
+    
+    while (buffer.isLoading()) {
+        buffer.pollLoad();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_FALSE(buffer.loadFailed());
+    EXPECT_FALSE(buffer.isModified());
+    EXPECT_EQ(buffer.getContent(), "first\nsecond");
+    
+    buffer.insertChar('x');
+    EXPECT_EQ(buffer.getLine(0), "xfirst");
+    
+    std::remove(path.c_str());
+}
+
+TEST(BufferTest, MappedLoadSwitchesToCopyAtCrlf) {
+    // LF text up to a segment boundary, where a "\r\n" straddles it
+    std::string prefix;
+    while (prefix.size() + 32 < FileLoader::SEGMENT_SIZE) {
+        prefix += "a line of plain LF text here\n";
+    }
+    prefix.append(FileLoader::SEGMENT_SIZE - 1 - prefix.size(), 'z');
+    const std::string path = "astrax_mixed_test.txt";
+    std::ofstream(path, std::ios::binary) << prefix << "\r\nmore\r\nend\r\n";
+    
+    Buffer buffer;
+    buffer.setMapThreshold(0);
+    ASSERT_TRUE(buffer.loadFromFile(path));
+    EXPECT_EQ(buffer.getContent(), prefix + "\nmore\nend");
+    EXPECT_EQ(buffer.getLineView(buffer.lineCount() - 3).back(), 'z');
+    EXPECT_EQ(buffer.getLine(buffer.lineCount() - 2), "more");
+    EXPECT_EQ(buffer.getLineEnding(), LineEnding::LF);
+    
+    std::remove(path.c_str());
+}
+
+TEST(BufferTest, EditDuringAsyncSaveStaysModified) {
+    const std::string path = "astrax_async_save_test.txt";
+    Buffer buffer("first\n");
+    buffer.insertChar('x');
+    ASSERT_TRUE(buffer.isModified());
+    
+    // The snapshot is taken here; the edit after it is not part of the file
+    ASSERT_TRUE(buffer.saveToFileAsync(path));
+    buffer.insertChar('y');
+    buffer.waitForSaves();
+    
+    SaveResult result;
+    ASSERT_TRUE(buffer.pollSave(result));
+    EXPECT_TRUE(result.ok);
+    EXPECT_FALSE(buffer.pollSave(result));
+    EXPECT_FALSE(buffer.isSaving());
+    EXPECT_TRUE(buffer.isModified());
+    
+    std::ifstream file(path, std::ios::binary);
+    std::string saved((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(saved, "xfirst\n");
+    
+    // Undoing back to the saved version counts as unmodified again
+    buffer.undo();
+    EXPECT_FALSE(buffer.isModified());
+    
+    file.close();
+    std::remove(path.c_str());
+}
+
+#ifndef ASTRAX_PLATFORM_WINDOWS
+TEST(BufferTest, SaveReplacesFileAtomically) {
+    const std::string path = "astrax_atomic_test.txt";
+    const std::string link = "astrax_atomic_link.txt";
+    std::ofstream(path, std::ios::binary) << "old\n";
+    chmod(path.c_str(), 0640);
+    symlink(path.c_str(), link.c_str());
+    
+    Buffer buffer("new content\nsecond line\n");
+    ASSERT_TRUE(buffer.saveToFile(link));
+    EXPECT_EQ(buffer.lastWriteStats().bytes, 24u);
+    
+    // Written through the link, keeping the target's permissions
+    struct stat st;
+    ASSERT_EQ(lstat(link.c_str(), &st), 0);
+    EXPECT_TRUE(S_ISLNK(st.st_mode));
+    ASSERT_EQ(stat(path.c_str(), &st), 0);
+    EXPECT_EQ(st.st_mode & 0777, 0640u);
+    
+    std::ifstream file(path, std::ios::binary);
+    std::string saved((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(saved, "new content\nsecond line\n");
+    
+    file.close();
+    std::remove(link.c_str());
+    std::remove(path.c_str());
+}
+#endif
+
+// ============================================================================
+// Piece Table Tests
+// ============================================================================
+
+TEST(PieceTableTest, InsertEraseMatchesString) {
+    PieceTable table(std::string("line one\nline two\nline three"));
+    std::string reference = "line one\nline two\nline three";
+    
+    // Deterministic pseudo-random edits checked against a plain string
+    uint32_t seed = 12345;
+    auto next = [&seed]() {
+        seed = seed * 1103515245u + 12345u;
+        return seed >> 8;
+    };
+    for (int i = 0; i < 500; ++i) {
+        size_t offset = next() % (reference.size() + 1);
+        if (next() % 3 == 0 && !reference.empty()) {
+            size_t length = next() % 8;
+            table.erase(offset, length);
+            reference.erase(std::min(offset, reference.size()), length);
+        } else {
+            std::string text = (next() % 4 == 0) ? "\n" : "ab";
+            table.insert(offset, text);
+            reference.insert(offset, text);
+        }
+    }
+    
+    ASSERT_EQ(table.text(), reference);
+    
+    size_t lines = 1;
+    for (char c : reference) {
+        if (c == '\n') lines++;
+    }
+    ASSERT_EQ(table.lineCount(), lines);
+    
+    std::string scratch;
+    size_t start = 0;
+    for (size_t line = 0; line < lines; ++line) {
+        size_t end = reference.find('\n', start);
+        if (end == std::string::npos) end = reference.size();
+        EXPECT_EQ(table.lineStart(line), start);
+        EXPECT_EQ(table.lineView(line, scratch), reference.substr(start, end - start));
+        EXPECT_EQ(table.lineOfOffset(start), line);
+        start = end + 1;
+    }
+}
+
+TEST(PieceTableTest, ForEachLineMatchesLineView) {
+    PieceTable table(std::string("alpha\nbeta\ngamma\n\ndelta"));
+    
+    // Scattered edits leave lines that span several pieces
+    uint32_t seed = 99;
+    auto next = [&seed]() {
+        seed = seed * 1103515245u + 12345u;
+        return seed >> 8;
+    };
+    for (int i = 0; i < 300; ++i) {
+        const char* text = (next() % 3 == 0) ? "\n" : "xy";
+        table.insert(next() % (table.size() + 1), text);
+    }
+    
+    std::string scratch;
+    std::string viewScratch;
+    size_t lines = table.lineCount();
+    for (size_t first : {size_t(0), size_t(1), lines / 2, lines - 1, lines}) {
+        size_t expectedLine = first;
+        table.forEachLine(first, lines + 5, scratch, [&](size_t line, StringView view) {
+            ASSERT_EQ(line, expectedLine);
+            ASSERT_EQ(view, table.lineView(line, viewScratch)) << "line " << line;
+            ++expectedLine;
+        });
+        EXPECT_EQ(expectedLine, std::max(first, lines));
+    }
+    
+    // A range that stops short ends on its last line
+    size_t visited = 0;
+    table.forEachLine(2, 5, scratch, [&](size_t, StringView) { ++visited; });
+    EXPECT_EQ(visited, 3u);
+}
+
+TEST(PieceTableTest, CopyIsIndependentSnapshot) {
+    PieceTable table(std::string("abc"));
+    table.insert(3, "def");
+    
+    PieceTable snapshot = table;
+    table.insert(6, "ghi");
+    snapshot.insert(0, "xyz");
+    
+    EXPECT_EQ(table.text(), "abcdefghi");
+    EXPECT_EQ(snapshot.text(), "xyzabcdef");
+}
+
+TEST(PieceTableTest, TypingExtendsPiece) {
+    PieceTable table;
+    for (char c : std::string("hello world")) {
+        table.insert(table.size(), &c, 1);
+    }
+    EXPECT_EQ(table.text(), "hello world");
+    EXPECT_EQ(table.pieceCount(), 1);
 }
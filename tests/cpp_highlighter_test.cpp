@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "astrax/syntax/cpp_highlighter.h"
+#include "astrax/syntax/keyword_table.h"
+#include <string>
+#include <vector>
+
+using namespace astrax;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+namespace {
+
+constexpr const char* COLORS[] = {"red", "green", "blue", "cyan", "magenta", "yellow"};
+constexpr KeywordTable<16> COLOR_TABLE(COLORS, 1);
+static_assert(COLOR_TABLE.perfect(), "color collision: change the seed");
+
+/// Type of the token starting at column, or Default if none does
+TokenType typeAt(const std::vector<Token>& tokens, size_t column) {
+    for (const auto& token : tokens) {
+        if (token.start == column) {
+            return token.type;
+        }
+    }
+    return TokenType::Default;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// KeywordTable Tests
+// ============================================================================
+
+TEST(KeywordTableTest, FindsExactWordsOnly) {
+    // Lookups work at compile time too
+    static_assert(COLOR_TABLE.contains("blue", 4), "blue is a color");
+    static_assert(!COLOR_TABLE.contains("blu", 3), "blu is not");
+    
+    for (const char* color : COLORS) {
+        EXPECT_TRUE(COLOR_TABLE.contains(StringView(color))) << color;
+    }
+    
+    std::string line = "redgreen";
+    EXPECT_TRUE(COLOR_TABLE.contains(StringView(line.data(), 3)));
+    EXPECT_TRUE(COLOR_TABLE.contains(StringView(line.data() + 3, 5)));
+    EXPECT_FALSE(COLOR_TABLE.contains(StringView(line.data(), 4)));
+    EXPECT_FALSE(COLOR_TABLE.contains(StringView(line)));
+    EXPECT_FALSE(COLOR_TABLE.contains(StringView("")));
+    EXPECT_FALSE(COLOR_TABLE.contains(StringView("Red")));
+}
+
+// ============================================================================
+// CppHighlighter Tests
+// ============================================================================
+
+TEST(CppHighlighterTest, ClassifiesWords) {
+    CppHighlighter highlighter;
+    std::vector<Token> tokens = highlighter.highlightLine("static constexpr uint64_t count = make(constexprs);", 0);
+    
+    EXPECT_EQ(typeAt(tokens, 0), TokenType::Keyword);
+    EXPECT_EQ(typeAt(tokens, 7), TokenType::Keyword);
+    EXPECT_EQ(typeAt(tokens, 17), TokenType::Type);
+    EXPECT_EQ(typeAt(tokens, 26), TokenType::Default);    // count
+    EXPECT_EQ(typeAt(tokens, 34), TokenType::Function);
+    EXPECT_EQ(typeAt(tokens, 39), TokenType::Default);    // constexprs
+}
+
+TEST(CppHighlighterTest, OnlyKnownDirectivesArePreprocessor) {
+    CppHighlighter highlighter;
+    std::vector<Token> tokens = highlighter.highlightLine("#define STR(x) #x", 0);
+    ASSERT_FALSE(tokens.empty());
+    EXPECT_EQ(tokens[0].type, TokenType::Preprocessor);
+    EXPECT_EQ(tokens[0].length, 7u);
+    EXPECT_EQ(typeAt(tokens, 15), TokenType::Default);    // Stringizing #x
+    
+    tokens = highlighter.highlightLine("  #  include <vector>", 0);
+    ASSERT_FALSE(tokens.empty());
+    EXPECT_EQ(tokens[0].start, 2u);
+    EXPECT_EQ(tokens[0].length, 10u);
+    EXPECT_EQ(tokens[0].type, TokenType::Preprocessor);
+}
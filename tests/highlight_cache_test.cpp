@@ -0,0 +1,304 @@
+#include <gtest/gtest.h>
+#include "astrax/syntax/highlight_cache.h"
+#include "astrax/syntax/highlight_worker.h"
+#include "astrax/syntax/cpp_highlighter.h"
+#include "astrax/buffer.h"
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace astrax;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+namespace {
+
+/// C++ highlighter that counts the lines it lexes for state
+class CountingHighlighter : public CppHighlighter {
+public:
+    void updateState(const std::string& line, size_t lineIndex) override {
+        ++linesLexed;
+        CppHighlighter::updateState(line, lineIndex);
+    }
+    
+    std::vector<Token> highlightLine(const std::string& line, size_t lineIndex) override {
+        ++linesHighlighted;
+        return CppHighlighter::highlightLine(line, lineIndex);
+    }
+    
+    size_t linesLexed = 0;
+    size_t linesHighlighted = 0;
+};
+
+std::string repeatLines(const std::string& line, int count) {
+    std::string text;
+    for (int i = 0; i < count; ++i) {
+        text += line + "\n";
+    }
+    return text;
+}
+
+/// State at the start of every line, lexed from the top with no cache
+std::vector<HighlightState> lexAll(const Buffer& buffer) {
+    CppHighlighter highlighter;
+    std::vector<HighlightState> states;
+    for (size_t line = 0; line < buffer.lineCount(); ++line) {
+        states.push_back(highlighter.getState());
+        highlighter.updateState(buffer.getLine(line), line);
+    }
+    return states;
+}
+
+bool isComment(TokenSpan tokens) {
+    return tokens.size() == 1 && tokens[0].type == TokenType::Comment;
+}
+
+/// Wait for the worker's next result, giving up after a few seconds
+std::unique_ptr<HighlightResult> waitForResult(HighlightWorker& worker) {
+    for (int i = 0; i < 5000 && !worker.hasResult(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return worker.take();
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// HighlightCache Tests
+// ============================================================================
+
+TEST(HighlightCacheTest, BlockCommentAboveLineIsSeen) {
+    CppHighlighter highlighter;
+    HighlightCache cache;
+    cache.setHighlighter(&highlighter);
+    Buffer buffer("/* open\n" + repeatLines("int x;", 100) + "*/\nint y;");
+    cache.sync(buffer);
+    
+    // Highlighting deep inside the comment, with no line above visited first
+    EXPECT_TRUE(isComment(cache.highlightLine(buffer, 50)));
+    
+    TokenSpan after = cache.highlightLine(buffer, 102);
+    ASSERT_FALSE(after.empty());
+    EXPECT_EQ(after[0].type, TokenType::Type);
+}
+
+TEST(HighlightCacheTest, EditInvalidatesFollowingLines) {
+    CppHighlighter highlighter;
+    HighlightCache cache;
+    cache.setHighlighter(&highlighter);
+    Buffer buffer(repeatLines("int x;", 1000));
+    cache.sync(buffer);
+    EXPECT_FALSE(isComment(cache.highlightLine(buffer, 900)));
+    
+    // Opening a comment at the top reaches every line below
+    buffer.setCursor({10, 0});
+    buffer.insertString("/*");
+    cache.sync(buffer);
+    EXPECT_FALSE(isComment(cache.highlightLine(buffer, 9)));
+    EXPECT_TRUE(isComment(cache.highlightLine(buffer, 900)));
+    
+    buffer.undo();
+    cache.sync(buffer);
+    EXPECT_FALSE(isComment(cache.highlightLine(buffer, 900)));
+}
+
+TEST(HighlightCacheTest, RelexingStopsWhenStateConverges) {
+    CountingHighlighter highlighter;
+    HighlightCache cache;
+    cache.setHighlighter(&highlighter);
+    Buffer buffer(repeatLines("int x; /* a */", 20000));
+    cache.sync(buffer);
+    cache.stateAt(buffer, 19999);
+    EXPECT_EQ(highlighter.linesLexed, 19999u);
+    
+    // Edits that leave the state alone cost a couple of lines each
+    highlighter.linesLexed = 0;
+    buffer.setCursor({500, 0});
+    buffer.insertString("x");
+    buffer.insertNewline();
+    buffer.setCursor({18000, 0});
+    buffer.deleteLine();
+    cache.sync(buffer);
+    cache.stateAt(buffer, buffer.lineCount() - 1);
+    EXPECT_LT(highlighter.linesLexed, 20000u - 500u);
+    
+    highlighter.linesLexed = 0;
+    buffer.setCursor({15000, 0});
+    buffer.insertString("y");
+    cache.sync(buffer);
+    cache.stateAt(buffer, buffer.lineCount() - 1);
+    EXPECT_LE(highlighter.linesLexed, 2u);
+}
+
+TEST(HighlightCacheTest, MatchesFullLexAfterRandomEdits) {
+    CppHighlighter highlighter;
+    HighlightCache cache;
+    cache.setHighlighter(&highlighter);
+    Buffer buffer(repeatLines("a /* b", 20) + repeatLines("c */ d", 20) + repeatLines("e", 200));
+    std::mt19937 random(17);
+    const char* snippets[] = {"/*", "*/", "\n", "x\n/*\n", "*/\n\n", "// /*", "\"/*\""};
+    
+    for (int round = 0; round < 300; ++round) {
+        size_t line = random() % buffer.lineCount();
+        buffer.setCursor({line, random() % (buffer.lineLength(line) + 1)});
+        switch (random() % 4) {
+            case 0: buffer.deleteLine(); break;
+            case 1: buffer.deleteCharBefore(); break;
+            case 2: buffer.undo(); break;
+            default: buffer.insertString(snippets[random() % 7]); break;
+        }
+        
+        // Look at a few lines only, as the renderer does, most rounds
+        cache.sync(buffer);
+        if (round % 10 != 0) {
+            cache.stateAt(buffer, random() % buffer.lineCount());
+            continue;
+        }
+        
+        std::vector<HighlightState> expected = lexAll(buffer);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQ(cache.stateAt(buffer, i), expected[i]) << "round " << round << ", line " << i;
+        }
+    }
+}
+
+TEST(HighlightCacheTest, OtherBufferStartsOver) {
+    CppHighlighter highlighter;
+    HighlightCache cache;
+    cache.setHighlighter(&highlighter);
+    
+    Buffer comment("/*\n" + repeatLines("x", 10));
+    cache.sync(comment);
+    EXPECT_NE(cache.stateAt(comment, 5), 0u);
+    
+    Buffer plain(repeatLines("x", 10));
+    cache.sync(plain);
+    EXPECT_EQ(cache.stateAt(plain, 5), 0u);
+}
+
+TEST(HighlightCacheTest, UnchangedLinesComeFromTokenCache) {
+    CountingHighlighter highlighter;
+    HighlightCache cache;
+    cache.setHighlighter(&highlighter);
+    Buffer buffer(repeatLines("int x = 1;", 50) + "/*\n" + repeatLines("int x = 1;", 50));
+    cache.sync(buffer);
+    
+    TokenSpan first = cache.highlightLine(buffer, 10);
+    ASSERT_EQ(highlighter.linesHighlighted, 1u);
+    
+    // Same text and start state: no lexing, same tokens
+    TokenSpan again = cache.highlightLine(buffer, 20);
+    EXPECT_EQ(highlighter.linesHighlighted, 1u);
+    EXPECT_EQ(again.tokens, first.tokens);
+    
+    // Same text in a comment lexes differently
+    EXPECT_TRUE(isComment(cache.highlightLine(buffer, 80)));
+    EXPECT_EQ(highlighter.linesHighlighted, 2u);
+    
+    // An edited line is lexed again
+    buffer.setCursor({20, 0});
+    buffer.insertString("long ");
+    cache.sync(buffer);
+    TokenSpan edited = cache.highlightLine(buffer, 20);
+    EXPECT_EQ(highlighter.linesHighlighted, 3u);
+    ASSERT_GE(edited.size(), 2u);
+    EXPECT_EQ(edited[1].start, 5u);
+}
+
+// ============================================================================
+// TokenCache Tests
+// ============================================================================
+
+TEST(TokenCacheTest, StaysBounded) {
+    TokenCache cache;
+    std::vector<Token> tokens(3, Token{0, 1, TokenType::Keyword});
+    
+    for (size_t i = 0; i < TokenCache::MAX_LINES * 3; ++i) {
+        std::string line = "line " + std::to_string(i);
+        uint64_t hash = TokenCache::hashLine(line);
+        TokenSpan span = cache.insert(0, hash, line.size(), tokens);
+        EXPECT_EQ(span.size(), 3u);
+        
+        TokenSpan found;
+        ASSERT_TRUE(cache.find(0, hash, line.size(), found));
+        EXPECT_EQ(found.tokens, span.tokens);
+        EXPECT_FALSE(cache.find(1, hash, line.size(), found));
+        EXPECT_LE(cache.size(), TokenCache::MAX_LINES);
+    }
+    
+    // A line with more tokens than the arena holds is returned, not cached
+    std::vector<Token> huge(TokenCache::MAX_TOKENS + 1, Token{0, 1, TokenType::Number});
+    TokenSpan span = cache.insert(0, 42, 1, huge);
+    EXPECT_EQ(span.size(), huge.size());
+    TokenSpan found;
+    EXPECT_FALSE(cache.find(0, 42, 1, found));
+}
+
+// ============================================================================
+// HighlightWorker Tests
+// ============================================================================
+
+TEST(HighlightWorkerTest, LexesAheadOfRequestedLines) {
+    HighlightWorker worker(std::make_unique<CppHighlighter>());
+    Buffer buffer("/*\n" + repeatLines("int x;", 20000) + "*/\n" + repeatLines("int y;", 100));
+    worker.request(buffer, 19990, 20010);
+    
+    std::unique_ptr<HighlightResult> result = waitForResult(worker);
+    ASSERT_TRUE(result);
+    EXPECT_EQ(result->bufferId, buffer.id());
+    EXPECT_EQ(result->changeCount, buffer.changeCount());
+    
+    std::vector<HighlightState> expected = lexAll(buffer);
+    ASSERT_GE(result->states.size(), 20010u);
+    for (size_t i = 0; i < result->states.size(); ++i) {
+        ASSERT_EQ(result->states[i], expected[i]) << "line " << i;
+    }
+    
+    EXPECT_FALSE(result->covers(19989));
+    ASSERT_TRUE(result->covers(20050));
+    EXPECT_TRUE(isComment(result->lineTokens(19995)));
+    EXPECT_FALSE(isComment(result->lineTokens(20005)));
+    
+    // The same request again is not repeated
+    worker.request(buffer, 19990, 20010);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(worker.hasResult());
+}
+
+TEST(HighlightWorkerTest, FollowsEdits) {
+    HighlightWorker worker(std::make_unique<CppHighlighter>());
+    Buffer buffer(repeatLines("int x;", 5000));
+    worker.request(buffer, 4000, 4050);
+    ASSERT_TRUE(waitForResult(worker));
+    
+    // Several edits before the next request reach the worker together
+    buffer.setCursor({100, 0});
+    buffer.insertString("/*\n\n");
+    buffer.setCursor({3000, 0});
+    buffer.deleteLine();
+    worker.request(buffer, 4000, 4050);
+    
+    std::unique_ptr<HighlightResult> result = waitForResult(worker);
+    ASSERT_TRUE(result);
+    EXPECT_EQ(result->changeCount, buffer.changeCount());
+    EXPECT_TRUE(isComment(result->lineTokens(4000)));
+    
+    std::vector<HighlightState> expected = lexAll(buffer);
+    for (size_t i = 0; i < result->states.size(); ++i) {
+        ASSERT_EQ(result->states[i], expected[i]) << "line " << i;
+    }
+    
+    // A cache given the worker's states carries on from them
+    CppHighlighter highlighter;
+    HighlightCache cache;
+    cache.setHighlighter(&highlighter);
+    cache.sync(buffer);
+    cache.adopt(result->states);
+    EXPECT_GE(cache.validLines(), 4050u);
+    EXPECT_TRUE(isComment(cache.highlightLine(buffer, 4020)));
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include "astrax/input_decoder.h"
+#include <string>
+#include <vector>
+
+using namespace astrax;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+namespace {
+
+/// Decode every complete key in the decoder
+std::vector<KeyEvent> drain(InputDecoder& decoder, bool final = false) {
+    std::vector<KeyEvent> keys;
+    KeyEvent key;
+    while (decoder.next(key, final)) {
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+int special(SpecialKey key) { return static_cast<int>(key); }
+
+} // anonymous namespace
+
+// ============================================================================
+// InputDecoder Tests
+// ============================================================================
+
+TEST(InputDecoderTest, DecodesBatchOfKeys) {
+    InputDecoder decoder;
+    std::string input = "ab\r\x1b[A\x1b[3~\x1bOP\x7f\x12";
+    decoder.feed(input.data(), input.size());
+    
+    std::vector<KeyEvent> keys = drain(decoder);
+    ASSERT_EQ(keys.size(), 8u);
+    EXPECT_EQ(keys[0].key, 'a');
+    EXPECT_EQ(keys[1].key, 'b');
+    EXPECT_EQ(keys[2].key, special(SpecialKey::Enter));
+    EXPECT_EQ(keys[3].key, special(SpecialKey::Up));
+    EXPECT_EQ(keys[4].key, special(SpecialKey::Delete));
+    EXPECT_EQ(keys[5].key, special(SpecialKey::F1));
+    EXPECT_EQ(keys[6].key, special(SpecialKey::Backspace));
+    EXPECT_EQ(keys[7].key, 'r');
+    EXPECT_TRUE(keys[7].ctrl);
+    EXPECT_TRUE(decoder.empty());
+}
+
+TEST(InputDecoderTest, WaitsForSplitEscapeSequence) {
+    InputDecoder decoder;
+    decoder.feed("x\x1b[", 3);
+    
+    std::vector<KeyEvent> keys = drain(decoder);
+    ASSERT_EQ(keys.size(), 1u);
+    EXPECT_EQ(decoder.size(), 2u);  // Kept for the rest of the sequence
+    
+    decoder.feed("1;5B", 4);
+    keys = drain(decoder);
+    ASSERT_EQ(keys.size(), 1u);
+    EXPECT_EQ(keys[0].key, special(SpecialKey::Down));
+}
+
+TEST(InputDecoderTest, LoneEscapeIsEscapeKey) {
+    InputDecoder decoder;
+    decoder.feed("\x1b", 1);
+    EXPECT_TRUE(drain(decoder).empty());
+    
+    // Nothing followed in time
+    std::vector<KeyEvent> keys = drain(decoder, true);
+    ASSERT_EQ(keys.size(), 1u);
+    EXPECT_EQ(keys[0].key, special(SpecialKey::Escape));
+    
+    // Escape typed right before another key keeps that key
+    decoder.feed("\x1bj", 2);
+    keys = drain(decoder);
+    ASSERT_EQ(keys.size(), 2u);
+    EXPECT_EQ(keys[0].key, special(SpecialKey::Escape));
+    EXPECT_EQ(keys[1].key, 'j');
+}
+
+TEST(InputDecoderTest, RingWrapsAround) {
+    InputDecoder decoder;
+    std::string chunk(InputDecoder::CAPACITY - 2, 'a');
+    EXPECT_EQ(decoder.feed(chunk.data(), chunk.size()), chunk.size());
+    
+    // Free most of the front, then write a sequence across the end of the ring
+    KeyEvent key;
+    for (size_t i = 0; i + 2 < chunk.size(); ++i) {
+        ASSERT_TRUE(decoder.next(key));
+    }
+    EXPECT_EQ(decoder.feed("\x1b[C", 3), 3u);
+    
+    size_t space = 0;
+    decoder.writeSpace(space);
+    EXPECT_EQ(space, InputDecoder::CAPACITY - 5);  // From the wrapped tail up to the head
+    
+    std::vector<KeyEvent> keys = drain(decoder);
+    ASSERT_EQ(keys.size(), 3u);
+    EXPECT_EQ(keys[1].key, 'a');
+    EXPECT_EQ(keys[2].key, special(SpecialKey::Right));
+    
+    // A full ring takes no more
+    std::string big(InputDecoder::CAPACITY + 10, 'b');
+    EXPECT_EQ(decoder.feed(big.data(), big.size()), InputDecoder::CAPACITY);
+}
+
+TEST(InputDecoderTest, BracketedPasteIsOneEvent) {
+    InputDecoder decoder;
+    std::string input = "a\x1b[200~x\ry\x1b[Az\x1b[201~b";
+    decoder.feed(input.data(), input.size());
+    
+    std::vector<KeyEvent> keys = drain(decoder);
+    ASSERT_EQ(keys.size(), 3u);
+    EXPECT_EQ(keys[0].key, 'a');
+    EXPECT_EQ(keys[1].key, special(SpecialKey::Paste));
+    EXPECT_EQ(keys[2].key, 'b');
+    
+    // Escape sequences inside the paste are text
+    EXPECT_EQ(decoder.takePaste(), "x\ry\x1b[Az");
+}
+
+TEST(InputDecoderTest, LargePasteSpansManyReads) {
+    InputDecoder decoder;
+    decoder.feed("\x1b[200~", 6);
+    
+    // Far more than the ring holds, with the end marker split between reads
+    std::string chunk(1000, 'p');
+    KeyEvent key;
+    size_t total = 0;
+    for (int i = 0; i < 300; ++i) {
+        decoder.feed(chunk.data(), chunk.size());
+        total += chunk.size();
+        EXPECT_FALSE(decoder.next(key));
+    }
+    decoder.feed("\x1b[20", 4);
+    EXPECT_FALSE(decoder.next(key));
+    EXPECT_TRUE(decoder.pasting());
+    decoder.feed("1~", 2);
+    ASSERT_TRUE(decoder.next(key));
+    EXPECT_EQ(key.key, special(SpecialKey::Paste));
+    EXPECT_FALSE(decoder.pasting());
+    EXPECT_EQ(decoder.takePaste().size(), total);
+}
@@ -0,0 +1,242 @@
+#include <gtest/gtest.h>
+#include "astrax/journal.h"
+#include "astrax/buffer.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifndef ASTRAX_PLATFORM_WINDOWS
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace astrax;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+namespace {
+
+const char* const FILE_NAME = "astrax_journal_test.txt";
+
+void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream(path, std::ios::binary) << content;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+/// Replay a journal onto a freshly loaded buffer
+std::string recover(const std::string& path) {
+    std::vector<JournalRecord> records;
+    std::string error;
+    EXPECT_TRUE(Journal::read(path, records, error)) << error;
+    
+    Buffer buffer;
+    buffer.loadFromFile(path);
+    for (const auto& record : records) {
+        buffer.applyEdit(record.offset, record.removed, record.inserted);
+    }
+    return buffer.getContent();
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// Journal Tests
+// ============================================================================
+
+TEST(JournalTest, ReplayRestoresEdits) {
+    writeFile(FILE_NAME, "alpha\nbeta\n");
+    std::string expected;
+    {
+        Journal journal;
+        Buffer buffer;
+        buffer.loadFromFile(FILE_NAME);
+        journal.open(FILE_NAME);
+        buffer.setEditObserver([&](size_t offset, size_t removed, StringView inserted) {
+            journal.record(offset, removed, inserted);
+        });
+        
+        buffer.insertString("one ");
+        buffer.moveCursor(0, 1);
+        buffer.deleteCharAt();
+        buffer.insertNewline();
+        buffer.undo();
+        buffer.undo();
+        buffer.redo();
+        expected = buffer.getContent();
+        
+        // Destroyed without close(), as in a crash: the journal stays
+        journal.flush();
+    }
+    
+    ASSERT_TRUE(Journal::exists(FILE_NAME));
+    EXPECT_EQ(recover(FILE_NAME), expected);
+    
+    std::remove(Journal::pathFor(FILE_NAME).c_str());
+    std::remove(FILE_NAME);
+}
+
+TEST(JournalTest, TornRecordEndsTheLog) {
+    writeFile(FILE_NAME, "text");
+    {
+        Journal journal;
+        journal.open(FILE_NAME);
+        journal.record(0, 0, "first ");
+        journal.record(4, 2, "second");
+        journal.flush();
+    }
+    
+    // Cut the last record short
+    std::string path = Journal::pathFor(FILE_NAME);
+    std::string data = readFile(path);
+    writeFile(path, data.substr(0, data.size() - 3));
+    
+    std::vector<JournalRecord> records;
+    std::string error;
+    ASSERT_TRUE(Journal::read(FILE_NAME, records, error));
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].inserted, "first ");
+    
+    // A changed file no longer matches the logged offsets
+    writeFile(FILE_NAME, "other text");
+    EXPECT_FALSE(Journal::read(FILE_NAME, records, error));
+    
+    std::remove(path.c_str());
+    std::remove(FILE_NAME);
+}
+
+#ifndef ASTRAX_PLATFORM_WINDOWS
+TEST(JournalTest, KeepsTheFilePermissions) {
+    // The journal holds the file's text, so it is no more readable than it
+    writeFile(FILE_NAME, "secret");
+    chmod(FILE_NAME, 0600);
+    const std::string newFile = "astrax_journal_new_test.txt";
+    {
+        Journal journal;
+        journal.open(FILE_NAME);
+        journal.record(0, 0, "top ");
+        journal.flush();
+        
+        Journal fresh;
+        fresh.open(newFile);
+        fresh.record(0, 0, "new");
+        fresh.flush();
+    }
+    
+    struct stat st;
+    ASSERT_EQ(stat(Journal::pathFor(FILE_NAME).c_str(), &st), 0);
+    EXPECT_EQ(st.st_mode & 0777, 0600u);
+    ASSERT_EQ(stat(Journal::pathFor(newFile).c_str(), &st), 0);
+    EXPECT_EQ(st.st_mode & 0077, 0u);
+    
+    std::remove(Journal::pathFor(FILE_NAME).c_str());
+    std::remove(Journal::pathFor(newFile).c_str());
+    std::remove(FILE_NAME);
+}
+
+TEST(JournalTest, DoesNotFollowPlantedLinks) {
+    // A link planted at the journal's path must not redirect the writes
+    const std::string victim = "astrax_journal_victim_test.txt";
+    writeFile(victim, "keep me");
+    writeFile(FILE_NAME, "text");
+    std::string path = Journal::pathFor(FILE_NAME);
+    std::remove(path.c_str());
+    ASSERT_EQ(symlink(victim.c_str(), path.c_str()), 0);
+    {
+        Journal journal;
+        journal.open(FILE_NAME);
+        journal.record(0, 0, "edit ");
+        journal.flush();
+    }
+    EXPECT_EQ(readFile(victim), "keep me");
+    
+    struct stat st;
+    ASSERT_EQ(lstat(path.c_str(), &st), 0);
+    EXPECT_TRUE(S_ISREG(st.st_mode));
+    std::vector<JournalRecord> records;
+    std::string error;
+    ASSERT_TRUE(Journal::read(FILE_NAME, records, error)) << error;
+    EXPECT_EQ(records.size(), 1u);
+    
+    // A journal left with looser permissions is recreated with the file's
+    chmod(FILE_NAME, 0600);
+    chmod(path.c_str(), 0644);
+    {
+        Journal journal;
+        journal.open(FILE_NAME);
+        journal.record(0, 0, "again ");
+        journal.flush();
+    }
+    ASSERT_EQ(stat(path.c_str(), &st), 0);
+    EXPECT_EQ(st.st_mode & 0777, 0600u);
+    
+    std::remove(path.c_str());
+    std::remove(victim.c_str());
+    std::remove(FILE_NAME);
+}
+
+TEST(JournalTest, FailedWriteIsReportedAndRewritten) {
+    // The journal's directory is missing, so the first batch cannot be written
+    const std::string dir = "astrax_journal_dir_test";
+    const std::string file = dir + "/new.txt";
+    rmdir(dir.c_str());
+    Journal journal;
+    journal.open(file);
+    journal.record(0, 0, "first ");
+    journal.flush();
+    EXPECT_TRUE(journal.writeFailed());
+    
+    // The next batch writes the whole journal, earlier records included
+    ASSERT_EQ(mkdir(dir.c_str(), 0700), 0);
+    journal.record(6, 0, "second");
+    journal.flush();
+    EXPECT_FALSE(journal.writeFailed());
+    
+    std::vector<JournalRecord> records;
+    std::string error;
+    ASSERT_TRUE(Journal::read(file, records, error)) << error;
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].inserted, "first ");
+    EXPECT_EQ(records[1].inserted, "second");
+    
+    journal.close();
+    journal.flush();
+    rmdir(dir.c_str());
+}
+#endif
+
+TEST(JournalTest, SaveRebasesOntoSnapshot) {
+    writeFile(FILE_NAME, "base");
+    Journal journal;
+    journal.open(FILE_NAME);
+    journal.record(4, 0, "!");
+    journal.flush();
+    ASSERT_TRUE(Journal::exists(FILE_NAME));
+    
+    // A save of everything so far removes the journal
+    uint64_t mark = journal.mark();
+    writeFile(FILE_NAME, "base!");
+    journal.rebase(mark, FILE_NAME);
+    journal.flush();
+    EXPECT_FALSE(Journal::exists(FILE_NAME));
+    
+    // Edits made while a save runs stay journaled against the saved file
+    mark = journal.mark();
+    journal.record(5, 0, "?");
+    writeFile(FILE_NAME, "base!");
+    journal.rebase(mark, FILE_NAME);
+    journal.flush();
+    EXPECT_EQ(recover(FILE_NAME), "base!?");
+    
+    journal.close();
+    journal.flush();
+    EXPECT_FALSE(Journal::exists(FILE_NAME));
+    std::remove(FILE_NAME);
+}
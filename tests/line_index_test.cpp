@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include "astrax/line_index.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace astrax;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+namespace {
+
+/// Reference result computed one byte at a time
+std::vector<size_t> naiveNewlines(const std::string& text, size_t& crlf) {
+    std::vector<size_t> offsets;
+    crlf = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\n') {
+            offsets.push_back(i);
+            if (i > 0 && text[i - 1] == '\r') ++crlf;
+        }
+    }
+    return offsets;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// Line Index Tests
+// ============================================================================
+
+TEST(LineIndexTest, MatchesByteScan) {
+    std::mt19937 rng(7);
+    const char alphabet[] = {'a', 'b', '\n', '\r', ' '};
+    
+    // Sizes straddle the 64-byte vector blocks and the kernel block size
+    for (size_t size : {0u, 1u, 63u, 64u, 65u, 1000u, 65536u, 200003u}) {
+        std::string text(size, 'x');
+        for (auto& c : text) {
+            c = alphabet[rng() % sizeof(alphabet)];
+        }
+        
+        size_t crlf = 0;
+        std::vector<size_t> expected = naiveNewlines(text, crlf);
+        
+        LineIndex index;
+        index.build(text.data(), text.size());
+        ASSERT_EQ(index.size(), expected.size()) << "size " << size;
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQ(index[i], expected[i]);
+        }
+        EXPECT_EQ(index.stats().crlf, crlf);
+        EXPECT_EQ(countNewlines(text.data(), text.size()), expected.size());
+        
+        // Unaligned start
+        if (size > 1) {
+            EXPECT_EQ(countNewlines(text.data() + 1, size - 1),
+                      expected.size() - (text[0] == '\n' ? 1 : 0));
+        }
+    }
+}
+
+TEST(LineIndexTest, CrlfAcrossCalls) {
+    std::string text(64, 'a');
+    text[63] = '\r';
+    text += "\nrest\r\n";
+    
+    NewlineStats stats;
+    countNewlines(text.data(), 64, stats);
+    countNewlines(text.data() + 64, text.size() - 64, stats);
+    EXPECT_EQ(stats.newlines, 2u);
+    EXPECT_EQ(stats.crlf, 2u);
+    EXPECT_EQ(stats.lineEnding(), LineEnding::CRLF);
+}
+
+TEST(LineIndexTest, StripCarriageReturns) {
+    std::string text = "one\r\ntwo\nthree\r\n\r\nfour\rfive";
+    LineIndex index;
+    index.build(text.data(), text.size());
+    EXPECT_EQ(index.lineEnding(), LineEnding::CRLF);
+    
+    index.stripCarriageReturns(text);
+    EXPECT_EQ(text, "one\ntwo\nthree\n\nfour\rfive");
+    
+    size_t crlf = 0;
+    std::vector<size_t> expected = naiveNewlines(text, crlf);
+    ASSERT_EQ(index.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(index[i], expected[i]);
+    }
+}
+
+TEST(LineIndexTest, OffsetsBeyondFourGigabytes) {
+    const size_t GB = size_t(1) << 30;
+    if (sizeof(size_t) < 8) {
+        GTEST_SKIP() << "32-bit size_t";
+    }
+    
+    LineIndex index;
+    index.append(10);
+    index.append(4 * GB - 1);
+    index.append(9 * GB + 5);   // Skips the 4-8 GB segment entirely
+    index.append(9 * GB + 7);
+    
+    EXPECT_EQ(index[0], 10u);
+    EXPECT_EQ(index[1], 4 * GB - 1);
+    EXPECT_EQ(index[2], 9 * GB + 5);
+    EXPECT_EQ(index[3], 9 * GB + 7);
+    
+    EXPECT_EQ(index.lowerBound(0), 0u);
+    EXPECT_EQ(index.lowerBound(11), 1u);
+    EXPECT_EQ(index.lowerBound(4 * GB), 2u);
+    EXPECT_EQ(index.lowerBound(6 * GB), 2u);
+    EXPECT_EQ(index.lowerBound(9 * GB + 6), 3u);
+    EXPECT_EQ(index.lowerBound(20 * GB), 4u);
+    EXPECT_LE(index.memoryUsage(), 4 * sizeof(uint32_t) + 16 * sizeof(size_t));
+}
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include "astrax/match_cache.h"
+#include "astrax/buffer.h"
+#include "astrax/search.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace astrax;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+namespace {
+
+std::string repeatLines(const std::string& line, int count) {
+    std::string text;
+    for (int i = 0; i < count; ++i) {
+        text += line + "\n";
+    }
+    return text;
+}
+
+/// Expect the cached matches of lines [first, end) to be those of a fresh search
+void expectFreshMatches(const MatchCache& cache, const Buffer& buffer, const Search& search,
+                        size_t first, size_t end) {
+    for (size_t line = first; line < end && line < buffer.lineCount(); ++line) {
+        std::vector<LineMatch> expected;
+        search.matchLine(buffer.getLine(line), expected);
+        MatchSpan matches = cache.lineMatches(line);
+        ASSERT_EQ(matches.size(), expected.size()) << "line " << line;
+        for (size_t i = 0; i < expected.size(); ++i) {
+            EXPECT_EQ(matches[i].column, expected[i].column) << "line " << line;
+            EXPECT_EQ(matches[i].length, expected[i].length) << "line " << line;
+        }
+    }
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// MatchCache Tests
+// ============================================================================
+
+TEST(MatchCacheTest, SearchesOnlyAroundViewport) {
+    Buffer buffer(repeatLines("x foo y foo", 10000));
+    Search search;
+    search.setPattern("foo");
+    MatchCache cache;
+    
+    cache.prepare(buffer, search, 5000, 5030);
+    EXPECT_EQ(cache.searchedLines(), 30 + 2 * MatchCache::MARGIN_LINES);
+    
+    MatchSpan matches = cache.lineMatches(5010);
+    ASSERT_EQ(matches.size(), 2u);
+    EXPECT_EQ(matches[0].column, 2u);
+    EXPECT_EQ(matches[1].column, 8u);
+    EXPECT_EQ(matches[1].length, 3u);
+    EXPECT_TRUE(cache.lineMatches(100).empty());
+    
+    // Scrolling by a line searches the one line entering the margin
+    cache.prepare(buffer, search, 5001, 5031);
+    EXPECT_EQ(cache.searchedLines(), 30 + 2 * MatchCache::MARGIN_LINES + 1);
+    
+    // The margin is clipped to the text
+    MatchCache top;
+    top.prepare(buffer, search, 0, 30);
+    EXPECT_EQ(top.searchedLines(), 30 + MatchCache::MARGIN_LINES);
+}
+
+TEST(MatchCacheTest, EditsResearchOnlyChangedLines) {
+    Buffer buffer(repeatLines("x foo y foo", 10000));
+    Search search;
+    search.setPattern("foo");
+    MatchCache cache;
+    cache.prepare(buffer, search, 5000, 5030);
+    size_t searched = cache.searchedLines();
+    
+    // Typing in a line searches just that line again
+    buffer.setCursor({5010, 0});
+    buffer.insertString("foo ");
+    cache.prepare(buffer, search, 5000, 5030);
+    EXPECT_EQ(cache.searchedLines(), searched + 1);
+    EXPECT_EQ(cache.lineMatches(5010).size(), 3u);
+    searched = cache.searchedLines();
+    
+    // A line added far above moves the window's lines down with it
+    buffer.setCursor({10, 0});
+    buffer.insertNewline();
+    cache.prepare(buffer, search, 5001, 5031);
+    EXPECT_EQ(cache.searchedLines(), searched);
+    EXPECT_EQ(cache.lineMatches(5011).size(), 3u);
+    EXPECT_EQ(cache.lineMatches(5010).size(), 2u);
+    
+    // A new pattern searches the window again
+    searched = cache.searchedLines();
+    search.setPattern("y");
+    cache.prepare(buffer, search, 5001, 5031);
+    EXPECT_EQ(cache.searchedLines(), searched + 30 + 2 * MatchCache::MARGIN_LINES);
+    EXPECT_EQ(cache.lineMatches(5011).size(), 1u);
+    
+    // An invalid pattern has no matches
+    SearchOptions options;
+    options.useRegex = true;
+    search.setPattern("y(", options);
+    cache.prepare(buffer, search, 5001, 5031);
+    EXPECT_TRUE(cache.lineMatches(5011).empty());
+}
+
+TEST(MatchCacheTest, FollowsRandomEdits) {
+    std::mt19937 random(5);
+    std::string text;
+    for (int i = 0; i < 600; ++i) {
+        text += std::string(random() % 3, 'a') + (i % 3 == 0 ? " ab " : " b ") + "\n";
+    }
+    Buffer buffer(text);
+    SearchOptions options;
+    options.useRegex = true;
+    Search search;
+    search.setPattern("a+b?", options);
+    MatchCache cache;
+    
+    size_t top = 200;
+    for (int round = 0; round < 400; ++round) {
+        size_t line = random() % buffer.lineCount();
+        buffer.setCursor({line, random() % 3});
+        switch (random() % 6) {
+            case 0: buffer.insertString("ab"); break;
+            case 1: buffer.insertNewline(); break;
+            case 2: buffer.deleteLine(); break;
+            case 3: buffer.joinLines(); break;
+            case 4: buffer.insertString("a\nb\nab\n"); break;
+            case 5: buffer.undo(); break;
+        }
+        
+        // Now and then the view moves too
+        if (round % 7 == 0) {
+            top = random() % buffer.lineCount();
+        }
+        cache.prepare(buffer, search, top, top + 40);
+        expectFreshMatches(cache, buffer, search, top, top + 40);
+    }
+    
+    // Most rounds reused most of the window
+    EXPECT_LT(cache.searchedLines(), 400 * (40 + 2 * MatchCache::MARGIN_LINES) / 4);
+}
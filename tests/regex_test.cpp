@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+#include "astrax/regex.h"
+#include "astrax/search.h"
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace astrax;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+namespace {
+
+/// Leftmost match by std::regex, the engine Search used before
+bool oracleSearch(const std::string& pattern, bool caseSensitive, const std::string& text,
+                  size_t& start, size_t& length) {
+    std::regex::flag_type flags = std::regex::ECMAScript;
+    if (!caseSensitive) {
+        flags |= std::regex::icase;
+    }
+    std::smatch match;
+    if (!std::regex_search(text, match, std::regex(pattern, flags))) {
+        return false;
+    }
+    start = static_cast<size_t>(match.position());
+    length = static_cast<size_t>(match.length());
+    return true;
+}
+
+/// Expect the same match as std::regex from the start of every text
+void expectSameAsOracle(const std::string& pattern, bool caseSensitive,
+                        const std::vector<std::string>& texts) {
+    Regex regex;
+    std::string error;
+    ASSERT_TRUE(regex.compile(pattern, caseSensitive, error)) << pattern << ": " << error;
+    
+    for (const std::string& text : texts) {
+        size_t expectedStart = 0, expectedLength = 0;
+        bool expected = oracleSearch(pattern, caseSensitive, text, expectedStart, expectedLength);
+        size_t start = 0, length = 0;
+        bool found = regex.search(text, 0, start, length);
+        ASSERT_EQ(found, expected) << "/" << pattern << "/ on \"" << text << "\"";
+        if (expected) {
+            EXPECT_EQ(start, expectedStart) << "/" << pattern << "/ on \"" << text << "\"";
+            EXPECT_EQ(length, expectedLength) << "/" << pattern << "/ on \"" << text << "\"";
+        }
+    }
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// Matching
+// ============================================================================
+
+TEST(RegexTest, MatchesLikeStdRegex) {
+    std::vector<std::string> texts = {
+        "", "a", "ab", "abc", "aaa", "abab", "foo bar", "foo_bar42", "  int x = 10;",
+        "TODO: fix", "ERROR disk full", "0x1F 255 3.14", "a.b.c", "[x] {y} (z)",
+        "the cat sat", "tab\there", "AbC aBc ABC", "x=1;y=22;z=333", "$dollar^caret",
+    };
+    const char* patterns[] = {
+        "a", "abc", "a*", "a+", "a?b", "a*?b", "(ab)+", "(?:ab|a)+", "a|ab", "ab|a",
+        "[a-c]+", "[^a-c ]+", "\\d+", "\\D+", "\\w+", "\\W", "\\s+", "\\S+", "x{2}",
+        "\\d{2,}", "\\d{1,2}", "\\d{1,2}?", "^a", "c$", "^$", "^.*$", "\\bbar\\b", "\\Bar",
+        "foo.bar", "a.c", "\\.", "[.]", "\\[x\\]", "\\{y\\}", "\\(z\\)", "\\$dollar", "\\^",
+        "(a|b)*c", "(a*)*b", "[\\d.]+", "[-a]+", "[a-]+", "\\x41", "\\t",
+        "int|float", "E(RR|rr)OR", "[A-Z][a-z]+", "x=\\d+;", ".*?;", "(\\w+) (\\w+)",
+        "a{0}", "a{3,}", "[^]", "[]", "(?:)", "ab*?c?",
+    };
+    for (const char* pattern : patterns) {
+        expectSameAsOracle(pattern, true, texts);
+        expectSameAsOracle(pattern, false, texts);
+    }
+}
+
+TEST(RegexTest, MatchesStdRegexOnRandomText) {
+    std::mt19937 random(7);
+    const char alphabet[] = "abAB_ 1.";
+    std::vector<std::string> texts;
+    for (int i = 0; i < 200; ++i) {
+        std::string text;
+        size_t length = random() % 24;
+        for (size_t j = 0; j < length; ++j) {
+            text += alphabet[random() % (sizeof(alphabet) - 1)];
+        }
+        texts.push_back(text);
+    }
+    
+    const char* patterns[] = {
+        "ab", "a+b*", "(a|b)+1", "[ab]{2,3}", "b.a", "\\bab", "a\\B", "\\w+\\s", "^b|a$",
+        "(ab|a)(b|)", "a??b", "(a+|b+)*_", "[^ab]+", "1\\.?",
+    };
+    for (const char* pattern : patterns) {
+        expectSameAsOracle(pattern, true, texts);
+        expectSameAsOracle(pattern, false, texts);
+    }
+}
+
+TEST(RegexTest, AssertionsSeeTextBeforeStart) {
+    Regex regex;
+    std::string error;
+    size_t start, length;
+    
+    ASSERT_TRUE(regex.compile("^x", true, error));
+    EXPECT_TRUE(regex.search("xx", 0, start, length));
+    EXPECT_FALSE(regex.search("xx", 1, start, length));
+    
+    ASSERT_TRUE(regex.compile("\\bar", true, error));
+    EXPECT_FALSE(regex.search("bar", 1, start, length));
+    EXPECT_TRUE(regex.search("b ar", 1, start, length));
+    EXPECT_EQ(start, 2u);
+    
+    // Starting at the end still sees $
+    ASSERT_TRUE(regex.compile("$", true, error));
+    EXPECT_TRUE(regex.search("abc", 3, start, length));
+    EXPECT_EQ(start, 3u);
+    EXPECT_FALSE(regex.search("abc", 4, start, length));
+}
+
+TEST(RegexTest, RejectsUnsupportedPatterns) {
+    const char* invalid[] = {
+        "(", "a)", "[a", "*a", "a**", "+", "a{3,1}", "a{2000}", "\\1", "(?=a)", "(?!a)",
+        "(?<=a)", "a\\", "[z-a]", "\\q", "\\u00e9", "^*", "{2}",
+    };
+    Regex regex;
+    for (const char* pattern : invalid) {
+        std::string error;
+        EXPECT_FALSE(regex.compile(pattern, true, error)) << pattern;
+        EXPECT_FALSE(error.empty()) << pattern;
+        EXPECT_TRUE(regex.empty());
+    }
+    
+    // A brace that is no quantifier is a literal
+    std::string error;
+    size_t start, length;
+    ASSERT_TRUE(regex.compile("a{x}", true, error));
+    EXPECT_TRUE(regex.search("a{x}", 0, start, length));
+    EXPECT_EQ(length, 4u);
+}
+
+TEST(RegexTest, LiteralPrefixIsFound) {
+    Regex regex;
+    std::string error;
+    ASSERT_TRUE(regex.compile("ERROR:\\s+\\w+", false, error));
+    EXPECT_EQ(regex.prefix().size(), 6u);
+    
+    size_t start, length;
+    std::string text = std::string(5000, 'x') + "error:  disk";
+    ASSERT_TRUE(regex.search(text, 0, start, length));
+    EXPECT_EQ(start, 5000u);
+    EXPECT_EQ(length, 12u);
+    
+    ASSERT_TRUE(regex.compile("a|b", true, error));
+    EXPECT_TRUE(regex.prefix().empty());
+    ASSERT_TRUE(regex.compile("^ab", true, error));
+    EXPECT_TRUE(regex.prefix().empty());
+}
+
+TEST(RegexTest, PathologicalPatternsRunInLinearTime) {
+    // Each of these takes exponential time with a backtracking matcher
+    Regex regex;
+    std::string error;
+    size_t start, length;
+    std::string text(20000, 'a');
+    
+    const char* patterns[] = {"(a*)*b", "(a|a)*b", "(a+a+)+b", "(a|aa)+$b"};
+    for (const char* pattern : patterns) {
+        ASSERT_TRUE(regex.compile(pattern, true, error)) << pattern;
+        EXPECT_FALSE(regex.search(text, 0, start, length)) << pattern;
+    }
+    
+    ASSERT_TRUE(regex.compile("(a+a+)+", true, error));
+    ASSERT_TRUE(regex.search(text, 0, start, length));
+    EXPECT_EQ(length, text.size());
+}
+
+TEST(RegexTest, DfaCacheOverflowKeepsResults) {
+    // The DFA for "an a 13 bytes before the end" needs 2^13 states, more
+    // than the cache holds, so searches start over and fall back to the NFA
+    Regex regex;
+    std::string error;
+    ASSERT_TRUE(regex.compile("(a|b)*a(a|b){12}c", true, error));
+    
+    std::mt19937 random(3);
+    for (int i = 0; i < 40; ++i) {
+        std::string text;
+        for (int j = 0; j < 3000; ++j) {
+            text += "ab"[random() % 2];
+        }
+        if (i % 2 == 0) {
+            text += 'c';
+        }
+        
+        // Only a whole text ending in c can match
+        bool expected = text.back() == 'c' && text[text.size() - 14] == 'a';
+        size_t start = 0, length = 0;
+        ASSERT_EQ(regex.search(text, 0, start, length), expected) << "text " << i;
+        if (expected) {
+            EXPECT_EQ(start, 0u);
+            EXPECT_EQ(length, text.size());
+        }
+    }
+}
+
+// ============================================================================
+// Search Integration
+// ============================================================================
+
+TEST(RegexTest, SearchUsesRegexEverywhere) {
+    SearchOptions options;
+    options.useRegex = true;
+    options.caseSensitive = true;
+    Search search;
+    search.setPattern("x\\d+", options);
+    ASSERT_TRUE(search.isPatternValid());
+    
+    std::vector<std::string> lines = {"x1 x22", "none", "ax333"};
+    std::vector<SearchMatch> all = search.findAll(lines);
+    ASSERT_EQ(all.size(), 3u);
+    EXPECT_EQ(all[1].position, (Position{0, 3}));
+    EXPECT_EQ(all[1].text, "x22");
+    EXPECT_EQ(all[2].text, "x333");
+    
+    SearchMatch next = search.findNext(lines, {0, 0});
+    ASSERT_TRUE(next);
+    EXPECT_EQ(next.position, (Position{0, 3}));
+    
+    // Backward search matches the regex too, not its text
+    SearchMatch previous = search.findPrevious(lines, {1, 2});
+    ASSERT_TRUE(previous);
+    EXPECT_EQ(previous.position, (Position{0, 3}));
+    EXPECT_EQ(previous.length, 3u);
+    
+    // Searching from past the end of a line finds nothing there
+    EXPECT_EQ(search.findNext(lines, {0, 6}).position, (Position{2, 1}));
+    
+    search.setPattern("x(", options);
+    EXPECT_FALSE(search.isPatternValid());
+    EXPECT_FALSE(search.getError().empty());
+}
@@ -0,0 +1,362 @@
+#include <gtest/gtest.h>
+#include "astrax/renderer.h"
+#include "astrax/buffer.h"
+#include "astrax/search.h"
+#include "astrax/syntax/cpp_highlighter.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace astrax;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+namespace {
+
+/**
+ * @brief Terminal that keeps a screen image and counts the bytes sent to it
+ *
+ * Escape sequences are counted at their ANSI length so tests can compare
+ * the cost of frames. A multi-byte UTF-8 character fills one cell, as it
+ * does on a real terminal.
+ */
+class RecordingTerminal : public ITerminal {
+public:
+    RecordingTerminal(int width, int height)
+        : width_(width), height_(height), screen_(static_cast<size_t>(height), blankRow()),
+          pens_(static_cast<size_t>(height), std::vector<Pen>(static_cast<size_t>(width))) {}
+    
+    void enableRawMode() override {}
+    void disableRawMode() override {}
+    
+    void clearScreen() override {
+        for (auto& row : screen_) row = blankRow();
+        for (auto& row : pens_) row.assign(static_cast<size_t>(width_), pen_);
+        x_ = y_ = 0;
+        bytes += 7;
+    }
+    void clearToEndOfScreen() override { bytes += 3; }
+    void clearToEndOfLine() override {
+        if (inside()) std::fill(screen_[static_cast<size_t>(y_)].begin() + x_, screen_[static_cast<size_t>(y_)].end(), " ");
+        bytes += 3;
+    }
+    void setCursor(int x, int y) override {
+        x_ = x;
+        y_ = y;
+        bytes += 6;
+    }
+    void hideCursor() override { bytes += 6; }
+    void showCursor() override { bytes += 6; }
+    Size getSize() override { return {width_, height_}; }
+    bool scrollRows(int top, int bottom, int lines) override {
+        for (int i = 0; i < (lines > 0 ? lines : -lines); ++i) {
+            if (lines > 0) {
+                screen_.erase(screen_.begin() + top);
+                screen_.insert(screen_.begin() + bottom, blankRow());
+                pens_.erase(pens_.begin() + top);
+                pens_.insert(pens_.begin() + bottom, std::vector<Pen>(static_cast<size_t>(width_)));
+            } else {
+                screen_.erase(screen_.begin() + bottom);
+                screen_.insert(screen_.begin() + top, blankRow());
+                pens_.erase(pens_.begin() + bottom);
+                pens_.insert(pens_.begin() + top, std::vector<Pen>(static_cast<size_t>(width_)));
+            }
+        }
+        bytes += 12;
+        ++scrolls;
+        return true;
+    }
+    
+    void write(const std::string& text) override {
+        for (char c : text) writeChar(c);
+    }
+    void writeChar(char c) override {
+        ++bytes;
+        ++textBytes;
+        
+        // A continuation byte extends the character before it
+        if ((static_cast<unsigned char>(c) & 0xC0) == 0x80 && x_ > 0) {
+            --x_;
+            if (inside()) screen_[static_cast<size_t>(y_)][static_cast<size_t>(x_)] += c;
+            ++x_;
+            return;
+        }
+        if (inside()) {
+            screen_[static_cast<size_t>(y_)][static_cast<size_t>(x_)] = std::string(1, c);
+            pens_[static_cast<size_t>(y_)][static_cast<size_t>(x_)] = pen_;
+        }
+        ++x_;
+    }
+    void flush() override { ++flushes; }
+    void beginSynchronizedUpdate() override { bytes += 8; ++syncDepth; }
+    void endSynchronizedUpdate() override { bytes += 8; --syncDepth; }
+    
+    void setPen(const Pen& pen) override {
+        if (pen == pen_) return;
+        pen_ = pen;
+        bytes += 8;
+        ++penChanges;
+    }
+    void setColor(Color, Color) override { bytes += 8; }
+    void resetColor() override { bytes += 4; }
+    void setBold(bool) override { bytes += 4; }
+    void setUnderline(bool) override { bytes += 4; }
+    
+    KeyEvent readKey() override { return KeyEvent(); }
+    bool hasKey() override { return false; }
+    bool hasBufferedKey() override { return false; }
+    std::string takePaste() override { return std::string(); }
+    bool waitForKey(int) override { return false; }
+    void setTitle(const std::string&) override {}
+    void openExternalWindow(const std::string&) override {}
+    
+    /// Text shown on a screen row, without trailing blanks
+    std::string row(int y) const {
+        std::string text;
+        for (const auto& cell : screen_[static_cast<size_t>(y)]) text += cell;
+        return text.substr(0, text.find_last_not_of(' ') + 1);
+    }
+    
+    /// Pen a screen cell was last written with
+    const Pen& penAt(int x, int y) const { return pens_[static_cast<size_t>(y)][static_cast<size_t>(x)]; }
+    
+    size_t bytes = 0;
+    size_t textBytes = 0;
+    int flushes = 0;
+    int penChanges = 0;
+    int scrolls = 0;
+    int syncDepth = 0;
+    
+private:
+    int width_;
+    int height_;
+    std::vector<std::vector<std::string>> screen_;   // Bytes shown in each cell
+    std::vector<std::vector<Pen>> pens_;
+    int x_ = 0;
+    int y_ = 0;
+    Pen pen_;
+    
+    bool inside() const { return y_ >= 0 && y_ < height_ && x_ >= 0 && x_ < width_; }
+    std::vector<std::string> blankRow() const { return std::vector<std::string>(static_cast<size_t>(width_), " "); }
+};
+
+std::string numberedLines(int count) {
+    std::string text;
+    for (int i = 0; i < count; ++i) {
+        text += "line number " + std::to_string(i + 1) + "\n";
+    }
+    return text;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// Renderer Tests
+// ============================================================================
+
+TEST(RendererTest, FirstFrameDrawsEverything) {
+    RecordingTerminal terminal(60, 20);
+    Renderer renderer(terminal);
+    Buffer buffer(numberedLines(5));
+    
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_EQ(terminal.flushes, 1);
+    EXPECT_EQ(terminal.syncDepth, 0);  // Frame bracketing is balanced
+    EXPECT_EQ(terminal.row(0), "   1 line number 1");
+    EXPECT_EQ(terminal.row(4), "   5 line number 5");
+    EXPECT_EQ(terminal.row(5), "~");
+}
+
+TEST(RendererTest, CursorMoveSendsNoCells) {
+    RecordingTerminal terminal(200, 60);
+    Renderer renderer(terminal);
+    Buffer buffer(numberedLines(100));
+    renderer.render(buffer, EditorMode::Normal);
+    
+    // Only the position in the status bar changes
+    terminal.bytes = 0;
+    terminal.textBytes = 0;
+    buffer.moveCursor(1, 0);
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_LE(terminal.textBytes, 2u);
+    EXPECT_LT(terminal.bytes, 64u);
+    
+    // Nothing changed at all: just the cursor position
+    terminal.bytes = 0;
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_EQ(terminal.bytes, 6u);
+}
+
+TEST(RendererTest, EditRepaintsOnlyChangedCells) {
+    RecordingTerminal terminal(80, 24);
+    Renderer renderer(terminal);
+    Buffer buffer(numberedLines(10));
+    renderer.render(buffer, EditorMode::Normal);
+    
+    terminal.textBytes = 0;
+    buffer.setCursor({2, 0});
+    buffer.deleteLine();
+    renderer.render(buffer, EditorMode::Normal);
+    
+    EXPECT_EQ(terminal.row(2), "   3 line number 4");
+    EXPECT_EQ(terminal.row(8), "   9 line number 10");
+    EXPECT_EQ(terminal.row(9), "~");
+    EXPECT_EQ(terminal.row(21), "~");
+    
+    // Line numbers and most of the text are unchanged cells
+    EXPECT_LT(terminal.textBytes, 120u);
+}
+
+TEST(RendererTest, EditKeepsMultiByteLinesAligned) {
+    RecordingTerminal terminal(80, 24);
+    Renderer renderer(terminal);
+    Buffer buffer("café crème brûlée\nnaïve résumé\nplain ascii\nmore ascii\n");
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_EQ(terminal.row(0), "   1 café crème brûlée");
+    
+    // Cells after a multi-byte character are one column left of their byte
+    buffer.setCursor({0, 8});
+    buffer.insertString("XY");
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_EQ(terminal.row(0), "   1 café crXYème brûlée");
+    
+    // A row losing its multi-byte characters, and one gaining them
+    buffer.setCursor({1, 0});
+    buffer.deleteLine();
+    buffer.setCursor({2, 0});
+    buffer.insertString("à ");
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_EQ(terminal.row(0), "   1 café crXYème brûlée");
+    EXPECT_EQ(terminal.row(1), "   2 plain ascii");
+    EXPECT_EQ(terminal.row(2), "   3 à more ascii");
+    EXPECT_EQ(terminal.row(3), "~");
+    
+    // Rows with only ASCII are still repainted cell by cell
+    terminal.textBytes = 0;
+    buffer.setCursor({1, 6});
+    buffer.insertChar('z');
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_EQ(terminal.row(1), "   2 plain zascii");
+    EXPECT_LT(terminal.textBytes, 16u);
+}
+
+TEST(RendererTest, PenChangesOnlyBetweenColors) {
+    RecordingTerminal terminal(60, 20);
+    Renderer renderer(terminal);
+    Buffer buffer(numberedLines(5));
+    renderer.render(buffer, EditorMode::Normal);
+    
+    // Line number and text per line, one run of tildes, mode and status bar
+    EXPECT_LE(terminal.penChanges, 5 * 2 + 1 + 2);
+    
+    // A theme change repaints in the new colors
+    Theme theme;
+    theme.lineNumber = {Color::Green, Color::Default};
+    renderer.setTheme(theme);
+    terminal.penChanges = 0;
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_GT(terminal.penChanges, 0);
+    EXPECT_EQ(terminal.row(0), "   1 line number 1");
+}
+
+TEST(RendererTest, ScrollShiftsLinesOnScreen) {
+    RecordingTerminal terminal(80, 24);
+    Renderer renderer(terminal);
+    
+    // Lines of unrelated text, so a shifted screen differs in every cell
+    std::string text;
+    for (int i = 0; i < 100; ++i) {
+        text += std::string(static_cast<size_t>(20 + i % 30), static_cast<char>('a' + i % 26)) + "\n";
+    }
+    Buffer buffer(text);
+    renderer.render(buffer, EditorMode::Normal);
+    
+    // Moving below the last visible line scrolls by one
+    buffer.setCursor({22, 0});
+    terminal.textBytes = 0;
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_EQ(terminal.scrolls, 1);
+    EXPECT_EQ(terminal.row(0), "   2 " + std::string(21, 'b'));
+    EXPECT_EQ(terminal.row(21), "  23 " + std::string(42, 'w'));
+    EXPECT_LT(terminal.textBytes, 100u);
+    
+    // And back up
+    buffer.setCursor({0, 0});
+    terminal.textBytes = 0;
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_EQ(terminal.scrolls, 2);
+    EXPECT_EQ(terminal.row(0), "   1 " + std::string(20, 'a'));
+    EXPECT_EQ(terminal.row(21), "  22 " + std::string(41, 'v'));
+    EXPECT_LT(terminal.textBytes, 100u);
+}
+
+TEST(RendererTest, FarLinesWaitForHighlightWorker) {
+    RecordingTerminal terminal(80, 24);
+    Renderer renderer(terminal);
+    renderer.setHighlighter(std::make_unique<CppHighlighter>());
+    
+    std::string text = "/* a comment that never ends\n";
+    for (int i = 0; i < 50000; ++i) {
+        text += "int x = 1;\n";
+    }
+    Buffer buffer(text);
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_FALSE(renderer.awaitingHighlights());
+    
+    // Too far down to lex while drawing: plain text first
+    buffer.setCursor({40000, 0});
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_TRUE(renderer.awaitingHighlights());
+    EXPECT_EQ(terminal.row(0), " 39980 int x = 1;");
+    
+    for (int i = 0; i < 5000 && !renderer.highlightsArrived(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_TRUE(renderer.highlightsArrived());
+    
+    // Then the same lines in comment color
+    terminal.penChanges = 0;
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_FALSE(renderer.awaitingHighlights());
+    EXPECT_GT(terminal.penChanges, 0);
+    EXPECT_EQ(terminal.row(0), " 39980 int x = 1;");
+}
+
+TEST(RendererTest, SearchMatchesDrawOverSyntaxColors) {
+    RecordingTerminal terminal(60, 20);
+    Renderer renderer(terminal);
+    renderer.setHighlighter(std::make_unique<CppHighlighter>());
+    Buffer buffer("int count = 0;\nreturn count + count;\n");
+    
+    SearchOptions options;
+    options.caseSensitive = true;
+    Search search;
+    search.setPattern("count", options);
+    renderer.setSearch(&search);
+    buffer.setCursor({1, 9});
+    renderer.render(buffer, EditorMode::Normal);
+    
+    // Text starts after 4 columns of line number and a separator
+    Theme theme;
+    Pen match(theme.searchMatch.foreground, theme.searchMatch.background);
+    Pen current(theme.searchCurrent.foreground, theme.searchCurrent.background);
+    Pen keyword(theme.keyword.foreground, theme.keyword.background);
+    EXPECT_EQ(terminal.penAt(5 + 4, 0), match);
+    EXPECT_EQ(terminal.penAt(5 + 8, 0), match);
+    EXPECT_EQ(terminal.penAt(5 + 7, 1), current);   // The match under the cursor
+    EXPECT_EQ(terminal.penAt(5 + 11, 1), current);
+    EXPECT_EQ(terminal.penAt(5 + 15, 1), match);
+    EXPECT_EQ(terminal.penAt(5, 1), keyword);       // Syntax colors around them
+    EXPECT_NE(terminal.penAt(5 + 9, 0), match);
+    EXPECT_EQ(terminal.row(1), "   2 return count + count;");
+    
+    // Without a search the syntax colors come back
+    renderer.setSearch(nullptr);
+    renderer.render(buffer, EditorMode::Normal);
+    EXPECT_NE(terminal.penAt(5 + 4, 0), match);
+    EXPECT_NE(terminal.penAt(5 + 7, 1), current);
+}
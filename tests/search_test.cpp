@@ -0,0 +1,346 @@
+#include <gtest/gtest.h>
+#include "astrax/search.h"
+#include "astrax/search_worker.h"
+#include <cctype>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace astrax;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+namespace {
+
+/// Byte-by-byte comparison, as Search did before it had a literal engine
+bool naiveMatchesAt(const std::string& line, size_t pos, const std::string& pattern, bool caseSensitive) {
+    if (pos + pattern.size() > line.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        char a = line[pos + i];
+        char b = pattern[i];
+        if (!caseSensitive) {
+            a = static_cast<char>(std::tolower(static_cast<unsigned char>(a)));
+            b = static_cast<char>(std::tolower(static_cast<unsigned char>(b)));
+        }
+        if (a != b) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Every match position, overlapping ones included
+std::vector<Position> naiveFindAll(const std::vector<std::string>& lines, const std::string& pattern,
+                                   bool caseSensitive) {
+    std::vector<Position> positions;
+    for (size_t line = 0; line < lines.size(); ++line) {
+        for (size_t col = 0; col + pattern.size() <= lines[line].size(); ++col) {
+            if (naiveMatchesAt(lines[line], col, pattern, caseSensitive)) {
+                positions.push_back({line, col});
+            }
+        }
+    }
+    return positions;
+}
+
+/// Random text over a small alphabet, so matches are frequent
+std::string randomText(std::mt19937& random, size_t length) {
+    static const char ALPHABET[] = "abAB_\t.x";
+    std::string text;
+    for (size_t i = 0; i < length; ++i) {
+        text += ALPHABET[random() % (sizeof(ALPHABET) - 1)];
+    }
+    return text;
+}
+
+/// count lines of filler, with "gamma" on every line that is a multiple of step
+std::string gammaLines(size_t count, size_t step) {
+    std::string text;
+    for (size_t line = 0; line < count; ++line) {
+        text += line % step == 0 ? "beta gamma\n" : "alpha beta\n";
+    }
+    return text;
+}
+
+/// Poll the worker until its latest search is counted, giving up after a few seconds
+SearchProgress waitForCount(SearchWorker& worker) {
+    SearchProgress progress;
+    for (int i = 0; i < 5000 && !progress.countDone; ++i) {
+        if (!worker.poll(progress)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    return progress;
+}
+
+} // anonymous namespace
+
+// ============================================================================
+// LiteralSearcher Tests
+// ============================================================================
+
+TEST(LiteralSearcherTest, FindsEveryMatchInLongText) {
+    std::string text(100000, 'x');
+    for (size_t pos : {0u, 31u, 32u, 4095u, 50000u, 99993u}) {
+        text.replace(pos, 7, "NEEDLE!");
+    }
+    
+    LiteralSearcher exact("NEEDLE!", true);
+    LiteralSearcher folded("needle!", false);
+    
+    for (const LiteralSearcher* searcher : {&exact, &folded}) {
+        std::vector<size_t> found;
+        for (size_t pos = searcher->find(text); pos != LiteralSearcher::npos; pos = searcher->find(text, pos + 1)) {
+            found.push_back(pos);
+        }
+        // 31 and 32 overlap the match before them, so they replaced it
+        EXPECT_EQ(found, std::vector<size_t>({0, 32, 4095, 50000, 99993}));
+    }
+    
+    EXPECT_EQ(LiteralSearcher("needle!", true).find(text), LiteralSearcher::npos);
+    EXPECT_EQ(exact.find(text, 99994), LiteralSearcher::npos);
+    EXPECT_EQ(exact.find(text, 200000), LiteralSearcher::npos);
+    EXPECT_EQ(LiteralSearcher("", true).find(text), LiteralSearcher::npos);
+}
+
+TEST(LiteralSearcherTest, MatchesNaiveSearchOnRandomText) {
+    std::mt19937 random(21);
+    for (int round = 0; round < 400; ++round) {
+        std::string text = randomText(random, random() % 300);
+        std::string pattern = randomText(random, 1 + random() % 5);
+        bool caseSensitive = (round % 2) == 0;
+        LiteralSearcher searcher(pattern, caseSensitive);
+        
+        size_t from = 0;
+        for (size_t col = 0; col + pattern.size() <= text.size(); ++col) {
+            if (naiveMatchesAt(text, col, pattern, caseSensitive)) {
+                ASSERT_EQ(searcher.find(text, from), col) << "pattern " << pattern << " in " << text;
+                from = col + 1;
+            }
+        }
+        ASSERT_EQ(searcher.find(text, from), LiteralSearcher::npos) << "pattern " << pattern << " in " << text;
+    }
+}
+
+// ============================================================================
+// Search Tests
+// ============================================================================
+
+TEST(SearchTest, FindAllMatchesNaiveSearch) {
+    std::mt19937 random(7);
+    std::vector<std::string> lines;
+    for (int i = 0; i < 200; ++i) {
+        lines.push_back(randomText(random, random() % 120));
+    }
+    
+    for (const char* pattern : {"a", "aB", "x.x", "b_\ta", "ABAB"}) {
+        for (bool caseSensitive : {true, false}) {
+            SearchOptions options;
+            options.caseSensitive = caseSensitive;
+            Search search;
+            search.setPattern(pattern, options);
+            
+            std::vector<Position> expected = naiveFindAll(lines, pattern, caseSensitive);
+            std::vector<SearchMatch> matches = search.findAll(lines);
+            ASSERT_EQ(matches.size(), expected.size()) << pattern;
+            for (size_t i = 0; i < matches.size(); ++i) {
+                ASSERT_EQ(matches[i].position, expected[i]) << pattern;
+                ASSERT_TRUE(naiveMatchesAt(matches[i].text, 0, pattern, caseSensitive));
+            }
+        }
+    }
+}
+
+TEST(SearchTest, NextAndPreviousFollowMatchOrder) {
+    std::vector<std::string> lines = {"foo bar foo", "", "BAR", "xfoofoo"};
+    Search search;
+    search.setPattern("foo");
+    
+    EXPECT_EQ(search.findNext(lines, {0, 0}).position, Position({0, 8}));
+    EXPECT_EQ(search.findNext(lines, {0, 8}).position, Position({3, 1}));
+    EXPECT_EQ(search.findNext(lines, {3, 1}).position, Position({3, 4}));
+    EXPECT_EQ(search.findNext(lines, {3, 4}).position, Position({0, 0}));  // Wrapped
+    
+    EXPECT_EQ(search.findPrevious(lines, {3, 4}).position, Position({3, 1}));
+    EXPECT_EQ(search.findPrevious(lines, {3, 1}).position, Position({0, 8}));
+    EXPECT_EQ(search.findPrevious(lines, {0, 8}).position, Position({0, 0}));
+    EXPECT_EQ(search.findPrevious(lines, {0, 0}).position, Position({0, 8}));
+    
+    // Case folding keeps the text as found
+    search.setPattern("bar");
+    SearchMatch match = search.findNext(lines, {0, 4});
+    EXPECT_EQ(match.position, Position({2, 0}));
+    EXPECT_EQ(match.text, "BAR");
+    
+    SearchOptions exact;
+    exact.caseSensitive = true;
+    search.setPattern("bar", exact);
+    EXPECT_EQ(search.findNext(lines, {0, 0}).position, Position({0, 4}));
+    EXPECT_FALSE(search.findNext(lines, {0, 4}));
+}
+
+TEST(SearchTest, ParallelScansMatchSerialOrder) {
+    // Enough lines to split across threads, with a few long ones
+    std::mt19937 random(11);
+    std::vector<std::string> lines;
+    std::string text;
+    for (size_t i = 0; i < Search::PARALLEL_MIN_LINES * 3; ++i) {
+        lines.push_back(randomText(random, random() % (i % 1000 == 0 ? 2000 : 40)));
+        text += lines.back();
+        text += '\n';
+    }
+    text.pop_back();
+    
+    // The table gets edits so some lines span pieces
+    PieceTable table(text);
+    std::vector<std::string> edited = lines;
+    for (size_t line = 5; line < lines.size(); line += 997) {
+        table.insert(table.lineStart(line), "aB");
+        edited[line].insert(0, "aB");
+    }
+    
+    for (const char* pattern : {"aB", "x.x", "[ab]_\\t?"}) {
+        for (bool useRegex : {false, true}) {
+            SearchOptions options;
+            options.useRegex = useRegex;
+            Search search;
+            search.setPattern(pattern, options);
+            
+            std::vector<Position> expected;
+            for (size_t line = 0; line < edited.size(); ++line) {
+                for (const SearchMatch& match : search.findAll(std::vector<std::string>{edited[line]})) {
+                    expected.push_back({line, match.position.column});
+                }
+            }
+            
+            std::vector<SearchMatch> fromTable = search.findAll(table);
+            ASSERT_EQ(fromTable.size(), expected.size()) << pattern;
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQ(fromTable[i].position, expected[i]) << pattern;
+            }
+            EXPECT_EQ(search.findAll(edited).size(), expected.size()) << pattern;
+            EXPECT_EQ(search.countMatches(table), expected.size()) << pattern;
+            EXPECT_EQ(search.countMatches(edited), expected.size()) << pattern;
+        }
+    }
+}
+
+TEST(SearchTest, TableSearchesMatchLineSearches) {
+    std::vector<std::string> lines = {"foo bar foo", "", "BAR", "xfoofoo"};
+    PieceTable table("foo bar foo\n\nBAR\nxfoofoo");
+    
+    for (const char* pattern : {"foo", "f.o", "bar"}) {
+        for (bool useRegex : {false, true}) {
+            SearchOptions options;
+            options.useRegex = useRegex;
+            Search search;
+            search.setPattern(pattern, options);
+            
+            for (size_t line = 0; line < lines.size(); ++line) {
+                for (size_t col = 0; col <= lines[line].size() + 1; ++col) {
+                    SearchMatch next = search.findNext(table, {line, col});
+                    SearchMatch expectedNext = search.findNext(lines, {line, col});
+                    ASSERT_EQ(next.valid, expectedNext.valid) << pattern;
+                    EXPECT_EQ(next.position, expectedNext.position) << pattern;
+                    EXPECT_EQ(next.text, expectedNext.text) << pattern;
+                    
+                    SearchMatch previous = search.findPrevious(table, {line, col});
+                    SearchMatch expectedPrevious = search.findPrevious(lines, {line, col});
+                    ASSERT_EQ(previous.valid, expectedPrevious.valid) << pattern;
+                    EXPECT_EQ(previous.position, expectedPrevious.position) << pattern;
+                }
+            }
+        }
+    }
+    
+    // Matches blocks apart are found going either way, and by wrapping
+    PieceTable spread(gammaLines(Search::BLOCK_LINES * 3, Search::BLOCK_LINES * 2 + 7));
+    Search search;
+    search.setPattern("gamma");
+    EXPECT_EQ(search.findNext(spread, {1, 0}).position, (Position{Search::BLOCK_LINES * 2 + 7, 5}));
+    EXPECT_EQ(search.findNext(spread, {Search::BLOCK_LINES * 2 + 8, 0}).position, (Position{0, 5}));
+    EXPECT_EQ(search.findPrevious(spread, {Search::BLOCK_LINES * 2 + 6, 3}).position, (Position{0, 5}));
+    EXPECT_EQ(search.findPrevious(spread, {0, 2}).position, (Position{Search::BLOCK_LINES * 2 + 7, 5}));
+}
+
+TEST(SearchTest, CancelledTableScansStopEarly) {
+    PieceTable table(gammaLines(Search::PARALLEL_MIN_LINES * 2, 3));
+    Search search;
+    search.setPattern("gamma");
+    
+    CancelFlag cancel{true};
+    EXPECT_FALSE(search.findNext(table, {1, 0}, &cancel));
+    EXPECT_FALSE(search.findPrevious(table, {1, 0}, &cancel));
+    EXPECT_EQ(search.countMatches(table, &cancel), 0u);
+    
+    cancel.store(false);
+    EXPECT_EQ(search.findNext(table, {1, 0}, &cancel).position, (Position{3, 5}));
+    EXPECT_EQ(search.findPrevious(table, {1, 0}, &cancel).position, (Position{0, 5}));
+    EXPECT_EQ(search.countMatches(table, &cancel), (Search::PARALLEL_MIN_LINES * 2 + 2) / 3);
+}
+
+// ============================================================================
+// SearchWorker Tests
+// ============================================================================
+
+TEST(SearchWorkerTest, FindsMatchThenCounts) {
+    SearchWorker worker;
+    Buffer buffer(gammaLines(50000, 1000));
+    SearchOptions options;
+    options.useRegex = true;
+    Search search;
+    search.setPattern("gam+a", options);
+    
+    uint64_t generation = worker.start(buffer, search, {10, 0});
+    EXPECT_TRUE(worker.waitForMatch(std::chrono::milliseconds(5000)));
+    
+    SearchProgress progress = waitForCount(worker);
+    ASSERT_TRUE(progress.countDone);
+    EXPECT_EQ(progress.generation, generation);
+    EXPECT_EQ(progress.bufferId, buffer.id());
+    EXPECT_EQ(progress.changeCount, buffer.changeCount());
+    ASSERT_TRUE(progress.matchDone);
+    EXPECT_EQ(progress.match.position, (Position{1000, 5}));
+    EXPECT_EQ(progress.count, 50u);
+    
+    // Without a match the count is known at once
+    search.setPattern("delta", options);
+    worker.start(buffer, search, {0, 0});
+    progress = waitForCount(worker);
+    ASSERT_TRUE(progress.countDone);
+    EXPECT_FALSE(progress.match);
+    EXPECT_EQ(progress.count, 0u);
+}
+
+TEST(SearchWorkerTest, NewSearchReplacesOld) {
+    SearchWorker worker;
+    Buffer buffer(gammaLines(Search::PARALLEL_MIN_LINES * 4, 2));
+    Search search;
+    search.setPattern("a");
+    
+    // Only the latest of several quick searches reports progress
+    worker.start(buffer, search, {0, 0});
+    search.setPattern("gamma");
+    worker.start(buffer, search, {0, 0});
+    search.setPattern("gamm");
+    uint64_t last = worker.start(buffer, search, {0, 0});
+    
+    SearchProgress progress = waitForCount(worker);
+    ASSERT_TRUE(progress.countDone);
+    EXPECT_EQ(progress.generation, last);
+    EXPECT_EQ(progress.match.position, (Position{0, 5}));
+    EXPECT_EQ(progress.count, Search::PARALLEL_MIN_LINES * 2);
+    
+    // A cancelled search reports nothing
+    worker.start(buffer, search, {0, 0});
+    worker.cancel();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(worker.poll(progress));
+    EXPECT_FALSE(worker.waitForMatch(std::chrono::milliseconds(1)));
+}
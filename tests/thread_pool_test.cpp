@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+#include "astrax/thread_pool.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace astrax;
+
+// ============================================================================
+// ThreadPool Tests
+// ============================================================================
+
+TEST(ThreadPoolTest, RunsEveryTaskOnce) {
+    ThreadPool pool(3);
+    EXPECT_EQ(pool.concurrency(), 4u);
+    
+    for (size_t count : {0u, 1u, 7u, 1000u}) {
+        std::vector<std::atomic<int>> runs(count);
+        pool.run(count, [&](size_t i) { runs[i].fetch_add(1); });
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(runs[i].load(), 1) << "task " << i << " of " << count;
+        }
+    }
+}
+
+TEST(ThreadPoolTest, OverlappingRunsFallBackToCaller) {
+    ThreadPool pool(2);
+    std::atomic<int> total{0};
+    
+    // A run from inside a task, and runs from other threads at once
+    auto batch = [&]() {
+        pool.run(8, [&](size_t) {
+            pool.run(4, [&](size_t) { total.fetch_add(1); });
+        });
+    };
+    std::thread other(batch);
+    batch();
+    other.join();
+    EXPECT_EQ(total.load(), 2 * 8 * 4);
+}